@@ -0,0 +1,75 @@
+#include "config.hpp"
+
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+// A valid configuration with `points` inputs and as many relays
+std::string write_config(int points) {
+  nlohmann::json j = {
+      {"modbus",
+       {{"port", "/dev/ttyUSB0"},
+        {"baudrate", 115200},
+        {"parity", "N"},
+        {"data_bits", 8},
+        {"stop_bits", 1},
+        {"response_timeout_ms", 300},
+        {"byte_timeout_ms", 100},
+        {"max_retries", 3}}},
+      {"mqtt",
+       {{"broker_address", "tcp://localhost:1883"},
+        {"client_id", "benchmark"},
+        {"username", ""},
+        {"password", ""},
+        {"qos", 1},
+        {"retained", true},
+        {"keep_alive_sec", 60},
+        {"operation_timeout_ms", 500}}},
+      {"polling",
+       {{"poll_interval_ms", 100},
+        {"refresh_interval_sec", 60},
+        {"max_commands_per_cycle", 10},
+        {"watchdog_timeout_sec", 10}}},
+  };
+
+  nlohmann::json inputs = nlohmann::json::array();
+  nlohmann::json relays = nlohmann::json::array();
+  for (int i = 0; i < points; i++) {
+    const std::string id = std::to_string(i);
+    inputs.push_back({{"slave_id", 1 + i / 64},
+                      {"address", i % 64},
+                      {"name", "input_" + id},
+                      {"mqtt_topic", "bench/input/" + id + "/state"}});
+    relays.push_back({{"slave_id", 1 + i / 64},
+                      {"address", i % 64},
+                      {"name", "relay_" + id},
+                      {"mqtt_command_topic", "bench/relay/" + id + "/set"},
+                      {"mqtt_state_topic", "bench/relay/" + id + "/state"}});
+  }
+  j["digital_inputs"] = inputs;
+  j["relays"] = relays;
+
+  const std::string path =
+      (std::filesystem::temp_directory_path() / ("modbus_benchmark_" + std::to_string(points) + ".json")).string();
+  std::ofstream(path) << j.dump(2);
+  return path;
+}
+
+}  // namespace
+
+// Arg: number of inputs and of relays
+static void BM_ConfigLoad(benchmark::State& state) {
+  const std::string path = write_config(static_cast<int>(state.range(0)));
+
+  for (auto _ : state) {
+    Config config(path);
+    benchmark::DoNotOptimize(config.points());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0) * 2);
+  std::filesystem::remove(path);
+}
+BENCHMARK(BM_ConfigLoad)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,148 @@
+#include "device_controller.hpp"
+#include "modbus_manager_mock.hpp"
+#include "mqtt_manager_mock.hpp"
+#include "point_factories.hpp"
+
+#include <benchmark/benchmark.h>
+#include <gmock/gmock.h>
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::NiceMock;
+using ::testing::Return;
+
+namespace {
+
+constexpr int kInputsPerSlave = 64;
+
+PollingConfig polling_config(int max_commands_per_cycle) {
+  PollingConfig config;
+  config.poll_interval_ms = 100;
+  config.refresh_interval_sec = 3600;  // keep periodic refreshes out of the measurement
+  config.max_commands_per_cycle = max_commands_per_cycle;
+  config.watchdog_timeout_sec = 10;
+  return config;
+}
+
+// `count` inputs spread over slaves of kInputsPerSlave each
+std::vector<DigitalInput> make_inputs(int count) {
+  std::vector<DigitalInput> inputs;
+  inputs.reserve(count);
+  for (int i = 0; i < count; i++) {
+    inputs.push_back(make_input(1 + i / kInputsPerSlave, i % kInputsPerSlave, "input_" + std::to_string(i), "bench"));
+  }
+  return inputs;
+}
+
+std::vector<Relay> make_relays(int count) {
+  std::vector<Relay> relays;
+  relays.reserve(count);
+  for (int i = 0; i < count; i++) {
+    relays.push_back(make_relay(1 + i / kInputsPerSlave, i % kInputsPerSlave, "relay_" + std::to_string(i), "bench"));
+  }
+  return relays;
+}
+
+struct Fixture {
+  NiceMock<MockModbusManager> modbus;
+  NiceMock<MockMqttManager> mqtt;
+
+  Fixture() {
+    ON_CALL(modbus, read_discrete_inputs(_, _, _)).WillByDefault(Return(true));
+    ON_CALL(modbus, write_coil(_, _, _)).WillByDefault(Return(true));
+    ON_CALL(mqtt, publish(_, _, _)).WillByDefault(Return(true));
+  }
+};
+
+}  // namespace
+
+// Args: input count, whether every input flips on every cycle
+static void BM_PollInputs(benchmark::State& state) {
+  const int count = static_cast<int>(state.range(0));
+  const bool flipping = state.range(1) != 0;
+
+  Fixture fixture;
+  bool level = false;
+  ON_CALL(fixture.modbus, read_discrete_inputs(_, _, _))
+      .WillByDefault(Invoke([&level](int, int, std::array<uint8_t, 8>& dest) {
+        dest.fill(level ? 1 : 0);
+        return true;
+      }));
+
+  DeviceController controller(make_inputs(count), {}, polling_config(10), fixture.modbus, fixture.mqtt);
+  controller.poll_inputs();  // first cycle publishes everything
+
+  for (auto _ : state) {
+    level = flipping ? !level : level;
+    controller.poll_inputs();
+  }
+
+  state.SetItemsProcessed(state.iterations() * count);
+  state.counters["inputs"] = count;
+}
+BENCHMARK(BM_PollInputs)->ArgsProduct({{10, 100, 10000}, {0, 1}})->Unit(benchmark::kMicrosecond);
+
+// Arg: relay count, commands go round-robin over all of them
+static void BM_HandleMqttCommand(benchmark::State& state) {
+  const int count = static_cast<int>(state.range(0));
+  constexpr int kDrainEvery = 4096;
+
+  Fixture fixture;
+  DeviceController controller({}, make_relays(count), polling_config(kDrainEvery), fixture.modbus, fixture.mqtt);
+
+  std::vector<std::string> topics;
+  for (const auto& relay : make_relays(count)) {
+    topics.push_back(relay.mqtt_command_topic);
+  }
+  topics.push_back("bench/unknown/set");  // a miss per round
+
+  std::size_t next = 0;
+  int queued = 0;
+  for (auto _ : state) {
+    controller.handle_mqtt_command(topics[next], "ON");
+    next = next + 1 == topics.size() ? 0 : next + 1;
+
+    // Keep the queue from growing without bound
+    if (++queued == kDrainEvery) {
+      state.PauseTiming();
+      controller.process_relay_commands();
+      queued = 0;
+      state.ResumeTiming();
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HandleMqttCommand)->Arg(10)->Arg(1000);
+
+// Arg: commands waiting in the queue; each cycle takes max_commands_per_cycle
+// and the same number is queued again between cycles
+static void BM_ProcessRelayCommands(benchmark::State& state) {
+  const int depth = static_cast<int>(state.range(0));
+  constexpr int kPerCycle = 10;
+
+  Fixture fixture;
+  const std::vector<Relay> relays = make_relays(64);
+  DeviceController controller({}, relays, polling_config(kPerCycle), fixture.modbus, fixture.mqtt);
+
+  std::size_t next = 0;
+  auto enqueue = [&](int n) {
+    for (int i = 0; i < n; i++) {
+      controller.handle_mqtt_command(relays[next].mqtt_command_topic, i % 2 ? "ON" : "OFF");
+      next = (next + 1) % relays.size();
+    }
+  };
+  enqueue(depth);
+
+  for (auto _ : state) {
+    controller.process_relay_commands();
+
+    state.PauseTiming();
+    enqueue(kPerCycle);
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * kPerCycle);
+  state.counters["depth"] = depth;
+}
+BENCHMARK(BM_ProcessRelayCommands)->Arg(10)->Arg(1000)->Arg(100000)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,65 @@
+#include "logger/file_sink.hpp"
+#include "logger/logger.hpp"
+
+#include <benchmark/benchmark.h>
+#include <filesystem>
+
+namespace {
+
+// Routes output to a scratch file for the lifetime of a benchmark
+class ScratchLog {
+ public:
+  explicit ScratchLog(bool async) {
+    FileSinkOptions options;
+    options.path = (std::filesystem::temp_directory_path() / "modbus_benchmark.log").string();
+    options.max_size_bytes = 64 * 1024 * 1024;
+    options.max_files = 1;
+    options.compress = false;
+    Logger::enable_file_output(options);
+    if (async) {
+      Logger::enable_async(1 << 16, LogOverflowPolicy::BLOCK);
+    }
+  }
+
+  ~ScratchLog() {
+    Logger::disable_async();
+    Logger::disable_file_output();
+    std::filesystem::remove((std::filesystem::temp_directory_path() / "modbus_benchmark.log"));
+  }
+};
+
+}  // namespace
+
+// Arg: 1 for the asynchronous writer
+static void BM_LoggerEnabled(benchmark::State& state) {
+  const LogLevel saved = Logger::get_global_level();
+  Logger::set_global_level(LogLevel::LEVEL_INFO);
+  ScratchLog scratch(state.range(0) != 0);
+  Logger logger("Benchmark");
+
+  int value = 0;
+  for (auto _ : state) {
+    LOG_INFO(logger) << "INPUT: bench_input_" << value++ << " = ON" << log_field("slave", 12);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  Logger::set_global_level(saved);
+}
+BENCHMARK(BM_LoggerEnabled)->Arg(0)->Arg(1);
+
+// A DEBUG statement with the level at INFO: the cost of the runtime check
+static void BM_LoggerDisabled(benchmark::State& state) {
+  const LogLevel saved = Logger::get_global_level();
+  Logger::set_global_level(LogLevel::LEVEL_INFO);
+  Logger logger("Benchmark");
+
+  int value = 0;
+  for (auto _ : state) {
+    LOG_DEBUG(logger) << "INPUT: bench_input_" << value++ << " = ON";
+    benchmark::DoNotOptimize(value);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  Logger::set_global_level(saved);
+}
+BENCHMARK(BM_LoggerDisabled);
@@ -0,0 +1,413 @@
+// End-to-end latency of the full Application against a simulated RTU bus
+// and the in-process broker:
+//   input:   slave input flips -> state message arrives at the broker
+//   command: .../set published on the broker -> coil changes on the slave
+//
+//   latency_harness --duration-sec=30 --flip-rate=50 --crc-error-rate=0.01 --json=latency.json
+
+#include "application.hpp"
+#include "local_mqtt_broker.hpp"
+#include "logger/logger.hpp"
+#include "metrics/latency_histogram.hpp"
+#include "virtual_slave_farm.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+struct Options {
+  int slaves = 4;
+  int inputs_per_slave = 16;
+  int relays_per_slave = 8;
+  int baudrate = 19200;
+  int poll_interval_ms = 50;
+  int max_commands_per_cycle = 10;
+  double duration_sec = 10.0;
+  double flip_rate = 20.0;     // input flips per second over all slaves
+  double command_rate = 5.0;   // relay commands per second
+  double crc_error_rate = 0.0;
+  double timeout_rate = 0.0;
+  int slave_latency_us = 0;
+  int broker_ack_delay_us = 0;
+  int loss_timeout_ms = 3000;  // an event not seen by then counts as lost
+  uint32_t seed = 1;
+  std::string json_path;
+};
+
+void usage() {
+  std::cout << "Usage: latency_harness [--option=value ...]\n"
+               "  --slaves --inputs-per-slave --relays-per-slave --baudrate --poll-interval-ms\n"
+               "  --max-commands-per-cycle --duration-sec --flip-rate --command-rate\n"
+               "  --crc-error-rate --timeout-rate --slave-latency-us --broker-ack-delay-us\n"
+               "  --loss-timeout-ms --seed --json=<file>\n";
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+  const std::map<std::string, std::function<void(const std::string&)>> setters = {
+      {"slaves", [&](const std::string& v) { options.slaves = std::stoi(v); }},
+      {"inputs-per-slave", [&](const std::string& v) { options.inputs_per_slave = std::stoi(v); }},
+      {"relays-per-slave", [&](const std::string& v) { options.relays_per_slave = std::stoi(v); }},
+      {"baudrate", [&](const std::string& v) { options.baudrate = std::stoi(v); }},
+      {"poll-interval-ms", [&](const std::string& v) { options.poll_interval_ms = std::stoi(v); }},
+      {"max-commands-per-cycle", [&](const std::string& v) { options.max_commands_per_cycle = std::stoi(v); }},
+      {"duration-sec", [&](const std::string& v) { options.duration_sec = std::stod(v); }},
+      {"flip-rate", [&](const std::string& v) { options.flip_rate = std::stod(v); }},
+      {"command-rate", [&](const std::string& v) { options.command_rate = std::stod(v); }},
+      {"crc-error-rate", [&](const std::string& v) { options.crc_error_rate = std::stod(v); }},
+      {"timeout-rate", [&](const std::string& v) { options.timeout_rate = std::stod(v); }},
+      {"slave-latency-us", [&](const std::string& v) { options.slave_latency_us = std::stoi(v); }},
+      {"broker-ack-delay-us", [&](const std::string& v) { options.broker_ack_delay_us = std::stoi(v); }},
+      {"loss-timeout-ms", [&](const std::string& v) { options.loss_timeout_ms = std::stoi(v); }},
+      {"seed", [&](const std::string& v) { options.seed = static_cast<uint32_t>(std::stoul(v)); }},
+      {"json", [&](const std::string& v) { options.json_path = v; }},
+  };
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const std::size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+      return false;
+    }
+    auto setter = setters.find(arg.substr(2, equals - 2));
+    if (setter == setters.end()) {
+      return false;
+    }
+    try {
+      setter->second(arg.substr(equals + 1));
+    } catch (const std::exception&) {
+      return false;
+    }
+  }
+  return options.slaves > 0 && options.slaves <= 247 && options.inputs_per_slave > 0 && options.relays_per_slave > 0;
+}
+
+std::string input_topic(int slave, int address) {
+  return "harness/input/" + std::to_string(slave) + "_" + std::to_string(address) + "/state";
+}
+
+std::string command_topic(int slave, int address) {
+  return "harness/relay/" + std::to_string(slave) + "_" + std::to_string(address) + "/set";
+}
+
+void write_config(const std::string& path, const Options& options, const std::string& port,
+                  const std::string& broker) {
+  nlohmann::json inputs = nlohmann::json::array();
+  nlohmann::json relays = nlohmann::json::array();
+  for (int slave = 1; slave <= options.slaves; slave++) {
+    for (int address = 0; address < options.inputs_per_slave; address++) {
+      inputs.push_back({{"slave_id", slave},
+                        {"address", address},
+                        {"name", "input_" + std::to_string(slave) + "_" + std::to_string(address)},
+                        {"mqtt_topic", input_topic(slave, address)}});
+    }
+    for (int address = 0; address < options.relays_per_slave; address++) {
+      const std::string name = std::to_string(slave) + "_" + std::to_string(address);
+      relays.push_back({{"slave_id", slave},
+                        {"address", address},
+                        {"name", "relay_" + name},
+                        {"mqtt_command_topic", command_topic(slave, address)},
+                        {"mqtt_state_topic", "harness/relay/" + name + "/state"}});
+    }
+  }
+
+  nlohmann::json config = {
+      {"modbus",
+       {{"port", port},
+        {"baudrate", options.baudrate},
+        {"parity", "N"},
+        {"data_bits", 8},
+        {"stop_bits", 1},
+        {"response_timeout_ms", 100},
+        {"byte_timeout_ms", 20},
+        {"max_retries", 3}}},
+      {"mqtt",
+       {{"broker_address", broker},
+        {"client_id", "latency_harness"},
+        {"qos", 1},
+        {"retained", true},
+        {"keep_alive_sec", 60},
+        {"operation_timeout_ms", 500}}},
+      {"polling",
+       {{"poll_interval_ms", options.poll_interval_ms},
+        {"refresh_interval_sec", 3600},
+        {"max_commands_per_cycle", options.max_commands_per_cycle},
+        {"watchdog_timeout_sec", 30}}},
+      {"logging", {{"level", "warning"}}},
+      {"digital_inputs", inputs},
+      {"relays", relays},
+  };
+  std::ofstream(path) << config.dump(2);
+}
+
+// Events in flight, keyed by what the far side will observe
+class Tracker {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  void sent(const std::string& key, Clock::time_point at) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_[key] = at;
+    sent_++;
+  }
+
+  std::size_t in_flight() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_.size();
+  }
+
+  bool pending(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_.count(key) > 0;
+  }
+
+  void observed(const std::string& key, Clock::time_point at) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pending_.find(key);
+    if (it != pending_.end()) {
+      histogram_.record(at - it->second);
+      pending_.erase(it);
+    }
+  }
+
+  // Drops events older than `timeout` and returns their keys
+  std::vector<std::string> expire(Clock::time_point now, std::chrono::milliseconds timeout) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> expired;
+    for (auto it = pending_.begin(); it != pending_.end();) {
+      if (now - it->second > timeout) {
+        expired.push_back(it->first);
+        it = pending_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    lost_ += expired.size();
+    return expired;
+  }
+
+  nlohmann::json report(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const LatencyHistogram::Snapshot s = histogram_.snapshot();
+    return {{"name", name},
+            {"sent", sent_},
+            {"observed", s.count},
+            {"lost", lost_},
+            {"in_flight", pending_.size()},
+            {"mean_us", s.mean_us()},
+            {"p50_us", s.percentile(50)},
+            {"p90_us", s.percentile(90)},
+            {"p99_us", s.percentile(99)},
+            {"p999_us", s.percentile(99.9)},
+            {"max_us", s.max_us}};
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::map<std::string, Clock::time_point> pending_;
+  LatencyHistogram histogram_;
+  uint64_t sent_ = 0;
+  uint64_t lost_ = 0;
+};
+
+std::string key(int slave, int address) {
+  return std::to_string(slave) + ":" + std::to_string(address);
+}
+
+void print_report(const nlohmann::json& path) {
+  std::cout << path["name"].get<std::string>() << ": " << path["observed"] << "/" << path["sent"] << " observed, "
+            << path["lost"] << " lost\n"
+            << "  p50 " << path["p50_us"].get<uint64_t>() / 1000.0 << "ms  p90 "
+            << path["p90_us"].get<uint64_t>() / 1000.0 << "ms  p99 " << path["p99_us"].get<uint64_t>() / 1000.0
+            << "ms  p99.9 " << path["p999_us"].get<uint64_t>() / 1000.0 << "ms  max "
+            << path["max_us"].get<uint64_t>() / 1000.0 << "ms\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    usage();
+    return 2;
+  }
+
+  Logger::enable_timestamps(true);
+  Logger::enable_colors(false);
+
+  VirtualSlaveFarm farm(options.baudrate, options.seed);
+  for (int slave = 1; slave <= options.slaves; slave++) {
+    VirtualSlaveConfig config;
+    config.slave_id = slave;
+    config.inputs = options.inputs_per_slave;
+    config.coils = options.relays_per_slave;
+    config.latency = std::chrono::microseconds(options.slave_latency_us);
+    config.crc_error_rate = options.crc_error_rate;
+    config.timeout_rate = options.timeout_rate;
+    farm.add_slave(config);
+  }
+  LocalMqttBroker broker;
+
+  Tracker inputs;
+  Tracker commands;
+  farm.set_coil_callback([&commands](int slave, int address, bool) {
+    commands.observed(key(slave, address), std::chrono::steady_clock::now());
+  });
+
+  // Topic -> key of the input, for the broker thread
+  std::map<std::string, std::string> input_keys;
+  for (int slave = 1; slave <= options.slaves; slave++) {
+    for (int address = 0; address < options.inputs_per_slave; address++) {
+      input_keys[input_topic(slave, address)] = key(slave, address);
+    }
+  }
+  broker.set_publish_callback([&](const LocalMqttBroker::Message& message) {
+    auto it = input_keys.find(message.topic);
+    if (it != input_keys.end()) {
+      inputs.observed(it->second, message.received);
+    }
+  });
+
+  const std::string config_path =
+      (std::filesystem::temp_directory_path() / ("latency_harness_" + std::to_string(::getpid()) + ".json")).string();
+
+  try {
+    farm.start();
+    broker.start();
+    broker.set_ack_delay(std::chrono::microseconds(options.broker_ack_delay_us));
+    write_config(config_path, options, farm.port(), broker.address());
+  } catch (const std::exception& e) {
+    std::cerr << "Setup failed: " << e.what() << "\n";
+    return 1;
+  }
+
+  std::atomic<bool> running(true);
+  std::atomic<bool> force_exit(false);
+  std::atomic<bool> dump_stats(false);
+  std::atomic<bool> reload(false);
+
+  Application app(config_path);
+  if (!app.initialize()) {
+    std::cerr << "Application failed to initialize\n";
+    std::filesystem::remove(config_path);
+    return 1;
+  }
+  std::thread poller([&] { app.run(running, force_exit, dump_stats, reload); });
+
+  // Start measuring once the startup state and the subscriptions are in place
+  const std::string last_topic = input_topic(options.slaves, options.inputs_per_slave - 1);
+  if (!broker.wait_for_messages(last_topic, 1, std::chrono::seconds(10)) ||
+      !broker.wait_for_subscription(command_topic(1, 0), std::chrono::seconds(10))) {
+    std::cerr << "Gateway did not publish its startup state\n";
+  }
+
+  std::mt19937 rng(options.seed);
+  std::uniform_int_distribution<int> pick_slave(1, options.slaves);
+  std::uniform_int_distribution<int> pick_input(0, options.inputs_per_slave - 1);
+  std::uniform_int_distribution<int> pick_relay(0, options.relays_per_slave - 1);
+  const double total_rate = options.flip_rate + options.command_rate;
+  std::exponential_distribution<double> gap(total_rate > 0 ? total_rate : 1.0);
+  std::bernoulli_distribution is_flip(total_rate > 0 ? options.flip_rate / total_rate : 0.0);
+
+  std::map<std::string, bool> desired;  // relay states the harness asked for
+  const auto loss_timeout = std::chrono::milliseconds(options.loss_timeout_ms);
+  const auto begin = std::chrono::steady_clock::now();
+  const auto end = begin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                               std::chrono::duration<double>(options.duration_sec));
+  auto next = begin;
+
+  while (total_rate > 0 && next < end) {
+    std::this_thread::sleep_until(next);
+    next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(gap(rng)));
+
+    const auto now = std::chrono::steady_clock::now();
+    inputs.expire(now, loss_timeout);
+    for (const auto& lost : commands.expire(now, loss_timeout)) {
+      desired.erase(lost);  // re-read from the slave on the next pick
+    }
+
+    const int slave = pick_slave(rng);
+    if (is_flip(rng)) {
+      const int address = pick_input(rng);
+      const std::string k = key(slave, address);
+      if (inputs.pending(k)) {
+        continue;  // one flip per input in flight, or the two could not be told apart
+      }
+      inputs.sent(k, std::chrono::steady_clock::now());
+      farm.set_input(slave, address, !farm.input(slave, address));
+    } else {
+      const int address = pick_relay(rng);
+      const std::string k = key(slave, address);
+      if (commands.pending(k)) {
+        continue;
+      }
+      auto state = desired.find(k);
+      const bool target = !(state == desired.end() ? farm.coil(slave, address) : state->second);
+      desired[k] = target;
+      commands.sent(k, std::chrono::steady_clock::now());
+      broker.publish(command_topic(slave, address), target ? "ON" : "OFF");
+    }
+  }
+
+  // Let the tail of the events arrive
+  const auto drain_end = std::chrono::steady_clock::now() + loss_timeout;
+  while (std::chrono::steady_clock::now() < drain_end && inputs.in_flight() + commands.in_flight() > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  inputs.expire(std::chrono::steady_clock::now(), std::chrono::milliseconds(0));
+  commands.expire(std::chrono::steady_clock::now(), std::chrono::milliseconds(0));
+
+  running = false;
+  poller.join();
+  app.shutdown();
+  Logger::disable_async();
+  std::filesystem::remove(config_path);
+
+  const VirtualSlaveFarm::Stats bus = farm.stats();
+  nlohmann::json result = {
+      {"options",
+       {{"slaves", options.slaves},
+        {"inputs_per_slave", options.inputs_per_slave},
+        {"relays_per_slave", options.relays_per_slave},
+        {"baudrate", options.baudrate},
+        {"poll_interval_ms", options.poll_interval_ms},
+        {"max_commands_per_cycle", options.max_commands_per_cycle},
+        {"duration_sec", options.duration_sec},
+        {"flip_rate", options.flip_rate},
+        {"command_rate", options.command_rate},
+        {"crc_error_rate", options.crc_error_rate},
+        {"timeout_rate", options.timeout_rate},
+        {"slave_latency_us", options.slave_latency_us},
+        {"broker_ack_delay_us", options.broker_ack_delay_us},
+        {"seed", options.seed}}},
+      {"input_to_broker", inputs.report("input_to_broker")},
+      {"command_to_coil", commands.report("command_to_coil")},
+      {"bus",
+       {{"requests", bus.requests},
+        {"replies", bus.replies},
+        {"crc_errors", bus.crc_errors},
+        {"timeouts", bus.timeouts},
+        {"exceptions", bus.exceptions}}},
+  };
+
+  print_report(result["input_to_broker"]);
+  print_report(result["command_to_coil"]);
+  std::cout << "bus: " << bus.requests << " requests, " << bus.crc_errors << " corrupted, " << bus.timeouts
+            << " unanswered\n";
+
+  if (!options.json_path.empty()) {
+    std::ofstream(options.json_path) << result.dump(2) << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,27 @@
+#include "logger/logger.hpp"
+
+#include <benchmark/benchmark.h>
+
+#ifndef BENCHMARK_GIT_COMMIT
+#define BENCHMARK_GIT_COMMIT "unknown"
+#endif
+
+// Compare two runs with Google Benchmark's tools/compare.py:
+//   modbus_benchmarks --benchmark_out=before.json --benchmark_out_format=json
+int main(int argc, char** argv) {
+  // Only the logger benchmarks produce output, and they set their own level
+  Logger::set_global_level(LogLevel::LEVEL_CRITICAL);
+  Logger::enable_timestamps(true);
+  Logger::enable_colors(false);
+
+  benchmark::AddCustomContext("git_commit", BENCHMARK_GIT_COMMIT);
+  benchmark::AddCustomContext("project_version", PROJECT_VERSION);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -1,28 +1,61 @@
 #pragma once
 
+#include "clock.hpp"
 #include "config.hpp"
 #include "device_controller.hpp"
+#include "log_level_control.hpp"
 #include "logger/logger.hpp"
+#include "metrics/metrics_server.hpp"
 #include "modbus_manager.hpp"
 #include "mqtt_manager.hpp"
 
 #include <atomic>
+#include <chrono>
+#include <filesystem>
 #include <memory>
+#include <set>
+#include <string>
 
 class Application {
  public:
-  explicit Application(const std::string& config_file);
+  // Everything time-driven (poll loop, watchdog, bus retries) runs on `clock`
+  explicit Application(const std::string& config_file, Clock& clock = Clock::steady());
   ~Application();
 
   bool initialize();
-  void run(std::atomic<bool>& running, std::atomic<bool>& force_exit);
+  void run(std::atomic<bool>& running, std::atomic<bool>& force_exit, std::atomic<bool>& dump_stats,
+           std::atomic<bool>& reload);
   void shutdown();
 
+  // Loads the config file again and applies only what changed. An invalid
+  // file is rejected and the running configuration stays in place.
+  bool reload_config();
+
  private:
+  static constexpr const char* kRelayCommandFilter = "modbus/relay/+/set";
+
+  Clock& clock_;
+  std::chrono::steady_clock::time_point started_;  // before the config is parsed
+  std::string config_file_;
   std::unique_ptr<Config> config_;
   std::unique_ptr<ModbusManager> modbus_;
   std::unique_ptr<MqttManager> mqtt_;
   std::unique_ptr<DeviceController> controller_;
+  std::unique_ptr<LogLevelControl> log_control_;
+  std::unique_ptr<MetricsServer> metrics_server_;
+
+  std::set<std::string> command_subscriptions_;  // configured topics outside kRelayCommandFilter
+  std::filesystem::file_time_type config_mtime_;
+  std::chrono::steady_clock::time_point next_config_check_;
 
   Logger logger_;
+
+  void apply_log_settings(const LoggingConfig& logging);
+  void log_diagnostics(const Config& config);
+  // Logs the modelled bus time of a poll cycle and exports it as metrics
+  void report_cycle_budget();
+  void start_metrics_server();
+  void update_command_subscriptions();
+  std::filesystem::file_time_type config_file_time() const;
+  bool config_file_changed(std::chrono::steady_clock::time_point now);
 };
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "config.hpp"
+#include "device_profile.hpp"
+
+#include <chrono>
+#include <cstddef>
+
+struct PointTable;
+
+// Wire-time model of a Modbus RTU line: character time from the framing,
+// the 3.5 character silence that ends every frame, and frame sizes per
+// function code. Slave processing time is a fixed turnaround.
+class BusTiming {
+ public:
+  static constexpr std::chrono::microseconds kDefaultTurnaround{1000};
+
+  explicit BusTiming(const ModbusConfig& config, std::chrono::nanoseconds turnaround = kDefaultTurnaround);
+
+  // Start bit, data bits, parity bit if any, stop bits
+  int bits_per_character() const { return bits_per_character_; }
+  std::chrono::nanoseconds character_time() const { return character_time_; }
+  // t3.5; fixed at 1.75 ms above 19200 baud as the RTU spec recommends
+  std::chrono::nanoseconds frame_gap() const;
+  // Characters of one frame plus the silence after it
+  std::chrono::nanoseconds frame_time(std::size_t bytes) const;
+  // Request, slave turnaround and response
+  std::chrono::nanoseconds transaction_time(std::size_t request_bytes, std::size_t response_bytes) const;
+
+  // Frame sizes including unit id and CRC
+  static constexpr std::size_t kReadBitsRequestSize = 8;
+  static std::size_t read_bits_response_size(std::size_t count) { return 5 + (count + 7) / 8; }
+  static std::size_t write_coil_request_size(ModbusFunction function);  // one coil
+  static std::size_t write_coils_request_size(int count) { return 9 + (static_cast<std::size_t>(count) + 7) / 8; }
+  static constexpr std::size_t kWriteCoilResponseSize = 8;
+
+  std::chrono::nanoseconds read_time(std::size_t count) const;
+  std::chrono::nanoseconds write_time(ModbusFunction function) const;
+
+ private:
+  int baudrate_;
+  int bits_per_character_;
+  std::chrono::nanoseconds character_time_;
+  std::chrono::nanoseconds turnaround_;
+};
+
+// Expected bus time of one poll cycle
+struct CycleBudget {
+  std::size_t read_requests = 0;
+  std::chrono::nanoseconds poll_time{0};     // every input read once
+  std::chrono::nanoseconds command_time{0};  // a full batch of max_commands_per_cycle writes
+  std::chrono::nanoseconds interval{0};
+
+  // Share of the poll interval the input reads keep the bus busy
+  double utilization() const;
+  double utilization_with_commands() const;
+  bool feasible() const { return poll_time <= interval; }
+};
+
+// Costs the read plan of `points` (request sizes and function codes from
+// the device profiles, plus their inter-frame delays) against the interval
+CycleBudget plan_cycle(const PointTable& points, const PollingConfig& polling, const BusTiming& timing);
+
+// Timeouts one line runs with
+struct RtuTimeouts {
+  std::chrono::microseconds response;  // until the first character of the reply
+  std::chrono::microseconds byte;      // between two characters of a reply
+  // Silence before a failed transaction is retried, so the rest of a late
+  // or broken reply cannot run into the next request
+  std::chrono::microseconds read_retry_delay;
+  std::chrono::microseconds write_retry_delay;
+};
+
+// Automatic timing: the byte timeout is twice t3.5, but at least 20 ms
+// because USB serial adapters hand over a reply in chunks up to their
+// latency timer apart (16 ms by default on FTDI). The response timeout is
+// the wire time of the longest acknowledged request plus 50 ms for the
+// slave, and retries wait out the byte timeout. Positive configured values
+// override either timeout.
+// Fixed timing: the configured values and 30/50 ms retry delays.
+RtuTimeouts rtu_timeouts(const ModbusConfig& config);
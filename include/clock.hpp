@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <set>
+
+// Monotonic time source and sleeps of the control path. Production code
+// uses Clock::steady(); tests and benchmarks pass a VirtualClock so that
+// refresh intervals, statistics periods, the watchdog and retry backoff
+// can be exercised without waiting.
+class Clock {
+ public:
+  using time_point = std::chrono::steady_clock::time_point;
+  using duration = std::chrono::steady_clock::duration;
+
+  virtual ~Clock() = default;
+
+  virtual time_point now() const = 0;
+  virtual void sleep_for(duration d) = 0;
+
+  // Like sleep_for, but returns false early once `stop` is set and wake()
+  // is called, so the owner of a sleeping thread can join it
+  virtual bool sleep_unless(duration d, const std::atomic<bool>& stop) = 0;
+  virtual void wake() = 0;
+
+  void sleep_until(time_point t) {
+    const time_point current = now();
+    if (t > current) {
+      sleep_for(t - current);
+    }
+  }
+
+  // std::chrono::steady_clock and std::this_thread::sleep_for
+  static Clock& steady();
+};
+
+// Time that only moves when told to.
+//
+// Sleeping threads block until advance() or advance_to_next() moves time
+// past their deadline. With auto-advance enabled a sleep moves time
+// forward by itself and returns at once, which suits code where only one
+// thread sleeps.
+class VirtualClock : public Clock {
+ public:
+  // Starts well after the clock's epoch, so `time_point{}` still reads as
+  // "long ago" the way it does with the steady clock
+  explicit VirtualClock(time_point start = time_point(std::chrono::hours(24)));
+
+  time_point now() const override;
+  void sleep_for(duration d) override;
+  bool sleep_unless(duration d, const std::atomic<bool>& stop) override;
+  void wake() override;
+
+  void set_auto_advance(bool enabled);
+
+  // Moves time forward and wakes the sleepers whose deadline has passed
+  void advance(duration d);
+
+  // Waits in real time until `sleepers` threads are blocked in sleep_for,
+  // then moves time to the earliest of their deadlines. Returns false if
+  // they did not all go to sleep within `timeout`.
+  bool advance_to_next(std::size_t sleepers, std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+  // Threads blocked in sleep_for with a deadline still ahead
+  std::size_t sleepers() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  time_point now_;
+  bool auto_advance_ = false;
+  std::multiset<time_point> deadlines_;
+
+  std::size_t sleepers_locked() const;
+};
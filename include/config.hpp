@@ -1,6 +1,8 @@
 #pragma once
 
+#include <memory>
 #include <nlohmann/json.hpp>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -12,6 +14,11 @@ struct ModbusConfig {
   char parity;
   int data_bits;
   int stop_bits;
+  // "libmodbus" (or empty) or "native": the non-blocking RtuBus
+  std::string transport;
+  // "auto" (or empty): timeouts left at 0 are derived from the baud rate and
+  // framing, see rtu_timeouts(). "fixed": the configured values as they are.
+  std::string timing;
   int response_timeout_ms;
   int byte_timeout_ms;
   int max_retries;
@@ -51,6 +58,20 @@ struct Relay {
   static Relay from_json(const nlohmann::json& j);
 };
 
+// Coils switched by one broadcast frame (unit id 0, FC15; FC05 for a
+// single coil) instead of a transaction per relay. Every slave on the line
+// applies a broadcast, so a group is a coil range: its members are the
+// configured relays in that range, whatever their slave.
+struct BroadcastGroup {
+  std::string name;
+  int address;
+  int count;
+  std::string mqtt_command_topic;
+  bool verify;  // read the coils back from every member slave afterwards
+
+  static BroadcastGroup from_json(const nlohmann::json& j);
+};
+
 struct PollingConfig {
   int poll_interval_ms;
   int refresh_interval_sec;
@@ -60,8 +81,73 @@ struct PollingConfig {
   static PollingConfig from_json(const nlohmann::json& j);
 };
 
+struct MetricsConfig {
+  bool enabled;
+  std::string bind_address;
+  int port;
+
+  static MetricsConfig from_json(const nlohmann::json& j);
+};
+
+struct LogFileConfig {
+  std::string path;  // empty: log to stdout/stderr
+  int max_size_mb;
+  int max_files;
+  bool compress;
+  bool preallocate;
+
+  static LogFileConfig from_json(const nlohmann::json& j);
+};
+
+struct LoggingConfig {
+  bool async;
+  int queue_size;
+  std::string overflow_policy;  // "drop" or "block"
+  std::string format;           // "text" or "json"
+  LogFileConfig file;
+  std::string level;          // global level at startup
+  std::string control_topic;  // prefix for runtime level commands
+  int override_timeout_sec;   // default auto-revert for overrides, 0 = never
+
+  static LoggingConfig from_json(const nlohmann::json& j);
+};
+
+struct ReloadConfig {
+  bool watch_file;  // reload when the file's modification time changes
+  int watch_interval_ms;
+
+  static ReloadConfig from_json(const nlohmann::json& j);
+};
+
+// A problem found while loading the configuration
+struct ConfigDiagnostic {
+  enum class Severity { WARNING, ERROR };
+
+  Severity severity;
+  std::string path;  // JSON pointer into the file, e.g. "/relays/2/name"
+  std::string message;
+
+  std::string to_string() const;
+};
+
+// Thrown when the configuration has errors; what() lists every one of them
+class ConfigError : public std::runtime_error {
+ public:
+  explicit ConfigError(std::vector<ConfigDiagnostic> diagnostics);
+
+  const std::vector<ConfigDiagnostic>& diagnostics() const { return diagnostics_; }
+
+ private:
+  std::vector<ConfigDiagnostic> diagnostics_;
+};
+
+struct PointTable;
+struct PointSources;
+class DeviceCatalog;
+
 class Config {
  public:
+  // Throws ConfigError if validation finds errors
   explicit Config(const std::string& filename);
 
   const ModbusConfig& modbus() const { return modbus_; }
@@ -70,18 +156,66 @@ class Config {
 
   const PollingConfig& polling() const { return polling_; }
 
+  const MetricsConfig& metrics() const { return metrics_; }
+
+  const LoggingConfig& logging() const { return logging_; }
+
+  const ReloadConfig& reload() const { return reload_; }
+
   const std::vector<DigitalInput>& inputs() const { return inputs_; }
 
   const std::vector<Relay>& relays() const { return relays_; }
 
+  const std::vector<BroadcastGroup>& broadcast_groups() const { return broadcast_groups_; }
+
+  // Points compiled into the index-based tables the runtime works with
+  const std::shared_ptr<const PointTable>& points() const { return points_; }
+
+  // Warnings found while loading
+  const std::vector<ConfigDiagnostic>& diagnostics() const { return diagnostics_; }
+
+  nlohmann::json to_json() const;
   void save(const std::string& filename) const;
 
  private:
   ModbusConfig modbus_;
   MqttConfig mqtt_;
   PollingConfig polling_;
+  MetricsConfig metrics_;
+  LoggingConfig logging_;
+  ReloadConfig reload_;
   std::vector<DigitalInput> inputs_;
   std::vector<Relay> relays_;
+  std::vector<BroadcastGroup> broadcast_groups_;
+  std::shared_ptr<const PointTable> points_;
+  nlohmann::json device_profiles_;  // as configured, built-ins are not repeated
+  std::vector<ConfigDiagnostic> diagnostics_;
 
   void load(const std::string& filename);
-};
\ No newline at end of file
+  void validate(const PointSources& sources, const DeviceCatalog& catalog);
+};
+
+// What changed between two configurations; points are matched by name
+struct ConfigDiff {
+  bool modbus = false;
+  bool mqtt = false;
+  bool polling = false;
+  bool metrics = false;
+  bool logging = false;
+  bool reload = false;
+  bool devices = false;  // device profiles or their slave assignments
+  bool groups = false;   // broadcast groups
+
+  int inputs_added = 0;
+  int inputs_removed = 0;
+  int inputs_changed = 0;
+  int relays_added = 0;
+  int relays_removed = 0;
+  int relays_changed = 0;
+
+  bool points_changed() const;
+  bool empty() const;
+  std::string summary() const;
+};
+
+ConfigDiff diff_config(const Config& before, const Config& after);
@@ -1,65 +1,175 @@
 #pragma once
 
+#include "bus_timing.hpp"
+#include "clock.hpp"
 #include "config.hpp"
+#include "input_image.hpp"
 #include "logger/logger.hpp"
+#include "metrics/latency_histogram.hpp"
+#include "metrics/metrics.hpp"
 #include "modbus_manager.hpp"
 #include "mqtt_manager.hpp"
+#include "point_table.hpp"
+#include "stats_service.hpp"
 
 #include <atomic>
 #include <chrono>
 #include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 class DeviceController {
  public:
+  // Intervals, timestamps and the watchdog follow `clock`
+  DeviceController(std::shared_ptr<const PointTable> points, const PollingConfig& polling_config,
+                   IModbusManager& modbus, IMqttManager& mqtt, Clock& clock = Clock::steady());
+  // Compiles the points without rejecting them; Config reports the problems
   DeviceController(const std::vector<DigitalInput>& inputs, const std::vector<Relay>& relays,
-                   const PollingConfig& polling_config, IModbusManager& modbus, IMqttManager& mqtt);
+                   const PollingConfig& polling_config, IModbusManager& modbus, IMqttManager& mqtt,
+                   Clock& clock = Clock::steady());
+  ~DeviceController();
+
+  // Reads every input and coil once and publishes the complete retained
+  // state as one batch; meant to run before the first poll cycle. Relay
+  // states are read back where the slave's profile allows FC01. `started`
+  // is when the process started, for the time-to-full-state measurement.
+  // Returns false if anything could not be read or published.
+  bool synchronize(std::chrono::steady_clock::time_point started);
 
   void poll_inputs();
   void process_relay_commands();
   void handle_mqtt_command(const std::string& topic, const std::string& payload);
   void print_statistics();
 
+  // Also updates the measured bus utilization every few seconds
+  void record_cycle_time(std::chrono::steady_clock::duration elapsed);
+  // Exports the modelled cycle time and utilization next to the measured one
+  void set_cycle_budget(const CycleBudget& budget);
+  void publish_latency_statistics();
+  void dump_latency_statistics();
+
+  // Alarms (force_exit and SIGTERM) when update_watchdog() is not called
+  // for watchdog_timeout_sec. The thread is joined by stop_watchdog() or
+  // the destructor.
   void start_watchdog(std::atomic<bool>& running, std::atomic<bool>& force_exit);
+  void stop_watchdog();
   void update_watchdog();
 
+  // Replaces the point table and polling settings between poll cycles.
+  // Must be called from the polling thread. Queued commands are moved over
+  // to the new table by relay name. Input images and relay states of points
+  // that did not change are kept, slaves whose layout changed are
+  // republished on the next poll.
+  void reload(std::shared_ptr<const PointTable> points, const PollingConfig& polling_config);
+
+  // Topics that route to a relay command
+  std::vector<std::string> command_topics() const;
+
  private:
-  struct InputState {
-    const DigitalInput* input;
-    bool last_state;
-    std::chrono::steady_clock::time_point last_publish;
+  static constexpr const char* kLatencyStatsTopic = "modbus/poller/stats/latency";
+  static constexpr const char* kRateStatsTopic = "modbus/poller/stats/rates";
+  static constexpr std::chrono::seconds kBusUtilizationWindow{5};
+
+  struct LatencyChannel {
+    std::string name;
+    LatencyHistogram histogram;
+    LatencyHistogram::Snapshot reported;  // State at the last periodic publish
+    MetricsRegistry::Registration registration;
 
-    InputState(const DigitalInput* inp)
-        : input(inp), last_state(false), last_publish(std::chrono::steady_clock::now()) {}
+    explicit LatencyChannel(const std::string& n) : name(n) {}
+  };
+
+  // Inputs of one slave, read in requests sized by its device profile and tracked as a packed image
+  struct SlaveInputs {
+    const PointTable::Slave* plan;
+    InputImage current;
+    InputImage previous;
+    std::chrono::steady_clock::time_point last_refresh;
+    LatencyHistogram* modbus_latency;
+
+    SlaveInputs(const PointTable::Slave& p, LatencyHistogram* latency, std::chrono::steady_clock::time_point now)
+        : plan(&p),
+          current(p.bit_count),
+          previous(p.bit_count),
+          last_refresh(now),
+          modbus_latency(latency) {}
   };
 
   struct RelayState {
     const Relay* relay;
     bool current_state;
+    LatencyHistogram* modbus_latency;
 
-    RelayState(const Relay* rel) : relay(rel), current_state(false) {}
+    RelayState(const Relay* rel, LatencyHistogram* latency)
+        : relay(rel), current_state(false), modbus_latency(latency) {}
   };
 
   struct RelayCommand {
-    std::string relay_name;
+    std::size_t relay;  // index into the point table's relays, or its groups
     bool desired_state;
+    std::chrono::steady_clock::time_point enqueued;
+    bool group = false;  // one broadcast for a whole group
   };
 
-  std::vector<InputState> input_states_;
-  std::map<std::string, RelayState> relay_states_;
+  // Replaced under queue_mutex_; the MQTT thread only reads it under the lock
+  std::shared_ptr<const PointTable> points_;
+
+  std::vector<SlaveInputs> slave_inputs_;  // same order as points_->slaves
+  std::vector<RelayState> relay_states_;   // same order as points_->relays
 
   std::vector<RelayCommand> relay_command_queue_;
   std::mutex queue_mutex_;
 
+  std::vector<uint8_t> read_buffer_;  // one byte per input, sized for the largest request
+
   PollingConfig polling_config_;
+  std::atomic<int> watchdog_timeout_sec_;
   IModbusManager& modbus_;
   IMqttManager& mqtt_;
+  Clock& clock_;
 
   std::atomic<std::chrono::steady_clock::time_point> last_loop_time_;
+  std::thread watchdog_;
+  std::atomic<bool> watchdog_stop_;
   std::chrono::steady_clock::time_point last_stats_time_;
 
+  // Per-stage latencies of the control path
+  std::vector<std::unique_ptr<LatencyChannel>> latency_channels_;
+  LatencyChannel& read_to_publish_latency_;
+  LatencyChannel& command_to_write_latency_;
+  LatencyChannel& cycle_latency_;
+  Gauge command_queue_depth_;
+  MetricsRegistry::Registration command_queue_registration_;
+  Gauge startup_sync_seconds_;
+  MetricsRegistry::Registration startup_sync_registration_;
+
+  // Time spent in Modbus calls, against wall time since bus_window_start_
+  std::chrono::steady_clock::duration bus_busy_{0};
+  std::chrono::steady_clock::time_point bus_window_start_;
+  Gauge bus_utilization_;
+  Gauge bus_expected_utilization_;
+  Gauge bus_expected_cycle_seconds_;
+  std::vector<MetricsRegistry::Registration> bus_registrations_;
+
+  StatsService stats_service_;
+
   Logger logger_;
 
-  void publish_input_state(InputState& state, bool current_state, bool force = false);
+  bool read_slave_inputs(SlaveInputs& slave);
+  // Returns the relays read; `readable` counts those that can be read back
+  // at all (not on the broadcast address, slave supports FC01)
+  std::size_t read_relay_states(std::vector<MqttMessage>& messages, std::size_t& readable);
+  // Broadcasts the group's coils, then reads them back from every member
+  // slave and writes mismatched relays one by one. With verify set, relays
+  // that could not be confirmed are not published.
+  void execute_group(const RelayCommand& cmd);
+  void publish_input_state(const DigitalInput& input, bool current_state, bool changed,
+                           std::chrono::steady_clock::time_point sampled);
   void publish_relay_state(const RelayState& state);
-  void group_inputs_by_slave(std::map<int, std::vector<InputState*>>& groups);
+  void build_points();
+  LatencyChannel& add_latency_channel(const std::string& name, const std::string& metric, const std::string& help,
+                                      const MetricLabels& labels);
+  LatencyHistogram* slave_latency(int slave_id);
 };
\ No newline at end of file
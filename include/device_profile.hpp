@@ -0,0 +1,66 @@
+#pragma once
+
+#include "config.hpp"
+
+#include <cstdint>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+// Modbus function codes the gateway uses
+enum class ModbusFunction : uint8_t {
+  READ_COILS = 0x01,
+  READ_DISCRETE_INPUTS = 0x02,
+  WRITE_SINGLE_COIL = 0x05,
+  WRITE_MULTIPLE_COILS = 0x0F,
+};
+
+// What a slave module can do; the planner sizes frames and picks function
+// codes from it instead of assuming an 8-input module.
+struct DeviceProfile {
+  static constexpr int kMaxReadBits = 2000;  // Modbus limit for FC01/FC02
+
+  std::string name;
+  int inputs = 0;  // discrete inputs on the module, 0 = unknown
+  int coils = 0;   // coils on the module, 0 = unknown
+  std::vector<int> function_codes = {0x01, 0x02, 0x05, 0x0F};
+  int max_read_bits = 8;         // bits per read request
+  int inter_frame_delay_ms = 0;  // extra silence after each frame to this slave
+
+  bool supports(ModbusFunction function) const;
+
+  // Function used to read inputs (FC02, or FC01 on modules that only map
+  // their inputs as coils) and to write one coil (FC05, or FC15 with a
+  // single coil); false if the profile supports neither.
+  bool read_function(ModbusFunction& function) const;
+  bool write_function(ModbusFunction& function) const;
+
+  static DeviceProfile from_json(const std::string& name, const nlohmann::json& j);
+};
+
+// Built-in and configured device profiles and which slave uses which one.
+// Slaves without an assignment use "generic": 8 inputs per read, all
+// function codes, no delay.
+class DeviceCatalog {
+ public:
+  static constexpr const char* kGenericProfile = "generic";
+
+  DeviceCatalog();
+
+  // Reads "device_profiles" (added to or replacing the built-ins) and the
+  // "slaves" assignments ({"slave_id": "48-51", "profile": "di8"})
+  void load(const nlohmann::json& config, std::vector<ConfigDiagnostic>& diagnostics);
+
+  // Assigning a second, different profile to a slave is an error
+  void assign(int slave_id, const std::string& profile, const std::string& path,
+              std::vector<ConfigDiagnostic>& diagnostics);
+
+  const DeviceProfile& profile_for(int slave_id) const;
+
+  const DeviceProfile* find(const std::string& name) const;
+
+ private:
+  std::map<std::string, DeviceProfile> profiles_;
+  std::map<int, std::pair<std::string, std::string>> assignments_;  // slave -> profile, path
+};
@@ -1,9 +1,19 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 
-struct ModbusManagerStats;
+// Totals since start; counters only ever increase
+struct ModbusManagerStats {
+  uint64_t read_success;
+  uint64_t read_errors;
+  uint64_t write_success;
+  uint64_t write_errors;
+
+  ModbusManagerStats();
+  ModbusManagerStats(uint64_t rs, uint64_t re, uint64_t ws, uint64_t we);
+};
 
 class IModbusManager {
  public:
@@ -14,8 +24,29 @@ class IModbusManager {
   virtual bool is_connected() const = 0;
 
   virtual bool read_discrete_inputs(int slave_id, int start_addr, std::array<uint8_t, 8>& dest) = 0;
+
+  // Reads `count` inputs, one byte per input. Managers that size frames per
+  // device override this; the default reads blocks of 8.
+  virtual bool read_input_bits(int slave_id, int start_addr, int count, uint8_t* dest) {
+    std::array<uint8_t, 8> block;
+    for (int offset = 0; offset < count; offset += static_cast<int>(block.size())) {
+      if (!read_discrete_inputs(slave_id, start_addr + offset, block)) {
+        return false;
+      }
+      std::copy_n(block.begin(), std::min(static_cast<int>(block.size()), count - offset), dest + offset);
+    }
+    return true;
+  }
+
+  // Reads the current state of `count` coils (FC01), one byte per coil
+  virtual bool read_coils(int slave_id, int start_addr, int count, uint8_t* dest) = 0;
+
   virtual bool write_coil(int slave_id, int address, bool state) = 0;
 
-  virtual std::unique_ptr<ModbusManagerStats> get_stats() const = 0;
-  virtual void reset_stats() = 0;
+  // Sets `count` coils from `start_addr` on every slave at once (unit id 0,
+  // FC15; FC05 for a single coil). Slaves do not answer broadcasts, so true
+  // only means the frame went out. Managers without broadcasts return false.
+  virtual bool broadcast_coils(int start_addr, int count, bool state) { return false; }
+
+  virtual ModbusManagerStats get_stats() const = 0;
 };
\ No newline at end of file
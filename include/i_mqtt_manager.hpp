@@ -4,9 +4,24 @@
 #include <cstdint>
 #include <functional>
 #include <string>
+#include <vector>
 
 using MqttMessageCallback = std::function<void(const std::string& topic, const std::string& payload)>;
-struct MqttManagerStats;
+
+// Totals since start; counters only ever increase
+struct MqttManagerStats {
+  uint64_t publish_success;
+  uint64_t publish_errors;
+  uint64_t messages_received;
+
+  MqttManagerStats();
+  MqttManagerStats(uint64_t ps, uint64_t pe, uint64_t mr);
+};
+
+struct MqttMessage {
+  std::string topic;
+  std::string payload;
+};
 
 class IMqttManager {
  public:
@@ -19,8 +34,19 @@ class IMqttManager {
   virtual bool subscribe(const std::string& topic) = 0;
   virtual bool publish(const std::string& topic, const std::string& payload, bool retained = true) = 0;
 
+  // Publishes all messages and returns how many were delivered. Managers
+  // that can pipeline override this; the default publishes one at a time.
+  virtual std::size_t publish_batch(const std::vector<MqttMessage>& messages, bool retained = true) {
+    std::size_t published = 0;
+    for (const auto& message : messages) {
+      if (publish(message.topic, message.payload, retained)) {
+        published++;
+      }
+    }
+    return published;
+  }
+
   virtual void set_message_callback(MqttMessageCallback callback) = 0;
 
-  virtual std::unique_ptr<MqttManagerStats> get_stats() const = 0;
-  virtual void reset_stats() = 0;
+  virtual MqttManagerStats get_stats() const = 0;
 };
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bit-packed snapshot of a slave's discrete inputs.
+// Bit N of the image is stored in words_[N / 64] at position N % 64, so two
+// images can be compared a whole word at a time and only differing bits
+// need to be visited.
+class InputImage {
+ public:
+  static constexpr std::size_t kBitsPerWord = 64;
+
+  explicit InputImage(std::size_t bit_count = 0);
+
+  void resize(std::size_t bit_count);
+  void clear();
+
+  std::size_t bit_count() const { return bit_count_; }
+
+  std::size_t word_count() const { return words_.size(); }
+
+  const uint64_t* words() const { return words_.data(); }
+
+  bool test(std::size_t bit) const { return (words_[bit / kBitsPerWord] >> (bit % kBitsPerWord)) & 1u; }
+
+  void set(std::size_t bit, bool value);
+
+  // Load `count` bits starting at `first_bit` from libmodbus' one-byte-per-bit layout
+  void load_bits(std::size_t first_bit, const uint8_t* bits, std::size_t count);
+
+  // Number of set bits in the image
+  std::size_t count() const;
+
+  bool equals(const InputImage& other) const;
+
+  // Calls visit(bit, new_value) for every bit that differs from `previous`.
+  // Images must have the same size.
+  template <typename Visitor>
+  void for_each_change(const InputImage& previous, Visitor&& visit) const {
+    for (std::size_t w = 0; w < words_.size(); w++) {
+      uint64_t diff = words_[w] ^ previous.words_[w];
+      while (diff != 0) {
+        const std::size_t bit = w * kBitsPerWord + static_cast<std::size_t>(__builtin_ctzll(diff));
+        visit(bit, test(bit));
+        diff &= diff - 1;
+      }
+    }
+  }
+
+  void swap(InputImage& other) noexcept;
+
+ private:
+  // Images at least this large are compared with the vector path when available
+  static constexpr std::size_t kSimdMinWords = 4;
+
+  std::vector<uint64_t> words_;
+  std::size_t bit_count_;
+};
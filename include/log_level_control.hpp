@@ -0,0 +1,56 @@
+#pragma once
+
+#include "i_mqtt_manager.hpp"
+#include "logger/logger.hpp"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Changes log levels of named components at runtime over MQTT.
+//
+// Commands arrive on "<prefix>/<component>/set", where <component> is a
+// logger context (ModbusManager, MqttManager, DeviceController, ...) or
+// "global". The payload is a level name, "default" to drop the override, or
+// {"level": "debug", "revert_after_sec": 300}. Overrides revert on their own
+// after revert_after_sec (or the configured default; 0 keeps them).
+// Levels below the compiled-in floor (LOG_COMPILE_MIN_LEVEL) are raised to
+// it. The levels in effect are published retained on "<prefix>/levels".
+class LogLevelControl {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  LogLevelControl(const std::string& topic_prefix, int default_revert_sec, IMqttManager& mqtt);
+
+  // Topic filter to subscribe to
+  std::string subscription() const { return topic_prefix_ + "/+/set"; }
+
+  // Returns false if the topic is not a log level command. Called from the
+  // MQTT callback thread; only applies the level, publishing is left to tick().
+  bool handle_command(const std::string& topic, const std::string& payload, Clock::time_point now = Clock::now());
+
+  // Reverts expired overrides and publishes the level table after changes
+  void tick(Clock::time_point now = Clock::now());
+
+  // Level the "global" override reverts to (after a configuration reload)
+  void set_default_global_level(LogLevel level);
+
+ private:
+  static constexpr const char* kGlobalComponent = "global";
+
+  std::string topic_prefix_;
+  std::chrono::seconds default_revert_;
+  IMqttManager& mqtt_;
+  LogLevel configured_global_;
+
+  std::mutex mutex_;
+  std::map<std::string, Clock::time_point> revert_at_;
+  bool dirty_;
+
+  Logger logger_;
+
+  bool apply(const std::string& component, const std::string& payload, Clock::time_point now);
+  void revert(const std::string& component);
+  std::string levels_json() const;
+};
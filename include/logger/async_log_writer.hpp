@@ -0,0 +1,56 @@
+#pragma once
+
+#include "logger/log_ring.hpp"
+#include "logger/logger.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Background writer for Logger's asynchronous mode.
+// Producers push records into a bounded lock-free ring; the writer thread
+// drains it in batches and issues one write() per stream per batch.
+class AsyncLogWriter {
+ public:
+  AsyncLogWriter(std::size_t queue_size, LogOverflowPolicy policy);
+  ~AsyncLogWriter();
+
+  // Prevent copying
+  AsyncLogWriter(const AsyncLogWriter&) = delete;
+  AsyncLogWriter& operator=(const AsyncLogWriter&) = delete;
+
+  // False once the writer has stopped; the record is then left for the caller to write
+  bool push(LogRecord&& record);
+
+  // Joins the writer thread and writes everything queued, including records
+  // from producers that were inside push() when it was called
+  void stop();
+
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  static constexpr std::size_t kBatchSize = 256;
+  static constexpr std::chrono::milliseconds kIdleWait{50};
+
+  BoundedMpscQueue<LogRecord> queue_;
+  LogOverflowPolicy policy_;
+
+  std::atomic<bool> running_;
+  std::atomic<int> producers_;  // threads inside push(); stop() waits for them
+  std::atomic<bool> idle_;
+  std::atomic<uint64_t> dropped_;
+  uint64_t reported_dropped_;
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+
+  std::string out_buffer_;
+  std::string err_buffer_;
+
+  std::thread thread_;
+
+  void run();
+  std::size_t drain();
+};
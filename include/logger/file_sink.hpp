@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct FileSinkOptions {
+  std::string path;
+  std::size_t max_size_bytes = 10 * 1024 * 1024;
+  int max_files = 5;        // rotated files kept next to the active one
+  bool compress = true;     // gzip rotated files
+  bool preallocate = true;  // reserve max_size_bytes up front with fallocate
+  int reopen_delay_ms = 1000;  // first retry when the file cannot be reopened, doubling up to a minute
+};
+
+// Append-only log file with size-based rotation.
+// The active file is preallocated so appends do not grow the extent on every
+// write. When it would exceed max_size_bytes it is renamed aside and a fresh
+// file is opened; shifting the numbered history (path.1, path.2, ...) and
+// compressing the rotated file happen on a background thread.
+// If the file cannot be reopened after a rotation, lines go to stderr until
+// a later write manages to reopen it.
+class FileLogSink {
+ public:
+  // Throws std::runtime_error if the file cannot be opened
+  explicit FileLogSink(FileSinkOptions options);
+  ~FileLogSink();
+
+  // Prevent copying
+  FileLogSink(const FileLogSink&) = delete;
+  FileLogSink& operator=(const FileLogSink&) = delete;
+
+  // Thread-safe; data should consist of whole lines
+  void write(const char* data, std::size_t size);
+  void write(const std::string& data) { write(data.data(), data.size()); }
+
+  // Closes the file and waits for pending rotations to finish
+  void close();
+
+  const std::string& path() const { return options_.path; }
+
+  std::size_t size() const;
+  uint64_t rotations() const { return rotations_.load(std::memory_order_relaxed); }
+  uint64_t open_failures() const { return open_failures_.load(std::memory_order_relaxed); }
+
+  // Blocks until all queued rotations have been shifted/compressed
+  void wait_idle();
+
+ private:
+  FileSinkOptions options_;
+
+  mutable std::mutex mutex_;
+  int fd_;
+  std::size_t size_;
+  uint64_t sequence_;
+  std::atomic<uint64_t> rotations_;
+  std::atomic<uint64_t> open_failures_;
+  bool closed_;
+  std::chrono::steady_clock::time_point reopen_at_;
+  std::chrono::milliseconds reopen_delay_;
+
+  std::mutex pending_mutex_;
+  std::condition_variable pending_cv_;
+  std::deque<std::string> pending_;
+  std::size_t in_progress_;
+  bool stopping_;
+  std::thread worker_;
+
+  void open_file();
+  bool reopen();  // retries open_file() once the backoff has passed
+  void rotate();
+  void run();
+  void archive(const std::string& rotated);
+  std::string history_name(int index, bool compressed) const;  // path.N or path.N.gz
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "logger/logger.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+
+// Token-bucket limiter for repetitive log lines.
+// Each (call site, key) pair gets its own bucket holding up to `burst`
+// tokens that refill at `rate_per_sec`; a line is written only when a token
+// is available. Lines that were skipped are counted and reported with the
+// next line that gets through.
+class LogRateLimiter {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  LogRateLimiter(double rate_per_sec, double burst);
+
+  // Returns true if the line may be written. `suppressed` receives the number
+  // of lines dropped for this bucket since the last one that was allowed.
+  bool allow(const void* site, int64_t key, uint64_t& suppressed, Clock::time_point now = Clock::now());
+
+  // Total lines dropped over the limiter's lifetime
+  uint64_t suppressed_total() const;
+
+ private:
+  // Buckets beyond this are pruned once they have refilled
+  static constexpr std::size_t kMaxBuckets = 1024;
+
+  struct Bucket {
+    double tokens;
+    Clock::time_point last;
+    uint64_t suppressed;
+  };
+
+  double rate_per_sec_;
+  double burst_;
+
+  mutable std::mutex mutex_;
+  std::map<std::pair<const void*, int64_t>, Bucket> buckets_;
+  uint64_t suppressed_total_;
+
+  void prune(Clock::time_point now);
+};
+
+// Unique address per expansion, identifying the call site
+#define LOG_SITE_ID                 \
+  ([]() -> const void* {            \
+    static const char log_site = 0; \
+    return &log_site;               \
+  }())
+
+// Rate-limited logging, keyed by call site and `key` (e.g. a slave id):
+//   LOG_LIMITED(logger_, LogLevel::LEVEL_ERROR, error_limiter_, slave_id) << "Read failed";
+// Nothing is evaluated if the level is disabled or the bucket is empty.
+#define LOG_LIMITED(logger, level, limiter, key)                                                               \
+  if (uint64_t log_suppressed = 0; static_cast<int>(level) < LOG_COMPILE_MIN_LEVEL ||                          \
+                                   !(logger).is_enabled(level) ||                                              \
+                                   !(limiter).allow(LOG_SITE_ID, static_cast<int64_t>(key), log_suppressed)) { \
+  } else                                                                                                       \
+    (logger).stream(level).suppressed(log_suppressed)
@@ -1,14 +1,87 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 enum class LogLevel { LEVEL_DEBUG = 0, LEVEL_INFO = 1, LEVEL_WARNING = 2, LEVEL_ERROR = 3, LEVEL_CRITICAL = 4 };
 
+// What an asynchronous logger does when its queue is full
+enum class LogOverflowPolicy { DROP, BLOCK };
+
+// Line layout: colored human-readable text or one JSON object per line
+enum class LogFormat { TEXT, JSON };
+
+// Structured key/value attached to a log line, e.g.
+//   LOG_ERROR(logger_) << "Read failed" << log_field("slave", slave_id);
+struct LogField {
+  std::string key;
+  std::string value;
+};
+
+template <typename T>
+LogField log_field(std::string key, const T& value) {
+  std::ostringstream oss;
+  oss << value;
+  return LogField{std::move(key), oss.str()};
+}
+
+inline LogField log_field(std::string key, std::string value) {
+  return LogField{std::move(key), std::move(value)};
+}
+
+inline LogField log_field(std::string key, const char* value) {
+  return LogField{std::move(key), value};
+}
+
+struct LogRecord {
+  LogLevel level;
+  std::chrono::system_clock::time_point time;
+  std::string context;
+  std::string message;
+  std::vector<LogField> fields = {};
+  std::chrono::steady_clock::time_point monotonic = std::chrono::steady_clock::now();
+};
+
+// Level override shared by all loggers with the same context name.
+// Entries live for the whole process so loggers can hold raw pointers.
+struct LogComponent {
+  static constexpr int kNoOverride = -1;
+  std::atomic<int> override_level{kNoOverride};
+};
+
+class AsyncLogWriter;
+class FileLogSink;
+struct FileSinkOptions;
+
+// Lowest level compiled into the binary (numeric LogLevel); statements below it
+// are removed by the compiler. Set through the LOG_COMPILE_MIN_LEVEL CMake option.
+#ifndef LOG_COMPILE_MIN_LEVEL
+#define LOG_COMPILE_MIN_LEVEL 0
+#endif
+
+// Level-gated logging: the stream and its arguments are only evaluated when
+// the level is compiled in and enabled at runtime, e.g.
+//   LOG_DEBUG(logger_) << "value: " << expensive();
+#define LOG_AT(logger, level)                                                           \
+  if (static_cast<int>(level) < LOG_COMPILE_MIN_LEVEL || !(logger).is_enabled(level)) { \
+  } else                                                                                \
+    (logger).stream(level)
+
+#define LOG_DEBUG(logger) LOG_AT(logger, LogLevel::LEVEL_DEBUG)
+#define LOG_INFO(logger) LOG_AT(logger, LogLevel::LEVEL_INFO)
+#define LOG_WARNING(logger) LOG_AT(logger, LogLevel::LEVEL_WARNING)
+#define LOG_ERROR(logger) LOG_AT(logger, LogLevel::LEVEL_ERROR)
+#define LOG_CRITICAL(logger) LOG_AT(logger, LogLevel::LEVEL_CRITICAL)
+
 class Logger {
  public:
   explicit Logger(const std::string& context = "");
@@ -21,10 +94,47 @@ class Logger {
   void set_level(LogLevel level);
   LogLevel get_level() const;
 
+  // Per-component overrides. Loggers sharing a context name form one
+  // component; an override replaces both the global and instance levels for
+  // it until cleared. Unknown names are rejected.
+  static bool set_component_level(const std::string& component, LogLevel level);
+  static bool clear_component_level(const std::string& component);
+  // Override in effect, or false if the component only follows the defaults
+  static bool get_component_level(const std::string& component, LogLevel& level);
+  static std::vector<std::string> components();
+
+  // "debug", "INFO", "warn", ... (case-insensitive)
+  static bool parse_level(const std::string& name, LogLevel& level);
+  static std::string get_level_string(LogLevel level);
+
   // Enable/disable timestamps and colors
   static void enable_timestamps(bool enable);
   static void enable_colors(bool enable);
 
+  // Asynchronous mode: records are queued to a background writer thread
+  // instead of being written (and flushed) on the calling thread
+  static void enable_async(std::size_t queue_size = 4096, LogOverflowPolicy policy = LogOverflowPolicy::DROP);
+  // Drains the queue and returns to synchronous writes
+  static void disable_async();
+  static bool is_async();
+  static uint64_t dropped_count();
+
+  static void set_format(LogFormat format);
+  static LogFormat get_format();
+
+  // Sends all output to a rotating file instead of stdout/stderr.
+  // Throws std::runtime_error if the file cannot be opened.
+  static void enable_file_output(const FileSinkOptions& options);
+  static void disable_file_output();
+  static FileLogSink* file_sink();
+
+  // Formats a record as one output line (without the trailing newline)
+  static void format_record(const LogRecord& record, std::string& out);
+
+  // Appends "YYYY-mm-dd HH:MM:SS.mmm" in local time
+  static constexpr std::size_t kTimestampLength = 23;
+  static void append_timestamp(std::chrono::system_clock::time_point time, std::string& out);
+
   class LogStream {
    public:
     LogStream(Logger& logger, LogLevel level);
@@ -38,6 +148,19 @@ class Logger {
       return *this;
     }
 
+    LogStream& operator<<(LogField field) {
+      if (should_log_) {
+        fields_.push_back(std::move(field));
+      }
+      return *this;
+    }
+
+    // Number of similar lines dropped before this one (see LogRateLimiter)
+    LogStream& suppressed(uint64_t count) {
+      suppressed_ = count;
+      return *this;
+    }
+
     // Specialization for manipulators like std::endl
     LogStream& operator<<(std::ostream& (*manip)(std::ostream&)) {
       if (should_log_) {
@@ -51,8 +174,21 @@ class Logger {
     LogLevel level_;
     bool should_log_;
     std::ostringstream stream_;
+    std::vector<LogField> fields_;
+    uint64_t suppressed_ = 0;
   };
 
+  // Cheap runtime check used by the LOG_* macros
+  bool is_enabled(LogLevel level) const {
+    const int override_level = component_->override_level.load(std::memory_order_relaxed);
+    if (override_level != LogComponent::kNoOverride) {
+      return static_cast<int>(level) >= override_level;
+    }
+    return level >= instance_level_ && level >= global_level_.load(std::memory_order_relaxed);
+  }
+
+  LogStream stream(LogLevel level);
+
   LogStream debug();
   LogStream info();
   LogStream warning();
@@ -65,17 +201,21 @@ class Logger {
  private:
   std::string context_;
   LogLevel instance_level_;
+  LogComponent* component_;
 
-  static LogLevel global_level_;
-  static bool timestamps_enabled_;
-  static bool colors_enabled_;
+  static std::atomic<LogLevel> global_level_;
+  static std::atomic<bool> timestamps_enabled_;
+  static std::atomic<bool> colors_enabled_;
   static std::mutex mutex_;
+  static std::atomic<AsyncLogWriter*> async_writer_;
+  static std::atomic<FileLogSink*> file_sink_;
+  static std::atomic<LogFormat> format_;
 
   bool should_log(LogLevel level) const;
-  std::string get_timestamp() const;
-  std::string get_level_string(LogLevel level) const;
-  std::string get_level_color(LogLevel level) const;
-  void write_log(LogLevel level, const std::string& message);
+  static std::string get_level_color(LogLevel level);
+  static void format_text(const LogRecord& record, std::string& out);
+  static void format_json(const LogRecord& record, std::string& out);
+  void write_log(LogLevel level, std::string message, std::vector<LogField> fields = {});
 
   friend class LogStream;
 };
\ No newline at end of file
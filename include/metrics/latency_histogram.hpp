@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// HDR-style log-linear latency histogram with microsecond resolution.
+// Every power of two is split into 16 linear sub-buckets, which keeps the
+// relative error of reported values below ~6% up to ~19 hours. Recording is
+// a handful of relaxed atomic operations and never allocates or locks.
+class LatencyHistogram {
+ public:
+  static constexpr std::size_t kSubBucketBits = 4;
+  static constexpr std::size_t kSubBucketCount = std::size_t{1} << kSubBucketBits;
+  static constexpr std::size_t kMaxMagnitude = 36;
+  static constexpr std::size_t kBucketCount = kSubBucketCount + (kMaxMagnitude - kSubBucketBits) * kSubBucketCount;
+
+  struct Snapshot {
+    std::array<uint64_t, kBucketCount> counts{};
+    uint64_t count = 0;
+    uint64_t sum_us = 0;
+    uint64_t max_us = 0;
+
+    // Highest value equivalent to the given percentile (0-100), in microseconds
+    uint64_t percentile(double p) const;
+    double mean_us() const { return count > 0 ? static_cast<double>(sum_us) / count : 0.0; }
+
+    // Samples recorded since `earlier`; max is approximated from the highest non-empty bucket
+    Snapshot since(const Snapshot& earlier) const;
+  };
+
+  LatencyHistogram();
+
+  // Prevent copying
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  void record_us(uint64_t value_us);
+
+  template <typename Rep, typename Period>
+  void record(std::chrono::duration<Rep, Period> elapsed) {
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    record_us(us > 0 ? static_cast<uint64_t>(us) : 0);
+  }
+
+  Snapshot snapshot() const;
+
+  static std::size_t bucket_index(uint64_t value_us);
+  static uint64_t bucket_lower_bound(std::size_t index);
+  static uint64_t bucket_upper_bound(std::size_t index);
+
+ private:
+  std::array<std::atomic<uint64_t>, kBucketCount> counts_;
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_us_;
+  std::atomic<uint64_t> max_us_;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "metrics/latency_histogram.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Counters and gauges sit on their own cache line so the poll thread and the
+// MQTT callback thread never false-share when updating neighbouring metrics.
+constexpr std::size_t kCacheLineSize = 64;
+
+class alignas(kCacheLineSize) Counter {
+ public:
+  void inc(uint64_t n = 1) noexcept { value_.fetch_add(n, std::memory_order_relaxed); }
+
+  uint64_t value() const noexcept { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> value_{0};
+};
+
+class alignas(kCacheLineSize) Gauge {
+ public:
+  void set(double value) noexcept { value_.store(value, std::memory_order_relaxed); }
+
+  double value() const noexcept { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<double> value_{0.0};
+};
+
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+// Process-wide catalog of metrics for the OpenMetrics endpoint.
+// Metrics are owned by the components that update them; the registry only
+// keeps pointers, which are removed when the returned Registration is destroyed.
+class MetricsRegistry {
+ public:
+  class Registration {
+   public:
+    Registration() : registry_(nullptr), id_(0) {}
+    Registration(MetricsRegistry* registry, uint64_t id) : registry_(registry), id_(id) {}
+    Registration(Registration&& other) noexcept;
+    Registration& operator=(Registration&& other) noexcept;
+    ~Registration();
+
+    Registration(const Registration&) = delete;
+    Registration& operator=(const Registration&) = delete;
+
+   private:
+    MetricsRegistry* registry_;
+    uint64_t id_;
+  };
+
+  MetricsRegistry() : next_id_(1) {}
+
+  // Prevent copying
+  MetricsRegistry(const MetricsRegistry&) = delete;
+  MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+  static MetricsRegistry& instance();
+
+  Registration add_counter(const std::string& name, const std::string& help, const MetricLabels& labels,
+                           const Counter& counter);
+  Registration add_gauge(const std::string& name, const std::string& help, const MetricLabels& labels,
+                         const Gauge& gauge);
+  Registration add_histogram(const std::string& name, const std::string& help, const MetricLabels& labels,
+                             const LatencyHistogram& histogram);
+
+  // OpenMetrics text exposition of every registered metric
+  std::string render() const;
+
+  std::size_t size() const;
+
+ private:
+  enum class Type { COUNTER, GAUGE, HISTOGRAM };
+
+  struct Entry {
+    uint64_t id;
+    Type type;
+    std::string name;
+    std::string help;
+    MetricLabels labels;
+    const void* metric;
+  };
+
+  mutable std::mutex mutex_;
+  std::vector<Entry> entries_;
+  uint64_t next_id_;
+
+  Registration add(Type type, const std::string& name, const std::string& help, const MetricLabels& labels,
+                   const void* metric);
+  void remove(uint64_t id);
+};
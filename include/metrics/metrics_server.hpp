@@ -0,0 +1,40 @@
+#pragma once
+
+#include "config.hpp"
+#include "logger/logger.hpp"
+#include "metrics/metrics.hpp"
+
+#include <atomic>
+#include <thread>
+
+// Minimal HTTP/1.0 listener serving the registry as OpenMetrics text on GET /metrics
+class MetricsServer {
+ public:
+  explicit MetricsServer(const MetricsConfig& config, MetricsRegistry& registry = MetricsRegistry::instance());
+  ~MetricsServer();
+
+  // Prevent copying
+  MetricsServer(const MetricsServer&) = delete;
+  MetricsServer& operator=(const MetricsServer&) = delete;
+
+  bool start();
+  void stop();
+
+  bool is_running() const { return running_; }
+
+  // Port actually bound (useful when configured with port 0)
+  int port() const { return bound_port_; }
+
+ private:
+  MetricsConfig config_;
+  MetricsRegistry& registry_;
+  int listen_fd_;
+  int bound_port_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+
+  Logger logger_;
+
+  void serve();
+  void handle_client(int client_fd);
+};
@@ -1,27 +1,30 @@
 #pragma once
 
+#include "bus_timing.hpp"
+#include "clock.hpp"
 #include "config.hpp"
+#include "device_profile.hpp"
 #include "i_modbus_manager.hpp"
+#include "logger/log_rate_limiter.hpp"
 #include "logger/logger.hpp"
+#include "metrics/metrics.hpp"
+#include "rtu/rtu_bus.hpp"
+#include "rtu/rtu_event_loop.hpp"
 
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
 #include <modbus/modbus.h>
 #include <mutex>
-
-struct ModbusManagerStats {
-  int read_success;
-  int read_errors;
-  int write_success;
-  int write_errors;
-
-  ModbusManagerStats();
-  ModbusManagerStats(int rs, int re, int ws, int we);
-};
+#include <vector>
 
 class ModbusManager : public IModbusManager {
  public:
-  explicit ModbusManager(const ModbusConfig& config);
+  // Retry backoff and inter-frame delays sleep on `clock`. config.transport
+  // picks libmodbus or the native RtuBus; both share retries and metrics.
+  explicit ModbusManager(const ModbusConfig& config, Clock& clock = Clock::steady());
   virtual ~ModbusManager();
 
   // Prevent copying
@@ -34,24 +37,79 @@ class ModbusManager : public IModbusManager {
   bool is_connected() const override { return connected_; }
 
   virtual bool read_discrete_inputs(int slave_id, int start_addr, std::array<uint8_t, 8>& dest) override;
+  bool read_input_bits(int slave_id, int start_addr, int count, uint8_t* dest) override;
+  bool read_coils(int slave_id, int start_addr, int count, uint8_t* dest) override;
   virtual bool write_coil(int slave_id, int address, bool state) override;
+  // Not retried: a lost broadcast cannot be told from a delivered one
+  bool broadcast_coils(int start_addr, int count, bool state) override;
+
+  // Function codes and inter-frame delay per slave; unlisted slaves get the
+  // generic profile (FC02 reads, FC05 writes, no delay)
+  void set_device_profiles(const std::map<int, DeviceProfile>& profiles);
+
+  ModbusManagerStats get_stats() const override;
 
-  std::unique_ptr<ModbusManagerStats> get_stats() const override;
-  void reset_stats() override;
+  // Applies new settings. Timeout/retry changes keep the port open; a
+  // different line (port, baud rate, framing) reopens it.
+  bool reconfigure(const ModbusConfig& config);
+
+  const ModbusConfig& config() const { return config_; }
 
  private:
   ModbusConfig config_;
+  RtuTimeouts timeouts_;  // resolved from config_
   modbus_t* ctx_;
+  // Native transport: the bus and the loop this manager drives it with
+  std::unique_ptr<RtuBus> bus_;
+  std::unique_ptr<RtuEventLoop> loop_;
   bool connected_;
+  Clock& clock_;
   mutable std::mutex mutex_;
 
   Logger logger_;
 
-  std::atomic<int> read_success_;
-  std::atomic<int> read_errors_;
-  std::atomic<int> write_success_;
-  std::atomic<int> write_errors_;
+  // Per slave and call site: a short burst, then one line every 10 s
+  static constexpr double kErrorLogRate = 0.1;
+  static constexpr double kErrorLogBurst = 3;
+  LogRateLimiter error_log_limiter_;
+
+  struct SlaveMetrics {
+    Counter read_success;
+    Counter read_errors;
+    Counter write_success;
+    Counter write_errors;
+    std::vector<MetricsRegistry::Registration> registrations;
+  };
+
+  // Bus totals
+  Counter read_success_;
+  Counter read_errors_;
+  Counter write_success_;
+  Counter write_errors_;
+  Counter retries_;
+  Counter broadcasts_;
+  Gauge connected_gauge_;
+
+  // How to address one slave, resolved from its device profile
+  struct SlaveProtocol {
+    ModbusFunction read_function = ModbusFunction::READ_DISCRETE_INPUTS;
+    ModbusFunction write_function = ModbusFunction::WRITE_SINGLE_COIL;
+    std::chrono::milliseconds inter_frame_delay{0};
+  };
+
+  std::map<int, SlaveProtocol> slave_protocols_;
+  std::map<int, std::unique_ptr<SlaveMetrics>> slave_metrics_;
+  std::vector<MetricsRegistry::Registration> metric_registrations_;
 
-  bool read_with_retry(int slave_id, int start_addr, std::array<uint8_t, 8>& dest);
+  SlaveMetrics& slave_metrics(int slave_id);
+  void register_bus_metrics();
+  bool open_libmodbus();
+  bool open_native();
+  void apply_timeouts();
+  void wait_out_reply(std::chrono::microseconds silence);
+  SlaveProtocol protocol(int slave_id) const;
+  bool read_with_retry(int slave_id, int start_addr, int count, uint8_t* dest, bool coils);
   bool write_with_retry(int slave_id, int address, bool state);
+  // One attempt over either transport; errno describes a failure
+  bool transact(const RtuRequest& request);
 };
@@ -2,19 +2,21 @@
 
 #include "config.hpp"
 #include "i_mqtt_manager.hpp"
+#include "logger/log_rate_limiter.hpp"
 #include "logger/logger.hpp"
+#include "metrics/metrics.hpp"
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
 #include <mqtt/async_client.h>
 #include <mutex>
-
-struct MqttManagerStats {
-  int publish_success;
-  int publish_errors;
-  int messages_received;
-
-  MqttManagerStats(int ps, int pe, int mr);
-};
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 class MqttManager : public mqtt::callback, public IMqttManager {
  public:
@@ -27,28 +29,94 @@ class MqttManager : public mqtt::callback, public IMqttManager {
 
   bool connect();
   void disconnect();
+
+  // Returns immediately; a background thread connects, retrying with
+  // backoff until the broker answers. Until then retained publishes wait
+  // in the outbox and subscriptions are remembered; both are sent once the
+  // session is up. disconnect() stops the thread.
+  void connect_in_background();
   bool is_connected() const;
 
+  // While offline, subscriptions are made on connect and retained messages
+  // are kept in the outbox (latest payload per topic) and reported as sent;
+  // other messages are dropped.
   bool virtual subscribe(const std::string& topic);
   bool virtual publish(const std::string& topic, const std::string& payload, bool retained = true);
 
+  // Sends every message before waiting for any acknowledgement, so the
+  // batch costs about one round trip instead of one per message
+  std::size_t publish_batch(const std::vector<MqttMessage>& messages, bool retained = true) override;
+
+  bool unsubscribe(const std::string& topic);
+
   void set_message_callback(MqttMessageCallback callback);
 
-  std::unique_ptr<MqttManagerStats> get_stats() const;
-  void reset_stats();
+  // Applies new settings. A different broker or client id gets a new client;
+  // otherwise the session is reopened with the new options. Subscriptions
+  // are restored in both cases. If the background connector was running,
+  // the new session is opened by it and this does not block.
+  bool reconfigure(const MqttConfig& config);
+
+  const MqttConfig& config() const { return config_; }
+
+  MqttManagerStats get_stats() const;
 
  private:
   MqttConfig config_;
   std::unique_ptr<mqtt::async_client> client_;
   MqttMessageCallback message_callback_;
   mutable std::mutex mutex_;
+  std::set<std::string> subscriptions_;
+  std::map<std::string, std::string> outbox_;  // retained messages while offline, latest per topic
 
-  std::atomic<int> publish_success_;
-  std::atomic<int> publish_errors_;
-  std::atomic<int> messages_received_;
+  // Background connection; paho reconnects by itself once connected
+  std::thread connector_;
+  std::mutex connector_mutex_;
+  std::condition_variable connector_cv_;
+  bool connector_stop_ = false;
+  std::atomic<bool> connected_once_{false};
+  std::atomic<bool> connecting_{false};    // the next connected() callback answers connect()
+  std::atomic<bool> session_lost_{false};  // set on reconnect, the connector restores the session
+
+  struct TopicMetrics {
+    Counter publish_success;
+    Counter publish_errors;
+    std::vector<MetricsRegistry::Registration> registrations;
+  };
+
+  // Totals
+  Counter publish_success_;
+  Counter publish_errors_;
+  Counter messages_received_;
+  Gauge connected_gauge_;
+  Gauge outbox_depth_;
+  Counter outbox_dropped_;
+
+  std::unordered_map<std::string, std::unique_ptr<TopicMetrics>> topic_metrics_;
+  std::vector<MetricsRegistry::Registration> metric_registrations_;
 
   Logger logger_;
 
+  // Publish failures are usually broker-wide, so they share one bucket
+  static constexpr double kErrorLogRate = 0.1;
+  static constexpr double kErrorLogBurst = 3;
+
+  static constexpr std::size_t kOutboxLimit = 10000;  // topics
+  static constexpr std::chrono::milliseconds kReconnectMinDelay{500};
+  static constexpr std::chrono::milliseconds kReconnectMaxDelay{30000};
+  LogRateLimiter error_log_limiter_;
+
+  TopicMetrics& topic_metrics(const std::string& topic);
+  void register_broker_metrics();
+
+  bool publish_locked(const std::string& topic, const std::string& payload, bool retained);
+  std::size_t publish_batch_locked(const std::vector<MqttMessage>& messages, bool retained);
+  bool queue_offline(const std::string& topic, const std::string& payload, bool retained);
+  bool subscribe_locked(const std::string& topic);
+  bool restore_session();
+  void connector_loop();
+  void stop_connector();
+
   // MQTT callback overrides
   void message_arrived(mqtt::const_message_ptr msg) override;
   void connection_lost(const std::string& cause) override;
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "config.hpp"
+#include "device_profile.hpp"
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Normalized form of the configured points, built once per (re)load.
+// Everything at runtime refers to points by their index in `inputs` and
+// `relays`; names are only kept for logging.
+struct PointTable {
+  static constexpr std::size_t kReadBlockBits = 8;  // images cover whole blocks of 8 inputs
+
+  // Inputs of one slave, in the order they are read
+  struct Slave {
+    int slave_id;
+    std::size_t bit_count;                             // read from address 0
+    std::size_t read_bits;                             // per request, from the device profile
+    std::vector<std::vector<std::size_t>> bit_inputs;  // bit -> indices into inputs
+  };
+
+  std::vector<DigitalInput> inputs;
+  std::vector<Relay> relays;
+  std::vector<Slave> slaves;  // ascending slave id
+
+  // Command topic -> index into relays; covers the configured command topic
+  // and the legacy "modbus/relay/<name>/set" of every relay
+  std::unordered_map<std::string, std::size_t> command_routes;
+
+  // Relays switched together by one broadcast write, see BroadcastGroup
+  struct Group {
+    struct Member {
+      int slave_id;
+      std::vector<std::size_t> relays;  // indices into relays, ascending address
+    };
+
+    std::string name;
+    int address;
+    int count;
+    bool verify;
+    std::vector<Member> members;  // ascending slave id
+  };
+
+  std::vector<Group> groups;
+  std::unordered_map<std::string, std::size_t> group_routes;  // command topic -> index into groups
+
+  // Device profile of every slave that has points
+  std::map<int, DeviceProfile> profiles;
+};
+
+// JSON path each point was declared at, parallel to the point lists.
+// Points without an entry are reported as "/digital_inputs/<i>" and
+// "/relays/<i>".
+struct PointSources {
+  std::vector<std::string> inputs;
+  std::vector<std::string> relays;
+};
+
+// Checks the points against each other and builds the runtime tables.
+// Problems are appended to `diagnostics` with JSON paths into the config
+// file ("/relays/2/name"). Points that cannot be polled at all (negative
+// address) are left out of `slaves`; everything else is kept so a caller
+// that ignores errors still gets a usable table. Points are checked against
+// their slave's device profile (address range, function codes), which
+// also decides the read request size. Broadcast groups collect the relays
+// in their coil range.
+PointTable compile_points(const std::vector<DigitalInput>& inputs, const std::vector<Relay>& relays,
+                          std::vector<ConfigDiagnostic>& diagnostics, const PointSources& sources = {},
+                          const DeviceCatalog& catalog = DeviceCatalog(),
+                          const std::vector<BroadcastGroup>& groups = {});
+
+PointTable compile_points(const std::vector<DigitalInput>& inputs, const std::vector<Relay>& relays);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "config.hpp"
+#include "point_table.hpp"
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+// Expands the point declarations of a config file into plain point lists.
+//
+// Besides single points, "digital_inputs" and "relays" accept range
+// entries, where slave_id and address take a number, a range string such as
+// "48-51" or "0-7,12", or an array of those. One point is made for every
+// slave x address, with "{slave}", "{address}" and "{index}" (position in the
+// expansion) substituted in the name and topics:
+//
+//   {"slave_id": "48-51", "address": "0-7", "name": "button_{slave}_{address}"}
+//
+// "name" may instead be an array naming each expanded point in order.
+//
+// Module types group entries under "templates"; "modules" instantiates a
+// template on a range of slaves. A template entry's patterns may also use
+// "{module}", the module name after substitution:
+//
+//   "templates": {"din8": {"digital_inputs": [{"address": "0-7", "name": "{module}_{address}"}]}},
+//   "modules": [{"template": "din8", "slave_id": "48-51", "name": "buttons{slave}"}]
+//
+// Expanded points are reported as the declaring entry's path plus the
+// slave and address, e.g. "/modules/0[slave=49,address=3]".
+//
+// A template may name a device profile ("profile": "di8"); every slave a
+// module is instantiated on is then assigned that profile.
+struct ExpandedPoints {
+  struct ProfileAssignment {
+    int slave_id;
+    std::string profile;
+    std::string path;
+  };
+
+  std::vector<DigitalInput> inputs;
+  std::vector<Relay> relays;
+  PointSources sources;
+  std::vector<ProfileAssignment> profiles;
+};
+
+ExpandedPoints expand_points(const nlohmann::json& config, std::vector<ConfigDiagnostic>& diagnostics);
+
+// Parses a number, a range string ("0-7,12") or an array of those.
+// Throws std::invalid_argument.
+std::vector<int> parse_id_range(const nlohmann::json& j);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-16/MODBUS (reflected 0xA001, initial 0xFFFF) of an RTU frame. The
+// result goes on the wire low byte first. Slicing-by-8: eight bytes per
+// step through eight 256-entry tables, bytewise for the tail.
+uint16_t rtu_crc16(const uint8_t* data, std::size_t length);
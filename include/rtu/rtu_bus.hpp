@@ -0,0 +1,115 @@
+#pragma once
+
+#include "bus_timing.hpp"
+#include "config.hpp"
+#include "device_profile.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// One transaction on an RTU line; bit values are one byte per bit
+struct RtuRequest {
+  int unit_id = 1;
+  ModbusFunction function = ModbusFunction::READ_DISCRETE_INPUTS;
+  int address = 0;
+  int count = 1;                    // bits read or coils written
+  uint8_t* dest = nullptr;          // FC01/FC02 results
+  const uint8_t* values = nullptr;  // FC05/FC15 coil states
+};
+
+// Native Modbus RTU master for one serial line. Unlike libmodbus it never
+// blocks: the port is non-blocking and an event loop (RtuEventLoop) calls
+// process() when the fd is ready or deadline() has passed.
+//
+// Every request waits for t3.5 of silence after the last frame on the
+// line, replies are sized from the function code instead of waiting for a
+// gap, and frames are built in preallocated buffers. On the port a
+// transaction costs one write() and the read()s of its reply; leftover
+// input is only drained before a request when the previous one failed.
+// Input outside a reply is noise: it is dropped as it arrives and restarts
+// the silence.
+// The event loop adds its epoll_wait() per wakeup and, when a deadline is
+// armed and expires, a timerfd_settime() and a timerfd read. Writes to
+// unit id 0 are broadcasts: nothing is read back, and the next frame waits
+// a response timeout so the slaves can act on it.
+class RtuBus {
+ public:
+  using TimePoint = std::chrono::steady_clock::time_point;
+  // 0, an errno value, or libmodbus' codes for protocol errors (EMBBADCRC,
+  // MODBUS_ENOBASE + exception code, ...) so modbus_strerror() describes it
+  using Completion = std::function<void(int error)>;
+
+  static constexpr int kBroadcastUnit = 0;
+  static constexpr int kMaxReadBits = 2000;
+  static constexpr int kMaxWriteCoils = 1968;
+
+  RtuBus(const ModbusConfig& config, const RtuTimeouts& timeouts);
+  ~RtuBus();
+
+  RtuBus(const RtuBus&) = delete;
+  RtuBus& operator=(const RtuBus&) = delete;
+
+  // Opens the port in raw mode with the configured framing. Throws std::system_error.
+  void open();
+  void close();
+
+  bool is_open() const { return fd_ >= 0; }
+  int fd() const { return fd_; }
+  const std::string& port() const { return config_.port; }
+
+  void set_timeouts(const RtuTimeouts& timeouts) { timeouts_ = timeouts; }
+
+  // Starts a transaction and sends it right away if the line is quiet.
+  // False while another transaction runs; `done` is called from process().
+  // Throws std::invalid_argument for counts the protocol cannot carry.
+  bool submit(const RtuRequest& request, Completion done);
+  bool busy() const { return state_ != State::IDLE; }
+
+  // Drops whatever the line delivered outside a transaction; true if there was any
+  bool discard_input();
+
+  // What the event loop waits for
+  bool wants_write() const { return state_ == State::SENDING; }
+  bool has_deadline() const { return state_ != State::IDLE; }
+  TimePoint deadline() const { return state_ == State::WAITING_FOR_SILENCE ? quiet_at_ : reply_deadline_; }
+
+  // Sends, reads what arrived and checks the deadlines. `readable` says the
+  // fd has input, which outside a reply is drained as noise.
+  void process(TimePoint now, bool readable = false);
+
+ private:
+  enum class State { IDLE, WAITING_FOR_SILENCE, SENDING, RECEIVING };
+
+  // Largest RTU frame: unit id, PDU of up to 253 bytes, CRC
+  static constexpr std::size_t kMaxFrameSize = 256;
+
+  ModbusConfig config_;
+  BusTiming timing_;
+  RtuTimeouts timeouts_;
+  int fd_ = -1;
+
+  State state_ = State::IDLE;
+  RtuRequest request_;
+  Completion done_;
+
+  std::array<uint8_t, kMaxFrameSize> tx_{};
+  std::size_t tx_length_ = 0;
+  std::size_t tx_sent_ = 0;
+  std::array<uint8_t, kMaxFrameSize> rx_{};
+  std::size_t rx_length_ = 0;
+  std::size_t rx_expected_ = 0;
+
+  bool stale_input_ = false;    // the last transaction failed; a late reply may follow
+  TimePoint quiet_at_{};        // the next request may start
+  TimePoint reply_deadline_{};  // response or byte timeout
+
+  void build_frame();
+  void send(TimePoint now);
+  void receive(TimePoint now);
+  void update_expected_length();
+  int check_reply() const;
+  void finish(int error, TimePoint now);
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "rtu/rtu_bus.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// Drives any number of RtuBus instances from one thread: epoll on the
+// serial fds plus one timerfd per bus, so the t3.5 silence and the reply
+// timeouts expire with microsecond precision instead of epoll's
+// millisecond timeout. Timers are only re-armed when a deadline moves
+// earlier; an early expiry just re-arms.
+class RtuEventLoop {
+ public:
+  // Throws std::system_error
+  RtuEventLoop();
+  ~RtuEventLoop();
+
+  RtuEventLoop(const RtuEventLoop&) = delete;
+  RtuEventLoop& operator=(const RtuEventLoop&) = delete;
+
+  // The bus must be open and stay registered only while it is
+  void add(RtuBus& bus);
+  void remove(RtuBus& bus);
+
+  // Waits up to `timeout` for a ready fd or a deadline and advances the
+  // buses concerned. Returns how many were processed.
+  std::size_t run_once(std::chrono::milliseconds timeout);
+  // Until `bus` has finished its transaction
+  void run_until_idle(RtuBus& bus);
+
+ private:
+  struct Entry {
+    RtuBus* bus;
+    int fd;
+    int timer_fd;
+    bool write_armed = false;
+    bool timer_armed = false;
+    bool readable = false;  // the serial fd reported input this round
+    RtuBus::TimePoint timer_at{};
+  };
+
+  int epoll_fd_ = -1;
+  std::vector<Entry> entries_;
+  std::vector<Entry*> ready_;  // scratch for run_once()
+
+  Entry* find(int fd);
+  // Epoll interest and timer follow the bus state
+  void sync(Entry& entry);
+};
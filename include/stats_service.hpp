@@ -0,0 +1,59 @@
+#pragma once
+
+#include "i_modbus_manager.hpp"
+#include "i_mqtt_manager.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+// Rates and success ratios over a trailing window, derived from monotonic counters
+struct WindowStats {
+  std::chrono::seconds window;
+  std::chrono::seconds covered;  // Shorter than window until enough history exists
+
+  double read_rate;
+  double write_rate;
+  double publish_rate;
+  double receive_rate;
+
+  double read_success_ratio;
+  double write_success_ratio;
+  double publish_success_ratio;
+};
+
+// Keeps a ring of timestamped counter snapshots so windowed rates can be
+// computed without ever resetting the counters, by any number of readers.
+class StatsService {
+ public:
+  static constexpr std::chrono::seconds kDefaultSampleInterval{5};
+  static constexpr std::chrono::seconds kRetention{15 * 60};
+
+  StatsService(const IModbusManager& modbus, const IMqttManager& mqtt,
+               std::chrono::seconds sample_interval = kDefaultSampleInterval);
+
+  // Takes a snapshot if at least one sample interval passed since the previous one
+  void sample(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+  WindowStats window(std::chrono::seconds span) const;
+
+  std::size_t sample_count() const;
+
+ private:
+  struct Sample {
+    std::chrono::steady_clock::time_point time;
+    ModbusManagerStats modbus;
+    MqttManagerStats mqtt;
+  };
+
+  const IModbusManager& modbus_;
+  const IMqttManager& mqtt_;
+  std::chrono::seconds sample_interval_;
+
+  mutable std::mutex mutex_;
+  std::vector<Sample> ring_;
+  std::size_t head_;  // Next slot to write
+  std::size_t size_;
+
+  const Sample& at(std::size_t age) const;  // 0 = newest
+};
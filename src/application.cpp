@@ -1,62 +1,117 @@
 #include "application.hpp"
 
+#include "logger/file_sink.hpp"
+
 #include <iostream>
-#include <thread>
 
-Application::Application(const std::string& config_file)
-    : config_(std::make_unique<Config>(config_file)), logger_("Application") {}
+Application::Application(const std::string& config_file, Clock& clock)
+    : clock_(clock),
+      started_(clock.now()),
+      config_file_(config_file),
+      config_(std::make_unique<Config>(config_file)),
+      logger_("Application") {}
 
-Application::~Application() = default;
+Application::~Application() {
+  // The MQTT callback uses controller_ and log_control_, which are destroyed
+  // before mqtt_; stop it even when initialize() failed or shutdown() was skipped
+  if (mqtt_) {
+    mqtt_->disconnect();
+  }
+}
 
 bool Application::initialize() {
-  logger_.info() << "Modbus: " << config_->modbus().port << " @ " << config_->modbus().baudrate << " baud";
-  logger_.info() << "MQTT: " << config_->mqtt().broker_address;
-  logger_.info() << "Digital Inputs: " << config_->inputs().size();
-  logger_.info() << "Relays: " << config_->relays().size();
+  const LoggingConfig& logging = config_->logging();
+  apply_log_settings(logging);
+  log_diagnostics(*config_);
 
-  // Initialize Modbus
-  modbus_ = std::make_unique<ModbusManager>(config_->modbus());
-  if (!modbus_->connect()) {
-    logger_.critical() << "Failed to initialize Modbus";
-    return false;
+  if (!logging.file.path.empty()) {
+    FileSinkOptions options;
+    options.path = logging.file.path;
+    options.max_size_bytes = static_cast<std::size_t>(logging.file.max_size_mb) * 1024 * 1024;
+    options.max_files = logging.file.max_files;
+    options.compress = logging.file.compress;
+    options.preallocate = logging.file.preallocate;
+
+    try {
+      Logger::enable_file_output(options);
+    } catch (const std::exception& e) {
+      LOG_WARNING(logger_) << "Logging to console: " << e.what();
+    }
   }
 
-  // Initialize MQTT
-  mqtt_ = std::make_unique<MqttManager>(config_->mqtt());
-  if (!mqtt_->connect()) {
-    logger_.critical() << "Failed to initialize MQTT";
-    return false;
+  // Keep terminal/journal I/O off the poll thread
+  if (logging.async) {
+    Logger::enable_async(static_cast<std::size_t>(logging.queue_size),
+                         logging.overflow_policy == "block" ? LogOverflowPolicy::BLOCK : LogOverflowPolicy::DROP);
   }
 
-  // Subscribe to relay commands
-  // TODO: Make mqtt subscriptions bundled with device types in config
-  mqtt_->subscribe("modbus/relay/+/set");
+  LOG_INFO(logger_) << "Modbus: " << config_->modbus().port << " @ " << config_->modbus().baudrate << " baud";
+  LOG_INFO(logger_) << "MQTT: " << config_->mqtt().broker_address;
+  LOG_INFO(logger_) << "Digital Inputs: " << config_->inputs().size();
+  LOG_INFO(logger_) << "Relays: " << config_->relays().size();
 
-  // Initialize Device Controller
-  // TODO: Make device controller initialization bundled with device types in
-  // config
-  controller_ =
-      std::make_unique<DeviceController>(config_->inputs(), config_->relays(), config_->polling(), *modbus_, *mqtt_);
+  // Both links come up at once: MQTT connects in the background while the
+  // serial port opens. Until the broker answers, subscriptions are
+  // remembered and retained state waits in the outbox.
+  modbus_ = std::make_unique<ModbusManager>(config_->modbus(), clock_);
+  modbus_->set_device_profiles(config_->points()->profiles);
+  mqtt_ = std::make_unique<MqttManager>(config_->mqtt());
+
+  // Relay commands on the default topics; configured command topics outside
+  // the wildcard follow from the point table in update_command_subscriptions()
+  mqtt_->subscribe(kRelayCommandFilter);
+
+  // Runtime log level commands
+  log_control_ = std::make_unique<LogLevelControl>(logging.control_topic, logging.override_timeout_sec, *mqtt_);
+  mqtt_->subscribe(log_control_->subscription());
+
+  // Initialize Device Controller; request sizes follow each slave's device profile
+  controller_ = std::make_unique<DeviceController>(config_->points(), config_->polling(), *modbus_, *mqtt_, clock_);
+  report_cycle_budget();
+  update_command_subscriptions();
 
   // Set MQTT message callback
   mqtt_->set_message_callback([this](const std::string& topic, const std::string& payload) {
+    if (log_control_->handle_command(topic, payload, clock_.now())) {
+      return;
+    }
     controller_->handle_mqtt_command(topic, payload);
   });
 
-  logger_.info() << "Application initialized successfully";
+  mqtt_->connect_in_background();
+
+  // Without the bus there is nothing to do; a missing broker is not fatal
+  if (!modbus_->connect()) {
+    LOG_CRITICAL(logger_) << "Failed to initialize Modbus";
+    mqtt_->disconnect();
+    return false;
+  }
+
+  // Full retained state before the first poll cycle, instead of waiting
+  // for changes or the refresh interval
+  if (!controller_->synchronize(started_)) {
+    LOG_WARNING(logger_) << "Startup state incomplete, the poll loop fills in the rest";
+  }
+
+  start_metrics_server();
+
+  config_mtime_ = config_file_time();
+
+  LOG_INFO(logger_) << "Application initialized successfully";
 
   return true;
 }
 
-void Application::run(std::atomic<bool>& running, std::atomic<bool>& force_exit) {
+void Application::run(std::atomic<bool>& running, std::atomic<bool>& force_exit, std::atomic<bool>& dump_stats,
+                      std::atomic<bool>& reload) {
   controller_->start_watchdog(running, force_exit);
 
-  logger_.info() << "Starting main polling loop...";
-  logger_.info() << "Poll interval: " << config_->polling().poll_interval_ms << "ms";
-  logger_.info() << "Refresh interval: " << config_->polling().refresh_interval_sec << "s";
+  LOG_INFO(logger_) << "Starting main polling loop...";
+  LOG_INFO(logger_) << "Poll interval: " << config_->polling().poll_interval_ms << "ms";
+  LOG_INFO(logger_) << "Refresh interval: " << config_->polling().refresh_interval_sec << "s";
 
   while (running && !force_exit) {
-    auto start_time = std::chrono::steady_clock::now();
+    auto start_time = clock_.now();
 
     controller_->update_watchdog();
 
@@ -69,20 +124,41 @@ void Application::run(std::atomic<bool>& running, std::atomic<bool>& force_exit)
     // Print statistics
     controller_->print_statistics();
 
+    // Expire temporary log level overrides
+    log_control_->tick(clock_.now());
+
+    if (dump_stats.exchange(false)) {
+      controller_->dump_latency_statistics();
+    }
+
+    // Apply a new configuration between cycles (SIGHUP or file change)
+    if (reload.exchange(false) || config_file_changed(start_time)) {
+      reload_config();
+    }
+
     // Sleep for remaining time
-    auto end_time = std::chrono::steady_clock::now();
+    auto end_time = clock_.now();
+    controller_->record_cycle_time(end_time - start_time);
     auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
 
     int poll_interval = config_->polling().poll_interval_ms;
     if (elapsed < poll_interval)
-      std::this_thread::sleep_for(std::chrono::milliseconds(poll_interval - elapsed));
+      clock_.sleep_for(std::chrono::milliseconds(poll_interval - elapsed));
   }
 
-  logger_.info() << "Main loop terminated";
+  LOG_INFO(logger_) << "Main loop terminated";
 }
 
 void Application::shutdown() {
-  logger_.info() << "Shutting down application...";
+  LOG_INFO(logger_) << "Shutting down application...";
+
+  if (controller_) {
+    controller_->stop_watchdog();
+  }
+
+  if (metrics_server_) {
+    metrics_server_->stop();
+  }
 
   if (mqtt_) {
     mqtt_->disconnect();
@@ -92,5 +168,153 @@ void Application::shutdown() {
     modbus_->disconnect();
   }
 
-  logger_.info() << "Application shutdown complete";
-}
\ No newline at end of file
+  LOG_INFO(logger_) << "Application shutdown complete";
+}
+
+bool Application::reload_config() {
+  const auto start = clock_.now();
+
+  std::unique_ptr<Config> next;
+  try {
+    next = std::make_unique<Config>(config_file_);
+  } catch (const std::exception& e) {
+    LOG_ERROR(logger_) << "Configuration reload rejected, keeping current settings: " << e.what();
+    return false;
+  }
+
+  log_diagnostics(*next);
+
+  const ConfigDiff diff = diff_config(*config_, *next);
+  if (diff.empty()) {
+    LOG_INFO(logger_) << "Configuration reload: no changes";
+    return true;
+  }
+
+  // Connections are only touched when their own settings changed
+  if (diff.modbus && !modbus_->reconfigure(next->modbus())) {
+    LOG_ERROR(logger_) << "Modbus reconnect after reload failed";
+  }
+  if (diff.mqtt && !mqtt_->reconfigure(next->mqtt())) {
+    LOG_ERROR(logger_) << "MQTT reconnect after reload failed";
+  }
+
+  if (diff.points_changed() || diff.devices || diff.polling || diff.groups) {
+    modbus_->set_device_profiles(next->points()->profiles);
+    controller_->reload(next->points(), next->polling());
+    update_command_subscriptions();
+  }
+
+  if (diff.logging) {
+    // Async mode and the output file are fixed at startup
+    apply_log_settings(next->logging());
+  }
+
+  config_ = std::move(next);
+
+  if (diff.modbus || diff.points_changed() || diff.devices || diff.polling) {
+    report_cycle_budget();
+  }
+
+  if (diff.metrics) {
+    if (metrics_server_) {
+      metrics_server_->stop();
+      metrics_server_.reset();
+    }
+    start_metrics_server();
+  }
+
+  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(clock_.now() - start);
+  LOG_INFO(logger_) << "Configuration reloaded in " << elapsed.count() << "ms: " << diff.summary();
+  return true;
+}
+
+void Application::apply_log_settings(const LoggingConfig& logging) {
+  LogLevel level = LogLevel::LEVEL_INFO;
+  if (!Logger::parse_level(logging.level, level)) {
+    LOG_WARNING(logger_) << "Unknown log level '" << logging.level << "', using INFO";
+  }
+  if (log_control_) {
+    log_control_->set_default_global_level(level);
+  } else {
+    Logger::set_global_level(level);
+  }
+  Logger::set_format(logging.format == "json" ? LogFormat::JSON : LogFormat::TEXT);
+}
+
+void Application::report_cycle_budget() {
+  const CycleBudget budget = plan_cycle(*config_->points(), config_->polling(), BusTiming(config_->modbus()));
+  controller_->set_cycle_budget(budget);
+
+  auto ms = [](std::chrono::nanoseconds d) { return std::chrono::duration<double, std::milli>(d).count(); };
+  LOG_INFO(logger_) << "Bus plan: " << budget.read_requests << " reads per cycle, ~" << ms(budget.poll_time) << "ms of "
+                    << config_->polling().poll_interval_ms << "ms (" << 100.0 * budget.utilization() << "%), ~"
+                    << ms(budget.poll_time + budget.command_time) << "ms with "
+                    << config_->polling().max_commands_per_cycle << " commands";
+}
+
+void Application::log_diagnostics(const Config& config) {
+  // Errors never get here: Config throws on them
+  for (const auto& diagnostic : config.diagnostics()) {
+    LOG_WARNING(logger_) << "Config " << diagnostic.path << ": " << diagnostic.message;
+  }
+}
+
+void Application::start_metrics_server() {
+  // Optional, failure is not fatal
+  if (config_->metrics().enabled) {
+    metrics_server_ = std::make_unique<MetricsServer>(config_->metrics());
+    if (!metrics_server_->start()) {
+      LOG_WARNING(logger_) << "Metrics endpoint disabled";
+      metrics_server_.reset();
+    }
+  }
+}
+
+void Application::update_command_subscriptions() {
+  // Topics under the relay wildcard are already covered by its subscription
+  std::set<std::string> wanted;
+  const std::string prefix = "modbus/relay/";
+  const std::string suffix = "/set";
+  for (const auto& topic : controller_->command_topics()) {
+    const bool covered = topic.size() > prefix.size() + suffix.size() && topic.compare(0, prefix.size(), prefix) == 0 &&
+                         topic.compare(topic.size() - suffix.size(), suffix.size(), suffix) == 0 &&
+                         topic.find('/', prefix.size()) == topic.size() - suffix.size();
+    if (!covered) {
+      wanted.insert(topic);
+    }
+  }
+
+  for (const auto& topic : command_subscriptions_) {
+    if (wanted.count(topic) == 0) {
+      mqtt_->unsubscribe(topic);
+    }
+  }
+  for (const auto& topic : wanted) {
+    if (command_subscriptions_.count(topic) == 0) {
+      mqtt_->subscribe(topic);
+    }
+  }
+  command_subscriptions_ = std::move(wanted);
+}
+
+std::filesystem::file_time_type Application::config_file_time() const {
+  std::error_code ec;
+  auto time = std::filesystem::last_write_time(config_file_, ec);
+  return ec ? std::filesystem::file_time_type{} : time;
+}
+
+bool Application::config_file_changed(std::chrono::steady_clock::time_point now) {
+  const ReloadConfig& reload = config_->reload();
+  if (!reload.watch_file || now < next_config_check_) {
+    return false;
+  }
+  next_config_check_ = now + std::chrono::milliseconds(reload.watch_interval_ms);
+
+  const auto mtime = config_file_time();
+  if (mtime == config_mtime_) {
+    return false;
+  }
+  config_mtime_ = mtime;
+  LOG_INFO(logger_) << "Configuration file changed, reloading";
+  return true;
+}
@@ -0,0 +1,121 @@
+#include "bus_timing.hpp"
+
+#include "point_table.hpp"
+
+#include <algorithm>
+
+namespace {
+
+constexpr int kFixedGapBaudrate = 19200;
+constexpr std::chrono::microseconds kFixedFrameGap{1750};
+
+constexpr std::chrono::microseconds kMinByteTimeout{20000};
+constexpr std::chrono::microseconds kSlaveResponseAllowance{50000};
+constexpr std::chrono::milliseconds kFixedReadRetryDelay{30};
+constexpr std::chrono::milliseconds kFixedWriteRetryDelay{50};
+
+std::chrono::nanoseconds profile_delay(const PointTable& points, int slave_id) {
+  auto it = points.profiles.find(slave_id);
+  return it == points.profiles.end() ? std::chrono::nanoseconds(0)
+                                     : std::chrono::milliseconds(it->second.inter_frame_delay_ms);
+}
+
+}  // namespace
+
+BusTiming::BusTiming(const ModbusConfig& config, std::chrono::nanoseconds turnaround)
+    : baudrate_(std::max(config.baudrate, 1)),
+      bits_per_character_(1 + config.data_bits + (config.parity == 'N' ? 0 : 1) + config.stop_bits),
+      character_time_(std::chrono::nanoseconds(1000000000LL * bits_per_character_ / baudrate_)),
+      turnaround_(turnaround) {}
+
+std::chrono::nanoseconds BusTiming::frame_gap() const {
+  if (baudrate_ > kFixedGapBaudrate) {
+    return kFixedFrameGap;
+  }
+  return character_time_ * 7 / 2;
+}
+
+std::chrono::nanoseconds BusTiming::frame_time(std::size_t bytes) const {
+  return character_time_ * static_cast<int64_t>(bytes) + frame_gap();
+}
+
+std::chrono::nanoseconds BusTiming::transaction_time(std::size_t request_bytes, std::size_t response_bytes) const {
+  return frame_time(request_bytes) + turnaround_ + frame_time(response_bytes);
+}
+
+std::size_t BusTiming::write_coil_request_size(ModbusFunction function) {
+  // FC15: address, quantity, byte count and one data byte instead of FC05's value
+  return function == ModbusFunction::WRITE_MULTIPLE_COILS ? 10 : 8;
+}
+
+std::chrono::nanoseconds BusTiming::read_time(std::size_t count) const {
+  return transaction_time(kReadBitsRequestSize, read_bits_response_size(count));
+}
+
+std::chrono::nanoseconds BusTiming::write_time(ModbusFunction function) const {
+  return transaction_time(write_coil_request_size(function), kWriteCoilResponseSize);
+}
+
+double CycleBudget::utilization() const {
+  return interval.count() > 0 ? static_cast<double>(poll_time.count()) / interval.count() : 0.0;
+}
+
+double CycleBudget::utilization_with_commands() const {
+  return interval.count() > 0 ? static_cast<double>((poll_time + command_time).count()) / interval.count() : 0.0;
+}
+
+CycleBudget plan_cycle(const PointTable& points, const PollingConfig& polling, const BusTiming& timing) {
+  CycleBudget budget;
+  budget.interval = std::chrono::milliseconds(polling.poll_interval_ms);
+
+  // Same requests as DeviceController::read_slave_inputs
+  for (const auto& slave : points.slaves) {
+    const std::chrono::nanoseconds delay = profile_delay(points, slave.slave_id);
+    const std::size_t step = std::max<std::size_t>(slave.read_bits, 1);
+    for (std::size_t first = 0; first < slave.bit_count; first += step) {
+      budget.poll_time += timing.read_time(std::min(step, slave.bit_count - first)) + delay;
+      budget.read_requests++;
+    }
+  }
+
+  // Worst case: every command of the batch goes to the slowest relay
+  std::chrono::nanoseconds slowest_write{0};
+  for (const auto& relay : points.relays) {
+    ModbusFunction function = ModbusFunction::WRITE_SINGLE_COIL;
+    auto profile = points.profiles.find(relay.slave_id);
+    if (profile != points.profiles.end()) {
+      profile->second.write_function(function);
+    }
+    slowest_write = std::max(slowest_write, timing.write_time(function) + profile_delay(points, relay.slave_id));
+  }
+  budget.command_time = slowest_write * std::max(polling.max_commands_per_cycle, 0);
+
+  return budget;
+}
+
+RtuTimeouts rtu_timeouts(const ModbusConfig& config) {
+  using std::chrono::ceil;
+  using std::chrono::microseconds;
+  using std::chrono::milliseconds;
+
+  if (config.timing == "fixed") {
+    return {milliseconds(config.response_timeout_ms), milliseconds(config.byte_timeout_ms), kFixedReadRetryDelay,
+            kFixedWriteRetryDelay};
+  }
+
+  const BusTiming timing(config);
+  // Broadcasts are not answered and wait out their own frame, see ModbusManager::broadcast_coils
+  const std::size_t longest_request = std::max(
+      BusTiming::kReadBitsRequestSize, BusTiming::write_coil_request_size(ModbusFunction::WRITE_MULTIPLE_COILS));
+
+  RtuTimeouts timeouts;
+  timeouts.byte = config.byte_timeout_ms > 0 ? milliseconds(config.byte_timeout_ms)
+                                             : std::max(ceil<microseconds>(timing.frame_gap() * 2), kMinByteTimeout);
+  timeouts.response = config.response_timeout_ms > 0
+                          ? milliseconds(config.response_timeout_ms)
+                          : ceil<microseconds>(timing.frame_time(longest_request) + timing.character_time()) +
+                                kSlaveResponseAllowance;
+  timeouts.read_retry_delay = std::max(timeouts.byte, ceil<microseconds>(timing.frame_gap()));
+  timeouts.write_retry_delay = timeouts.read_retry_delay;
+  return timeouts;
+}
@@ -0,0 +1,122 @@
+#include "clock.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <thread>
+
+namespace {
+
+class SteadyClock : public Clock {
+ public:
+  time_point now() const override { return std::chrono::steady_clock::now(); }
+  void sleep_for(duration d) override { std::this_thread::sleep_for(d); }
+
+  bool sleep_unless(duration d, const std::atomic<bool>& stop) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return !woken_.wait_for(lock, d, [&stop] { return stop.load(); });
+  }
+
+  void wake() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    woken_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable woken_;
+};
+
+}  // namespace
+
+Clock& Clock::steady() {
+  static SteadyClock clock;
+  return clock;
+}
+
+VirtualClock::VirtualClock(time_point start) : now_(start) {}
+
+Clock::time_point VirtualClock::now() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return now_;
+}
+
+void VirtualClock::sleep_for(duration d) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (d <= duration::zero()) {
+    return;
+  }
+
+  const time_point deadline = now_ + d;
+  if (auto_advance_) {
+    now_ = deadline;
+    changed_.notify_all();
+    return;
+  }
+
+  auto slot = deadlines_.insert(deadline);
+  changed_.notify_all();
+  changed_.wait(lock, [this, deadline] { return now_ >= deadline; });
+  deadlines_.erase(slot);
+}
+
+bool VirtualClock::sleep_unless(duration d, const std::atomic<bool>& stop) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (stop) {
+    return false;
+  }
+  if (d <= duration::zero()) {
+    return true;
+  }
+
+  const time_point deadline = now_ + d;
+  if (auto_advance_) {
+    now_ = deadline;
+    changed_.notify_all();
+    return true;
+  }
+
+  auto slot = deadlines_.insert(deadline);
+  changed_.notify_all();
+  changed_.wait(lock, [this, deadline, &stop] { return now_ >= deadline || stop; });
+  deadlines_.erase(slot);
+  return now_ >= deadline;
+}
+
+void VirtualClock::wake() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  changed_.notify_all();
+}
+
+void VirtualClock::set_auto_advance(bool enabled) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto_advance_ = enabled;
+}
+
+void VirtualClock::advance(duration d) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (d > duration::zero()) {
+    now_ += d;
+  }
+  changed_.notify_all();
+}
+
+bool VirtualClock::advance_to_next(std::size_t sleepers, std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  sleepers = std::max<std::size_t>(sleepers, 1);
+  if (!changed_.wait_for(lock, timeout, [this, sleepers] { return sleepers_locked() >= sleepers; })) {
+    return false;
+  }
+  now_ = *deadlines_.upper_bound(now_);
+  changed_.notify_all();
+  return true;
+}
+
+std::size_t VirtualClock::sleepers() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sleepers_locked();
+}
+
+std::size_t VirtualClock::sleepers_locked() const {
+  // Woken threads keep their deadline until they get the lock back
+  return static_cast<std::size_t>(std::distance(deadlines_.upper_bound(now_), deadlines_.end()));
+}
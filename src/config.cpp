@@ -1,8 +1,27 @@
 #include "config.hpp"
 
+#include "bus_timing.hpp"
+#include "device_profile.hpp"
+#include "logger/logger.hpp"
+#include "point_table.hpp"
+#include "point_templates.hpp"
+
+#include <algorithm>
+#include <array>
 #include <fstream>
+#include <map>
+#include <sstream>
 #include <stdexcept>
 
+namespace {
+
+// Sanity limits for the logging section
+constexpr int kMaxLogQueueSize = 1 << 20;
+constexpr int kMaxLogFileSizeMb = 4096;
+constexpr int kMaxLogFiles = 100;
+
+}  // namespace
+
 ModbusConfig ModbusConfig::from_json(const nlohmann::json& j) {
   ModbusConfig config;
   config.port = j.value("port", "/dev/ttyUSB0");
@@ -13,8 +32,13 @@ ModbusConfig ModbusConfig::from_json(const nlohmann::json& j) {
 
   config.data_bits = j.value("data_bits", 8);
   config.stop_bits = j.value("stop_bits", 1);
-  config.response_timeout_ms = j.value("response_timeout_ms", 300);
-  config.byte_timeout_ms = j.value("byte_timeout_ms", 100);
+  config.transport = j.value("transport", "libmodbus");
+  config.timing = j.value("timing", "auto");
+
+  // Automatic timing derives whatever is not overridden here
+  const bool fixed = config.timing == "fixed";
+  config.response_timeout_ms = j.value("response_timeout_ms", fixed ? 300 : 0);
+  config.byte_timeout_ms = j.value("byte_timeout_ms", fixed ? 100 : 0);
   config.max_retries = j.value("max_retries", 3);
 
   return config;
@@ -70,6 +94,17 @@ Relay Relay::from_json(const nlohmann::json& j) {
   return relay;
 }
 
+BroadcastGroup BroadcastGroup::from_json(const nlohmann::json& j) {
+  BroadcastGroup group;
+  group.name = j.at("name").get<std::string>();
+  group.address = j.at("address").get<int>();
+  group.count = j.value("count", 1);
+  group.mqtt_command_topic = j.value("mqtt_command_topic", "modbus/group/" + group.name + "/set");
+  group.verify = j.value("verify", true);
+
+  return group;
+}
+
 PollingConfig PollingConfig::from_json(const nlohmann::json& j) {
   PollingConfig config;
   config.poll_interval_ms = j.value("poll_interval_ms", 400);
@@ -80,6 +115,40 @@ PollingConfig PollingConfig::from_json(const nlohmann::json& j) {
   return config;
 }
 
+MetricsConfig MetricsConfig::from_json(const nlohmann::json& j) {
+  MetricsConfig config;
+  config.enabled = j.value("enabled", false);
+  config.bind_address = j.value("bind_address", "127.0.0.1");
+  config.port = j.value("port", 9105);
+
+  return config;
+}
+
+LogFileConfig LogFileConfig::from_json(const nlohmann::json& j) {
+  LogFileConfig config;
+  config.path = j.value("path", "");
+  config.max_size_mb = j.value("max_size_mb", 10);
+  config.max_files = j.value("max_files", 5);
+  config.compress = j.value("compress", true);
+  config.preallocate = j.value("preallocate", true);
+
+  return config;
+}
+
+LoggingConfig LoggingConfig::from_json(const nlohmann::json& j) {
+  LoggingConfig config;
+  config.async = j.value("async", true);
+  config.queue_size = j.value("queue_size", 4096);
+  config.overflow_policy = j.value("overflow_policy", "drop");
+  config.format = j.value("format", "text");
+  config.file = LogFileConfig::from_json(j.value("file", nlohmann::json::object()));
+  config.level = j.value("level", "info");
+  config.control_topic = j.value("control_topic", "modbus/poller/log");
+  config.override_timeout_sec = j.value("override_timeout_sec", 0);
+
+  return config;
+}
+
 Config::Config(const std::string& filename) {
   load(filename);
 }
@@ -93,20 +162,169 @@ void Config::load(const std::string& filename) {
   nlohmann::json j;
   file >> j;
 
-  modbus_ = ModbusConfig::from_json(j.at("modbus"));
-  mqtt_ = MqttConfig::from_json(j.at("mqtt"));
-  polling_ = PollingConfig::from_json(j.at("polling"));
+  std::vector<ConfigDiagnostic> diagnostics;
 
-  for (const auto& item : j.at("digital_inputs")) {
-    inputs_.push_back(DigitalInput::from_json(item));
+  // Parse errors are collected per section and point so one pass reports all of them
+  auto section = [&](const char* key, bool required, auto parse) {
+    const std::string path = std::string("/") + key;
+    if (required && !j.contains(key)) {
+      diagnostics.push_back({ConfigDiagnostic::Severity::ERROR, path, "missing section"});
+      return;
+    }
+    try {
+      parse(j.value(key, nlohmann::json::object()));
+    } catch (const nlohmann::json::exception& e) {
+      diagnostics.push_back({ConfigDiagnostic::Severity::ERROR, path, e.what()});
+    }
+  };
+
+  section("modbus", true, [this](const nlohmann::json& s) { modbus_ = ModbusConfig::from_json(s); });
+  section("mqtt", true, [this](const nlohmann::json& s) { mqtt_ = MqttConfig::from_json(s); });
+  section("polling", true, [this](const nlohmann::json& s) { polling_ = PollingConfig::from_json(s); });
+  section("metrics", false, [this](const nlohmann::json& s) { metrics_ = MetricsConfig::from_json(s); });
+  section("logging", false, [this](const nlohmann::json& s) { logging_ = LoggingConfig::from_json(s); });
+  section("reload", false, [this](const nlohmann::json& s) { reload_ = ReloadConfig::from_json(s); });
+
+  // Device profiles first: modules assign them to their slaves
+  DeviceCatalog catalog;
+  catalog.load(j, diagnostics);
+  device_profiles_ = j.value("device_profiles", nlohmann::json::object());
+
+  // Single points, ranges and template modules, flattened
+  ExpandedPoints points = expand_points(j, diagnostics);
+  inputs_ = std::move(points.inputs);
+  relays_ = std::move(points.relays);
+  for (const auto& assignment : points.profiles) {
+    catalog.assign(assignment.slave_id, assignment.profile, assignment.path, diagnostics);
+  }
+
+  // Groups select relays by coil range, so they come after the points
+  const nlohmann::json groups = j.value("broadcast_groups", nlohmann::json::array());
+  if (!groups.is_array()) {
+    diagnostics.push_back({ConfigDiagnostic::Severity::ERROR, "/broadcast_groups", "must be an array"});
+  } else {
+    for (std::size_t i = 0; i < groups.size(); i++) {
+      try {
+        broadcast_groups_.push_back(BroadcastGroup::from_json(groups[i]));
+      } catch (const nlohmann::json::exception& e) {
+        diagnostics.push_back(
+            {ConfigDiagnostic::Severity::ERROR, "/broadcast_groups/" + std::to_string(i), e.what()});
+      }
+    }
   }
 
-  for (const auto& item : j.at("relays")) {
-    relays_.push_back(Relay::from_json(item));
+  // Point paths are only meaningful when every point parsed
+  if (diagnostics.empty()) {
+    diagnostics_ = std::move(diagnostics);
+    validate(points.sources, catalog);
+  } else {
+    throw ConfigError(std::move(diagnostics));
   }
 }
 
-void Config::save(const std::string& filename) const {
+void Config::validate(const PointSources& sources, const DeviceCatalog& catalog) {
+  auto error = [this](const std::string& path, const std::string& message) {
+    diagnostics_.push_back({ConfigDiagnostic::Severity::ERROR, path, message});
+  };
+
+  if (modbus_.baudrate <= 0) {
+    error("/modbus/baudrate", "must be positive");
+  }
+  if (modbus_.parity != 'N' && modbus_.parity != 'E' && modbus_.parity != 'O') {
+    error("/modbus/parity", "must be N, E or O");
+  }
+  if (modbus_.data_bits < 5 || modbus_.data_bits > 8) {
+    error("/modbus/data_bits", "must be 5-8");
+  }
+  if (modbus_.stop_bits < 1 || modbus_.stop_bits > 2) {
+    error("/modbus/stop_bits", "must be 1 or 2");
+  }
+  if (modbus_.transport != "libmodbus" && modbus_.transport != "native") {
+    error("/modbus/transport", "must be libmodbus or native");
+  }
+  if (modbus_.timing != "auto" && modbus_.timing != "fixed") {
+    error("/modbus/timing", "must be auto or fixed");
+  }
+  // 0 means derived in automatic timing
+  const int min_timeout = modbus_.timing == "fixed" ? 1 : 0;
+  if (modbus_.response_timeout_ms < min_timeout) {
+    error("/modbus/response_timeout_ms", min_timeout > 0 ? "must be positive" : "must not be negative");
+  }
+  if (modbus_.byte_timeout_ms < min_timeout) {
+    error("/modbus/byte_timeout_ms", min_timeout > 0 ? "must be positive" : "must not be negative");
+  }
+  if (modbus_.max_retries < 0) {
+    error("/modbus/max_retries", "must not be negative");
+  }
+
+  if (mqtt_.qos < 0 || mqtt_.qos > 2) {
+    error("/mqtt/qos", "must be 0, 1 or 2");
+  }
+
+  if (polling_.poll_interval_ms <= 0) {
+    error("/polling/poll_interval_ms", "must be positive");
+  }
+  if (polling_.max_commands_per_cycle <= 0) {
+    error("/polling/max_commands_per_cycle", "must be positive");
+  }
+  if (polling_.watchdog_timeout_sec <= 0) {
+    error("/polling/watchdog_timeout_sec", "must be positive");
+  }
+
+  LogLevel level;
+  if (!Logger::parse_level(logging_.level, level)) {
+    error("/logging/level", "unknown level '" + logging_.level + "'");
+  }
+  if (logging_.format != "text" && logging_.format != "json") {
+    error("/logging/format", "must be \"text\" or \"json\"");
+  }
+  if (logging_.overflow_policy != "drop" && logging_.overflow_policy != "block") {
+    error("/logging/overflow_policy", "must be \"drop\" or \"block\"");
+  }
+  // The queue is allocated up front, rounded up to a power of two
+  if (logging_.queue_size < 1 || logging_.queue_size > kMaxLogQueueSize) {
+    error("/logging/queue_size", "must be 1-" + std::to_string(kMaxLogQueueSize));
+  }
+  if (logging_.file.max_size_mb < 1 || logging_.file.max_size_mb > kMaxLogFileSizeMb) {
+    error("/logging/file/max_size_mb", "must be 1-" + std::to_string(kMaxLogFileSizeMb));
+  }
+  if (logging_.file.max_files < 0 || logging_.file.max_files > kMaxLogFiles) {
+    error("/logging/file/max_files", "must be 0-" + std::to_string(kMaxLogFiles));
+  }
+  if (logging_.override_timeout_sec < 0) {
+    error("/logging/override_timeout_sec", "must not be negative");
+  }
+
+  points_ = std::make_shared<const PointTable>(
+      compile_points(inputs_, relays_, diagnostics_, sources, catalog, broadcast_groups_));
+
+  const bool has_errors = std::any_of(diagnostics_.begin(), diagnostics_.end(), [](const ConfigDiagnostic& d) {
+    return d.severity == ConfigDiagnostic::Severity::ERROR;
+  });
+  if (has_errors) {
+    throw ConfigError(diagnostics_);
+  }
+
+  // The reads alone must fit in the interval, or every cycle overruns
+  const CycleBudget budget = plan_cycle(*points_, polling_, BusTiming(modbus_));
+  if (!budget.feasible()) {
+    std::ostringstream message;
+    message << "one poll cycle needs about "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(budget.poll_time).count() << "ms on the bus ("
+            << budget.read_requests << " requests at " << modbus_.baudrate << " baud), more than the interval";
+    diagnostics_.push_back({ConfigDiagnostic::Severity::WARNING, "/polling/poll_interval_ms", message.str()});
+  }
+}
+
+ReloadConfig ReloadConfig::from_json(const nlohmann::json& j) {
+  ReloadConfig config;
+  config.watch_file = j.value("watch_file", false);
+  config.watch_interval_ms = j.value("watch_interval_ms", 1000);
+
+  return config;
+}
+
+nlohmann::json Config::to_json() const {
   nlohmann::json j;
 
   // Modbus config
@@ -115,6 +333,8 @@ void Config::save(const std::string& filename) const {
                  {"parity", std::string(1, modbus_.parity)},
                  {"data_bits", modbus_.data_bits},
                  {"stop_bits", modbus_.stop_bits},
+                 {"transport", modbus_.transport},
+                 {"timing", modbus_.timing},
                  {"response_timeout_ms", modbus_.response_timeout_ms},
                  {"byte_timeout_ms", modbus_.byte_timeout_ms},
                  {"max_retries", modbus_.max_retries}};
@@ -135,6 +355,38 @@ void Config::save(const std::string& filename) const {
                   {"max_commands_per_cycle", polling_.max_commands_per_cycle},
                   {"watchdog_timeout_sec", polling_.watchdog_timeout_sec}};
 
+  // Metrics endpoint
+  j["metrics"] = {{"enabled", metrics_.enabled}, {"bind_address", metrics_.bind_address}, {"port", metrics_.port}};
+
+  // Logging
+  j["logging"] = {{"async", logging_.async},
+                  {"queue_size", logging_.queue_size},
+                  {"overflow_policy", logging_.overflow_policy},
+                  {"format", logging_.format},
+                  {"file",
+                   {{"path", logging_.file.path},
+                    {"max_size_mb", logging_.file.max_size_mb},
+                    {"max_files", logging_.file.max_files},
+                    {"compress", logging_.file.compress},
+                    {"preallocate", logging_.file.preallocate}}},
+                  {"level", logging_.level},
+                  {"control_topic", logging_.control_topic},
+                  {"override_timeout_sec", logging_.override_timeout_sec}};
+
+  // Configuration reload
+  j["reload"] = {{"watch_file", reload_.watch_file}, {"watch_interval_ms", reload_.watch_interval_ms}};
+
+  // Device profiles; slave assignments as resolved, including those made by modules
+  j["device_profiles"] = device_profiles_;
+  j["slaves"] = nlohmann::json::array();
+  if (points_) {
+    for (const auto& [slave_id, profile] : points_->profiles) {
+      if (profile.name != DeviceCatalog::kGenericProfile) {
+        j["slaves"].push_back({{"slave_id", slave_id}, {"profile", profile.name}});
+      }
+    }
+  }
+
   // Digital inputs
   j["digital_inputs"] = nlohmann::json::array();
   for (const auto& input : inputs_) {
@@ -154,6 +406,122 @@ void Config::save(const std::string& filename) const {
                            {"mqtt_state_topic", relay.mqtt_state_topic}});
   }
 
+  // Broadcast groups
+  j["broadcast_groups"] = nlohmann::json::array();
+  for (const auto& group : broadcast_groups_) {
+    j["broadcast_groups"].push_back({{"name", group.name},
+                                     {"address", group.address},
+                                     {"count", group.count},
+                                     {"mqtt_command_topic", group.mqtt_command_topic},
+                                     {"verify", group.verify}});
+  }
+
+  return j;
+}
+
+void Config::save(const std::string& filename) const {
   std::ofstream file(filename);
-  file << j.dump(DEFAULT_INDENT);
+  file << to_json().dump(DEFAULT_INDENT);
+}
+
+std::string ConfigDiagnostic::to_string() const {
+  return std::string(severity == Severity::ERROR ? "error" : "warning") + ": " + path + ": " + message;
+}
+
+namespace {
+
+std::string describe(const std::vector<ConfigDiagnostic>& diagnostics) {
+  std::string text = "Invalid configuration:";
+  for (const auto& diagnostic : diagnostics) {
+    if (diagnostic.severity == ConfigDiagnostic::Severity::ERROR) {
+      text += "\n  " + diagnostic.path + ": " + diagnostic.message;
+    }
+  }
+  return text;
+}
+
+}  // namespace
+
+ConfigError::ConfigError(std::vector<ConfigDiagnostic> diagnostics)
+    : std::runtime_error(describe(diagnostics)), diagnostics_(std::move(diagnostics)) {}
+
+namespace {
+
+// Compares two point lists by name; returns {added, removed, changed}
+std::array<int, 3> diff_points(const nlohmann::json& before, const nlohmann::json& after) {
+  std::map<std::string, const nlohmann::json*> old_points;
+  for (const auto& point : before) {
+    old_points.emplace(point.at("name").get<std::string>(), &point);
+  }
+
+  std::array<int, 3> counts = {0, 0, 0};
+  for (const auto& point : after) {
+    auto it = old_points.find(point.at("name").get<std::string>());
+    if (it == old_points.end()) {
+      counts[0]++;
+      continue;
+    }
+    if (*it->second != point) {
+      counts[2]++;
+    }
+    old_points.erase(it);
+  }
+  counts[1] = static_cast<int>(old_points.size());
+
+  return counts;
+}
+
+}  // namespace
+
+ConfigDiff diff_config(const Config& before, const Config& after) {
+  const nlohmann::json a = before.to_json();
+  const nlohmann::json b = after.to_json();
+
+  ConfigDiff diff;
+  diff.modbus = (a["modbus"] != b["modbus"]);
+  diff.mqtt = (a["mqtt"] != b["mqtt"]);
+  diff.polling = (a["polling"] != b["polling"]);
+  diff.metrics = (a["metrics"] != b["metrics"]);
+  diff.logging = (a["logging"] != b["logging"]);
+  diff.reload = (a["reload"] != b["reload"]);
+  diff.devices = (a["device_profiles"] != b["device_profiles"] || a["slaves"] != b["slaves"]);
+  diff.groups = (a["broadcast_groups"] != b["broadcast_groups"]);
+
+  const auto inputs = diff_points(a["digital_inputs"], b["digital_inputs"]);
+  diff.inputs_added = inputs[0];
+  diff.inputs_removed = inputs[1];
+  diff.inputs_changed = inputs[2];
+
+  const auto relays = diff_points(a["relays"], b["relays"]);
+  diff.relays_added = relays[0];
+  diff.relays_removed = relays[1];
+  diff.relays_changed = relays[2];
+
+  return diff;
+}
+
+bool ConfigDiff::points_changed() const {
+  return inputs_added + inputs_removed + inputs_changed + relays_added + relays_removed + relays_changed > 0;
+}
+
+bool ConfigDiff::empty() const {
+  return !modbus && !mqtt && !polling && !metrics && !logging && !reload && !devices && !groups &&
+         !points_changed();
+}
+
+std::string ConfigDiff::summary() const {
+  std::ostringstream oss;
+  oss << "inputs +" << inputs_added << "/-" << inputs_removed << "/~" << inputs_changed << ", relays +"
+      << relays_added << "/-" << relays_removed << "/~" << relays_changed;
+
+  for (const auto& [changed, name] : {std::make_pair(modbus, "modbus"), std::make_pair(mqtt, "mqtt"),
+                                      std::make_pair(polling, "polling"), std::make_pair(metrics, "metrics"),
+                                      std::make_pair(logging, "logging"), std::make_pair(reload, "reload"),
+                                      std::make_pair(devices, "devices"), std::make_pair(groups, "groups")}) {
+    if (changed) {
+      oss << ", " << name << " changed";
+    }
+  }
+
+  return oss.str();
 }
\ No newline at end of file
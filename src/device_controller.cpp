@@ -1,44 +1,266 @@
 #include "device_controller.hpp"
 
+#include <algorithm>
 #include <array>
+#include <csignal>
 #include <iostream>
 #include <thread>
+#include <unordered_map>
 
-DeviceController::DeviceController(const std::vector<DigitalInput>& inputs, const std::vector<Relay>& relays,
-                                   const PollingConfig& polling_config, IModbusManager& modbus, IMqttManager& mqtt)
-    : polling_config_(polling_config),
+DeviceController::DeviceController(std::shared_ptr<const PointTable> points, const PollingConfig& polling_config,
+                                   IModbusManager& modbus, IMqttManager& mqtt, Clock& clock)
+    : points_(std::move(points)),
+      polling_config_(polling_config),
+      watchdog_timeout_sec_(polling_config.watchdog_timeout_sec),
       modbus_(modbus),
       mqtt_(mqtt),
-      last_loop_time_(std::chrono::steady_clock::now()),
-      last_stats_time_(std::chrono::steady_clock::now()),
+      clock_(clock),
+      last_loop_time_(clock.now()),
+      watchdog_stop_(false),
+      last_stats_time_(clock.now()),
+      read_to_publish_latency_(add_latency_channel("read_to_publish", "gateway_stage_latency_seconds",
+                                                   "Latency of control path stages", {{"stage", "read_to_publish"}})),
+      command_to_write_latency_(add_latency_channel("command_to_write", "gateway_stage_latency_seconds",
+                                                    "Latency of control path stages", {{"stage", "command_to_write"}})),
+      cycle_latency_(add_latency_channel("cycle", "gateway_cycle_seconds", "Poll cycle duration", {})),
+      command_queue_registration_(MetricsRegistry::instance().add_gauge(
+          "gateway_command_queue_depth", "Relay commands waiting for the bus", {}, command_queue_depth_)),
+      startup_sync_registration_(MetricsRegistry::instance().add_gauge(
+          "gateway_startup_sync_seconds", "Time from process start until the full state was published", {},
+          startup_sync_seconds_)),
+      bus_window_start_(clock.now()),
+      stats_service_(modbus, mqtt),
       logger_("DeviceController") {
+  auto& registry = MetricsRegistry::instance();
+  bus_registrations_.push_back(registry.add_gauge("gateway_bus_utilization",
+                                                  "Share of wall time spent in Modbus transactions", {},
+                                                  bus_utilization_));
+  bus_registrations_.push_back(registry.add_gauge("gateway_bus_expected_utilization",
+                                                  "Share of the poll interval the input reads need by the bus model",
+                                                  {}, bus_expected_utilization_));
+  bus_registrations_.push_back(registry.add_gauge("gateway_bus_expected_cycle_seconds",
+                                                  "Bus time of one poll cycle by the bus model", {},
+                                                  bus_expected_cycle_seconds_));
+  build_points();
+}
+
+DeviceController::DeviceController(const std::vector<DigitalInput>& inputs, const std::vector<Relay>& relays,
+                                   const PollingConfig& polling_config, IModbusManager& modbus, IMqttManager& mqtt,
+                                   Clock& clock)
+    : DeviceController(std::make_shared<const PointTable>(compile_points(inputs, relays)), polling_config, modbus,
+                       mqtt, clock) {}
+
+DeviceController::~DeviceController() {
+  stop_watchdog();
+}
+
+void DeviceController::build_points() {
+  slave_inputs_.clear();
+  relay_states_.clear();
+
+  std::size_t largest_read = 0;
+  slave_inputs_.reserve(points_->slaves.size());
+  for (const auto& slave : points_->slaves) {
+    slave_inputs_.emplace_back(slave, slave_latency(slave.slave_id), clock_.now());
+    largest_read = std::max(largest_read, std::min(slave.read_bits, slave.bit_count));
+  }
+  read_buffer_.assign(largest_read, 0);
+
+  relay_states_.reserve(points_->relays.size());
+  for (const auto& relay : points_->relays) {
+    relay_states_.emplace_back(&relay, slave_latency(relay.slave_id));
+  }
+}
+
+namespace {
+
+// Addresses and topics of a slave's inputs; equal layouts publish the same messages
+std::vector<std::pair<std::size_t, std::string>> slave_layout(const PointTable& points,
+                                                              const PointTable::Slave& slave) {
+  std::vector<std::pair<std::size_t, std::string>> layout;
+  for (std::size_t bit = 0; bit < slave.bit_inputs.size(); bit++) {
+    for (std::size_t index : slave.bit_inputs[bit]) {
+      layout.emplace_back(bit, points.inputs[index].mqtt_topic);
+    }
+  }
+  return layout;
+}
+
+std::unordered_map<std::string, std::size_t> relays_by_name(const PointTable& points) {
+  std::unordered_map<std::string, std::size_t> index;
+  for (std::size_t i = 0; i < points.relays.size(); i++) {
+    index.emplace(points.relays[i].name, i);
+  }
+  return index;
+}
+
+}  // namespace
+
+void DeviceController::reload(std::shared_ptr<const PointTable> points, const PollingConfig& polling_config) {
+  // Keep what the previous plan knew about points that are still there;
+  // the old table stays alive until the end so its plans can be compared
+  const std::shared_ptr<const PointTable> old_points = points_;
+  std::vector<SlaveInputs> old_slaves = std::move(slave_inputs_);
+  std::vector<RelayState> old_relays = std::move(relay_states_);
+
+  polling_config_ = polling_config;
+  watchdog_timeout_sec_ = polling_config.watchdog_timeout_sec;
+
+  const auto new_relays = relays_by_name(*points);
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    points_ = std::move(points);
+
+    // Queued commands refer to relays of the old table
+    std::vector<RelayCommand> queue;
+    for (const auto& cmd : relay_command_queue_) {
+      if (cmd.group) {
+        const std::string& name = old_points->groups[cmd.relay].name;
+        auto it = std::find_if(points_->groups.begin(), points_->groups.end(),
+                               [&name](const PointTable::Group& group) { return group.name == name; });
+        if (it != points_->groups.end()) {
+          queue.push_back({static_cast<std::size_t>(it - points_->groups.begin()), cmd.desired_state, cmd.enqueued,
+                           true});
+        }
+        continue;
+      }
+      auto it = new_relays.find(old_points->relays[cmd.relay].name);
+      if (it != new_relays.end()) {
+        queue.push_back({it->second, cmd.desired_state, cmd.enqueued});
+      }
+    }
+    relay_command_queue_.swap(queue);
+    command_queue_depth_.set(static_cast<double>(relay_command_queue_.size()));
+  }
+
+  build_points();
+
+  std::map<int, SlaveInputs*> old_by_id;
+  for (auto& slave : old_slaves) {
+    old_by_id.emplace(slave.plan->slave_id, &slave);
+  }
+
+  std::size_t carried_slaves = 0;
+  for (auto& slave : slave_inputs_) {
+    auto it = old_by_id.find(slave.plan->slave_id);
+    // The carried image must also cover the same bits, or change detection reads past the plan
+    if (it != old_by_id.end() && it->second->plan->bit_count == slave.plan->bit_count &&
+        it->second->plan->read_bits == slave.plan->read_bits &&
+        slave_layout(*old_points, *it->second->plan) == slave_layout(*points_, *slave.plan)) {
+      slave.previous.swap(it->second->previous);
+      slave.last_refresh = it->second->last_refresh;
+      carried_slaves++;
+    } else {
+      // New or changed layout: publish the full state on the next poll
+      slave.last_refresh = std::chrono::steady_clock::time_point{};
+    }
+  }
+
+  const auto old_relay_index = relays_by_name(*old_points);
+  for (auto& state : relay_states_) {
+    auto it = old_relay_index.find(state.relay->name);
+    if (it == old_relay_index.end()) {
+      continue;
+    }
+    const RelayState& old = old_relays[it->second];
+    if (old.relay->slave_id == state.relay->slave_id && old.relay->address == state.relay->address) {
+      state.current_state = old.current_state;
+    }
+  }
 
-  // Initialize input states
-  for (const auto& input : inputs) {
-    input_states_.emplace_back(&input);
+  LOG_INFO(logger_) << "Reloaded " << points_->inputs.size() << " inputs on " << slave_inputs_.size() << " slaves ("
+                    << carried_slaves << " unchanged), " << points_->relays.size() << " relays";
+}
+
+std::vector<std::string> DeviceController::command_topics() const {
+  std::vector<std::string> topics;
+  topics.reserve(points_->command_routes.size() + points_->group_routes.size());
+  for (const auto& route : points_->command_routes) {
+    topics.push_back(route.first);
   }
+  for (const auto& route : points_->group_routes) {
+    topics.push_back(route.first);
+  }
+  std::sort(topics.begin(), topics.end());
+  return topics;
+}
+
+bool DeviceController::synchronize(std::chrono::steady_clock::time_point started) {
+  const auto sync_start = clock_.now();
+
+  std::vector<MqttMessage> messages;
+  messages.reserve(points_->inputs.size() + points_->relays.size());
+
+  std::size_t slaves_read = 0;
+  for (auto& slave : slave_inputs_) {
+    if (!read_slave_inputs(slave)) {
+      // The first poll that reads it publishes it in full
+      slave.last_refresh = std::chrono::steady_clock::time_point{};
+      continue;
+    }
 
-  // Initialize relay states
-  for (const auto& relay : relays) {
-    relay_states_.emplace(relay.name, RelayState(&relay));
+    for (std::size_t bit = 0; bit < slave.plan->bit_inputs.size(); bit++) {
+      const char* payload = slave.current.test(bit) ? "ON" : "OFF";
+      for (std::size_t index : slave.plan->bit_inputs[bit]) {
+        messages.push_back({points_->inputs[index].mqtt_topic, payload});
+      }
+    }
+    slave.previous.swap(slave.current);
+    slave.last_refresh = sync_start;
+    slaves_read++;
   }
+
+  std::size_t relays_readable = 0;
+  const std::size_t relays_read = read_relay_states(messages, relays_readable);
+  const std::size_t published = mqtt_.publish_batch(messages);
+
+  const auto done = clock_.now();
+  startup_sync_seconds_.set(std::chrono::duration<double>(done - started).count());
+
+  LOG_INFO(logger_) << "Startup sync: " << slaves_read << "/" << slave_inputs_.size() << " slaves, " << relays_read
+                    << "/" << relays_readable << " relays read, " << published << "/" << messages.size()
+                    << " states published in "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(done - sync_start).count() << "ms";
+  LOG_INFO(logger_) << "Full state ready "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(done - started).count()
+                    << "ms after start" << (mqtt_.is_connected() ? "" : ", queued until the broker connects");
+
+  return slaves_read == slave_inputs_.size() && relays_read == relays_readable &&
+         published == messages.size();
 }
 
 void DeviceController::poll_inputs() {
-  std::map<int, std::vector<InputState*>> inputs_by_slave;
-  group_inputs_by_slave(inputs_by_slave);
-
-  std::array<uint8_t, 8> input_bits;
-
-  for (auto& [slave_id, slave_inputs] : inputs_by_slave) {
-    // Read 8 inputs at once from this slave
-    if (modbus_.read_discrete_inputs(slave_id, 0, input_bits)) {
-      for (auto* state : slave_inputs) {
-        bool current_state = input_bits[state->input->address];
-        publish_input_state(*state, current_state);
-        state->last_state = current_state;
+  const auto now = clock_.now();
+
+  for (auto& slave : slave_inputs_) {
+    if (!read_slave_inputs(slave)) {
+      continue;
+    }
+    const auto sampled = clock_.now();
+
+    const bool refresh =
+        std::chrono::duration_cast<std::chrono::seconds>(now - slave.last_refresh).count() >=
+        polling_config_.refresh_interval_sec;
+
+    if (refresh) {
+      // Periodic refresh republishes every input of the slave
+      for (std::size_t bit = 0; bit < slave.plan->bit_inputs.size(); bit++) {
+        const bool current_state = slave.current.test(bit);
+        const bool changed = current_state != slave.previous.test(bit);
+        for (std::size_t index : slave.plan->bit_inputs[bit]) {
+          publish_input_state(points_->inputs[index], current_state, changed, sampled);
+        }
       }
+      slave.last_refresh = now;
+    } else if (!slave.current.equals(slave.previous)) {
+      slave.current.for_each_change(slave.previous, [this, &slave, sampled](std::size_t bit, bool current_state) {
+        for (std::size_t index : slave.plan->bit_inputs[bit]) {
+          publish_input_state(points_->inputs[index], current_state, true, sampled);
+        }
+      });
     }
+
+    slave.previous.swap(slave.current);
   }
 }
 
@@ -52,59 +274,74 @@ void DeviceController::process_relay_commands() {
         std::min(relay_command_queue_.size(), static_cast<size_t>(polling_config_.max_commands_per_cycle));
     std::move(relay_command_queue_.begin(), relay_command_queue_.begin() + count, std::back_inserter(commands));
     relay_command_queue_.erase(relay_command_queue_.begin(), relay_command_queue_.begin() + count);
+    command_queue_depth_.set(static_cast<double>(relay_command_queue_.size()));
 
     if (!relay_command_queue_.empty()) {
-      logger_.warning() << commands.size() << " commands in queue, limiting to "
-                        << polling_config_.max_commands_per_cycle << "/cycle";
+      LOG_WARNING(logger_) << commands.size() << " commands in queue, limiting to "
+                           << polling_config_.max_commands_per_cycle << "/cycle";
     }
   }
 
   for (const auto& cmd : commands) {
-    auto it = relay_states_.find(cmd.relay_name);
-    if (it != relay_states_.end()) {
-      RelayState& state = it->second;
+    if (cmd.group) {
+      execute_group(cmd);
+      continue;
+    }
+    RelayState& state = relay_states_[cmd.relay];
 
-      if (modbus_.write_coil(state.relay->slave_id, state.relay->address, cmd.desired_state)) {
+    const auto write_start = clock_.now();
+    const bool written = modbus_.write_coil(state.relay->slave_id, state.relay->address, cmd.desired_state);
+    const auto write_end = clock_.now();
+    state.modbus_latency->record(write_end - write_start);
+    bus_busy_ += write_end - write_start;
 
-        state.current_state = cmd.desired_state;
-        publish_relay_state(state);
+    if (written) {
+      command_to_write_latency_.histogram.record(write_end - cmd.enqueued);
 
-        logger_.debug() << "RELAY: " << state.relay->name << " @ slave " << state.relay->slave_id << " addr "
-                        << state.relay->address << " = " << (cmd.desired_state ? "ON" : "OFF");
-      } else {
-        logger_.error() << "Failed to set relay " << cmd.relay_name;
-      }
+      state.current_state = cmd.desired_state;
+      publish_relay_state(state);
+
+      LOG_DEBUG(logger_) << "RELAY: " << state.relay->name << " @ slave " << state.relay->slave_id << " addr "
+                         << state.relay->address << " = " << (cmd.desired_state ? "ON" : "OFF");
+    } else {
+      LOG_ERROR(logger_) << "Failed to set relay " << state.relay->name;
     }
   }
 }
 
-// TODO: Improve topic matching (e.g., use a map)
 void DeviceController::handle_mqtt_command(const std::string& topic, const std::string& payload) {
-  // Parse relay command: "modbus/relay/{name}/set"
-  const std::string prefix = "modbus/relay/";
-  const std::string suffix = "/set";
+  bool state = (payload == "ON" || payload == "1" || payload == "true");
+  std::shared_ptr<const PointTable> points;  // keeps the relay name valid across a concurrent reload
+  std::size_t index;
+  bool group = false;
 
-  if (topic.find(prefix) == 0 && topic.find(suffix) != std::string::npos) {
-    size_t start = prefix.length();
-    size_t end = topic.find(suffix);
-    std::string relay_name = topic.substr(start, end - start);
-
-    bool state = (payload == "ON" || payload == "1" || payload == "true");
-
-    {
-      std::lock_guard<std::mutex> lock(queue_mutex_);
-      relay_command_queue_.push_back({relay_name, state});
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    // Routes cover "modbus/relay/{name}/set" and each relay's configured command topic
+    auto route = points_->command_routes.find(topic);
+    if (route != points_->command_routes.end()) {
+      index = route->second;
+    } else {
+      auto group_route = points_->group_routes.find(topic);
+      if (group_route == points_->group_routes.end()) {
+        return;
+      }
+      index = group_route->second;
+      group = true;
     }
-
-    logger_.debug() << "MQTT CMD: " << relay_name << " = " << payload;
+    points = points_;
+    relay_command_queue_.push_back({index, state, clock_.now(), group});
   }
+
+  LOG_DEBUG(logger_) << "MQTT CMD: " << (group ? points->groups[index].name : points->relays[index].name) << " = "
+                     << payload;
 }
 
-// TODO: Move to a separate StatisticsLogger class?
 void DeviceController::print_statistics() {
-  auto now = std::chrono::steady_clock::now();
-  auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - last_stats_time_).count();
+  auto now = clock_.now();
+  stats_service_.sample(now);
 
+  auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - last_stats_time_).count();
   if (elapsed < 60) {
     return;
   }
@@ -112,73 +349,285 @@ void DeviceController::print_statistics() {
   auto modbus_stats = modbus_.get_stats();
   auto mqtt_stats = mqtt_.get_stats();
 
-  int total_reads = modbus_stats->read_success + modbus_stats->read_errors;
-  int total_writes = modbus_stats->write_success + modbus_stats->write_errors;
-  int total_mqtt = mqtt_stats->publish_success + mqtt_stats->publish_errors;
-
-  logger_.debug() << "===== STATISTICS =====";
-  logger_.debug() << "Modbus Reads: " << modbus_stats->read_success << "/" << total_reads
-                  << (total_reads > 0 ? " (" + std::to_string(100.0 * modbus_stats->read_success / total_reads) + "%)"
-                                      : "");
-  logger_.debug() << "Modbus Writes: " << modbus_stats->write_success << "/" << total_writes
-                  << (total_writes > 0
-                          ? " (" + std::to_string(100.0 * modbus_stats->write_success / total_writes) + "%)"
-                          : "");
-  logger_.debug() << "MQTT Publishes: " << mqtt_stats->publish_success << "/" << total_mqtt
-                  << (total_mqtt > 0 ? " (" + std::to_string(100.0 * mqtt_stats->publish_success / total_mqtt) + "%)"
-                                     : "");
-  logger_.debug() << "MQTT Messages Received: " << mqtt_stats->messages_received;
-
-  modbus_.reset_stats();
-  mqtt_.reset_stats();
+  LOG_DEBUG(logger_) << "===== STATISTICS =====";
+  LOG_DEBUG(logger_) << "Modbus Reads: " << modbus_stats.read_success << "/"
+                     << modbus_stats.read_success + modbus_stats.read_errors;
+  LOG_DEBUG(logger_) << "Modbus Writes: " << modbus_stats.write_success << "/"
+                     << modbus_stats.write_success + modbus_stats.write_errors;
+  LOG_DEBUG(logger_) << "MQTT Publishes: " << mqtt_stats.publish_success << "/"
+                     << mqtt_stats.publish_success + mqtt_stats.publish_errors;
+  LOG_DEBUG(logger_) << "MQTT Messages Received: " << mqtt_stats.messages_received;
+
+  nlohmann::json j;
+  for (auto span : {std::chrono::minutes(1), std::chrono::minutes(5), std::chrono::minutes(15)}) {
+    const WindowStats w = stats_service_.window(span);
+    const std::string key = std::to_string(span.count()) + "m";
+
+    LOG_DEBUG(logger_) << "Last " << key << ": reads " << w.read_rate << "/s (" << 100.0 * w.read_success_ratio
+                       << "%), writes " << w.write_rate << "/s (" << 100.0 * w.write_success_ratio << "%), publishes "
+                       << w.publish_rate << "/s (" << 100.0 * w.publish_success_ratio << "%)";
+
+    j[key] = {{"covered_sec", w.covered.count()},
+              {"read_rate", w.read_rate},
+              {"read_success_ratio", w.read_success_ratio},
+              {"write_rate", w.write_rate},
+              {"write_success_ratio", w.write_success_ratio},
+              {"publish_rate", w.publish_rate},
+              {"publish_success_ratio", w.publish_success_ratio},
+              {"receive_rate", w.receive_rate}};
+  }
+  mqtt_.publish(kRateStatsTopic, j.dump(), false);
+
+  publish_latency_statistics();
   last_stats_time_ = now;
 }
 
+void DeviceController::record_cycle_time(std::chrono::steady_clock::duration elapsed) {
+  cycle_latency_.histogram.record(elapsed);
+
+  const auto now = clock_.now();
+  const auto window = now - bus_window_start_;
+  if (window >= kBusUtilizationWindow) {
+    bus_utilization_.set(std::chrono::duration<double>(bus_busy_) / std::chrono::duration<double>(window));
+    bus_busy_ = {};
+    bus_window_start_ = now;
+  }
+}
+
+void DeviceController::set_cycle_budget(const CycleBudget& budget) {
+  bus_expected_utilization_.set(budget.utilization());
+  bus_expected_cycle_seconds_.set(std::chrono::duration<double>(budget.poll_time).count());
+}
+
+void DeviceController::publish_latency_statistics() {
+  nlohmann::json j;
+
+  for (auto& channel : latency_channels_) {
+    auto current = channel->histogram.snapshot();
+    auto interval = current.since(channel->reported);
+    channel->reported = current;
+
+    j[channel->name] = {{"count", interval.count},
+                        {"p50_us", interval.percentile(50.0)},
+                        {"p99_us", interval.percentile(99.0)},
+                        {"max_us", interval.max_us}};
+  }
+
+  mqtt_.publish(kLatencyStatsTopic, j.dump(), false);
+}
+
+void DeviceController::dump_latency_statistics() {
+  LOG_INFO(logger_) << "===== LATENCY (since start, us) =====";
+
+  for (const auto& channel : latency_channels_) {
+    auto snap = channel->histogram.snapshot();
+    LOG_INFO(logger_) << channel->name << ": count " << snap.count << " p50 " << snap.percentile(50.0) << " p99 "
+                      << snap.percentile(99.0) << " max " << snap.max_us;
+  }
+}
+
 void DeviceController::start_watchdog(std::atomic<bool>& running, std::atomic<bool>& force_exit) {
-  std::thread watchdog([this, &running, &force_exit]() {
-    logger_.info() << "Watchdog: started (alarm after " << polling_config_.watchdog_timeout_sec << "s)";
+  stop_watchdog();
+  watchdog_stop_ = false;
+
+  watchdog_ = std::thread([this, &running, &force_exit]() {
+    LOG_INFO(logger_) << "Watchdog: started (alarm after " << watchdog_timeout_sec_ << "s)";
 
     while (running && !force_exit) {
-      std::this_thread::sleep_for(std::chrono::seconds(5));
+      if (!clock_.sleep_unless(std::chrono::seconds(5), watchdog_stop_)) {
+        return;
+      }
 
-      auto now = std::chrono::steady_clock::now();
+      auto now = clock_.now();
       auto last = last_loop_time_.load();
       auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - last).count();
 
-      if (elapsed > polling_config_.watchdog_timeout_sec && running) {
-        logger_.critical() << "WATCHDOG ALARM";
-        logger_.critical() << "Main loop not responding for " << elapsed << "s!";
-        logger_.critical() << "Forcing restart...";
+      if (elapsed > watchdog_timeout_sec_ && running) {
+        LOG_CRITICAL(logger_) << "WATCHDOG ALARM";
+        LOG_CRITICAL(logger_) << "Main loop not responding for " << elapsed << "s!";
+        LOG_CRITICAL(logger_) << "Forcing restart...";
         force_exit = true;
         raise(SIGTERM);
       }
     }
   });
+}
 
-  watchdog.detach();
+void DeviceController::stop_watchdog() {
+  if (!watchdog_.joinable()) {
+    return;
+  }
+  watchdog_stop_ = true;
+  clock_.wake();
+  watchdog_.join();
 }
 
 void DeviceController::update_watchdog() {
-  last_loop_time_ = std::chrono::steady_clock::now();
+  last_loop_time_ = clock_.now();
+}
+
+bool DeviceController::read_slave_inputs(SlaveInputs& slave) {
+  const PointTable::Slave& plan = *slave.plan;
+
+  // As many inputs per request as the slave's device profile allows
+  for (std::size_t first_bit = 0; first_bit < plan.bit_count; first_bit += plan.read_bits) {
+    const std::size_t count = std::min(plan.read_bits, plan.bit_count - first_bit);
+
+    const auto start = clock_.now();
+    const bool ok = modbus_.read_input_bits(plan.slave_id, static_cast<int>(first_bit), static_cast<int>(count),
+                                            read_buffer_.data());
+    const auto elapsed = clock_.now() - start;
+    slave.modbus_latency->record(elapsed);
+    bus_busy_ += elapsed;
+
+    if (!ok) {
+      return false;
+    }
+    slave.current.load_bits(first_bit, read_buffer_.data(), count);
+  }
+
+  return true;
 }
 
-void DeviceController::publish_input_state(InputState& state, bool current_state, bool force) {
-  auto now = std::chrono::steady_clock::now();
-  auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - state.last_publish).count();
+std::size_t DeviceController::read_relay_states(std::vector<MqttMessage>& messages, std::size_t& readable) {
+  std::map<int, std::vector<std::size_t>> slave_relays;  // sorted by address
+  for (std::size_t i = 0; i < relay_states_.size(); i++) {
+    const Relay& relay = *relay_states_[i].relay;
+    // Nothing answers on the broadcast address
+    if (relay.address >= 0 && relay.slave_id != 0) {
+      slave_relays[relay.slave_id].push_back(i);
+    }
+  }
+
+  std::size_t read = 0;
+  readable = 0;
+  std::vector<uint8_t> coils;
+
+  for (auto& [slave_id, indices] : slave_relays) {
+    auto profile = points_->profiles.find(slave_id);
+    if (profile != points_->profiles.end() && !profile->second.supports(ModbusFunction::READ_COILS)) {
+      LOG_WARNING(logger_) << "Slave " << slave_id << " (" << profile->second.name
+                           << ") cannot read back coils, relay states are unknown until commanded";
+      continue;
+    }
+    readable += indices.size();
+    const int max_bits =
+        profile != points_->profiles.end() ? std::max(profile->second.max_read_bits, 1) : DeviceProfile().max_read_bits;
+
+    std::sort(indices.begin(), indices.end(), [this](std::size_t a, std::size_t b) {
+      return relay_states_[a].relay->address < relay_states_[b].relay->address;
+    });
+
+    // Each request starts at the lowest unread coil and covers as many as the profile allows
+    for (std::size_t first = 0; first < indices.size();) {
+      const int start_addr = relay_states_[indices[first]].relay->address;
+      std::size_t last = first;
+      while (last + 1 < indices.size() && relay_states_[indices[last + 1]].relay->address < start_addr + max_bits) {
+        last++;
+      }
+      const int count = relay_states_[indices[last]].relay->address - start_addr + 1;
+
+      coils.assign(static_cast<std::size_t>(count), 0);
+      RelayState& head = relay_states_[indices[first]];
+      const auto start = clock_.now();
+      const bool ok = modbus_.read_coils(slave_id, start_addr, count, coils.data());
+      const auto elapsed = clock_.now() - start;
+      head.modbus_latency->record(elapsed);
+      bus_busy_ += elapsed;
+
+      for (std::size_t i = first; ok && i <= last; i++) {
+        RelayState& state = relay_states_[indices[i]];
+        state.current_state = coils[static_cast<std::size_t>(state.relay->address - start_addr)] != 0;
+        messages.push_back({state.relay->mqtt_state_topic, state.current_state ? "ON" : "OFF"});
+        read++;
+      }
+      first = last + 1;
+    }
+  }
+
+  return read;
+}
 
-  bool should_publish =
-      force || (current_state != state.last_state) || (elapsed >= polling_config_.refresh_interval_sec);
+void DeviceController::execute_group(const RelayCommand& cmd) {
+  const PointTable::Group& group = points_->groups[cmd.relay];
 
-  if (should_publish) {
-    const char* payload = current_state ? "ON" : "OFF";
+  const auto write_start = clock_.now();
+  const bool sent = modbus_.broadcast_coils(group.address, group.count, cmd.desired_state);
+  const auto write_end = clock_.now();
+  bus_busy_ += write_end - write_start;
+  if (!sent) {
+    LOG_ERROR(logger_) << "Failed to broadcast group " << group.name;
+    return;
+  }
+  command_to_write_latency_.histogram.record(write_end - cmd.enqueued);
+
+  std::size_t corrected = 0;
+  std::size_t unknown = 0;
+  std::vector<uint8_t> coils;
+
+  for (const auto& member : group.members) {
+    auto profile = points_->profiles.find(member.slave_id);
+    const bool verify = group.verify;
+    const bool readable =
+        profile == points_->profiles.end() || profile->second.supports(ModbusFunction::READ_COILS);
+
+    // One read of the member coils, split only where the profile requires it
+    const int first_addr = relay_states_[member.relays.front()].relay->address;
+    const int last_addr = relay_states_[member.relays.back()].relay->address;
+    bool read = verify && readable;
+    if (read) {
+      const int max_bits = profile != points_->profiles.end() ? std::max(profile->second.max_read_bits, 1)
+                                                              : DeviceProfile().max_read_bits;
+      coils.assign(static_cast<std::size_t>(last_addr - first_addr + 1), 0);
+      const auto start = clock_.now();
+      for (int addr = first_addr; read && addr <= last_addr; addr += max_bits) {
+        read = modbus_.read_coils(member.slave_id, addr, std::min(max_bits, last_addr - addr + 1),
+                                  coils.data() + (addr - first_addr));
+      }
+      const auto elapsed = clock_.now() - start;
+      relay_states_[member.relays.front()].modbus_latency->record(elapsed);
+      bus_busy_ += elapsed;
+    }
 
-    if (mqtt_.publish(state.input->mqtt_topic, payload, true)) {
-      if (current_state != state.last_state) {
-        logger_.debug() << "INPUT: " << state.input->name << " = " << payload;
+    for (std::size_t index : member.relays) {
+      RelayState& state = relay_states_[index];
+      if (verify && !read) {
+        unknown++;
+        continue;
+      }
+      if (read && (coils[static_cast<std::size_t>(state.relay->address - first_addr)] != 0) != cmd.desired_state) {
+        // Missed the broadcast: fall back to an acknowledged write
+        const auto start = clock_.now();
+        const bool written = modbus_.write_coil(state.relay->slave_id, state.relay->address, cmd.desired_state);
+        bus_busy_ += clock_.now() - start;
+        if (!written) {
+          unknown++;
+          continue;
+        }
+        corrected++;
       }
+      state.current_state = cmd.desired_state;
+      publish_relay_state(state);
     }
+  }
+
+  if (corrected > 0 || unknown > 0) {
+    LOG_WARNING(logger_) << "Group " << group.name << ": " << corrected << " relays missed the broadcast and were set "
+                         << "individually, " << unknown << " could not be confirmed";
+  }
+  LOG_DEBUG(logger_) << "GROUP: " << group.name << " = " << (cmd.desired_state ? "ON" : "OFF") << " on "
+                     << group.members.size() << " slaves";
+}
 
-    state.last_publish = now;
+void DeviceController::publish_input_state(const DigitalInput& input, bool current_state, bool changed,
+                                           std::chrono::steady_clock::time_point sampled) {
+  const char* payload = current_state ? "ON" : "OFF";
+
+  if (mqtt_.publish(input.mqtt_topic, payload, true)) {
+    if (changed) {
+      read_to_publish_latency_.histogram.record(clock_.now() - sampled);
+      LOG_DEBUG(logger_) << "INPUT: " << input.name << " = " << payload;
+    }
   }
 }
 
@@ -187,8 +636,26 @@ void DeviceController::publish_relay_state(const RelayState& state) {
   mqtt_.publish(state.relay->mqtt_state_topic, payload, true);
 }
 
-void DeviceController::group_inputs_by_slave(std::map<int, std::vector<InputState*>>& groups) {
-  for (auto& state : input_states_) {
-    groups[state.input->slave_id].push_back(&state);
+DeviceController::LatencyChannel& DeviceController::add_latency_channel(const std::string& name,
+                                                                        const std::string& metric,
+                                                                        const std::string& help,
+                                                                        const MetricLabels& labels) {
+  auto channel = std::make_unique<LatencyChannel>(name);
+  channel->registration = MetricsRegistry::instance().add_histogram(metric, help, labels, channel->histogram);
+  latency_channels_.push_back(std::move(channel));
+  return *latency_channels_.back();
+}
+
+LatencyHistogram* DeviceController::slave_latency(int slave_id) {
+  const std::string name = "modbus_slave_" + std::to_string(slave_id);
+
+  for (auto& channel : latency_channels_) {
+    if (channel->name == name) {
+      return &channel->histogram;
+    }
   }
-}
\ No newline at end of file
+
+  return &add_latency_channel(name, "modbus_transaction_seconds", "Modbus transaction duration per slave",
+                              {{"slave", std::to_string(slave_id)}})
+              .histogram;
+}
@@ -0,0 +1,133 @@
+#include "device_profile.hpp"
+
+#include "point_templates.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+bool DeviceProfile::supports(ModbusFunction function) const {
+  return std::find(function_codes.begin(), function_codes.end(), static_cast<int>(function)) !=
+         function_codes.end();
+}
+
+bool DeviceProfile::read_function(ModbusFunction& function) const {
+  for (auto candidate : {ModbusFunction::READ_DISCRETE_INPUTS, ModbusFunction::READ_COILS}) {
+    if (supports(candidate)) {
+      function = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DeviceProfile::write_function(ModbusFunction& function) const {
+  for (auto candidate : {ModbusFunction::WRITE_SINGLE_COIL, ModbusFunction::WRITE_MULTIPLE_COILS}) {
+    if (supports(candidate)) {
+      function = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+DeviceProfile DeviceProfile::from_json(const std::string& name, const nlohmann::json& j) {
+  DeviceProfile profile;
+  profile.name = name;
+  profile.inputs = j.value("inputs", 0);
+  profile.coils = j.value("coils", 0);
+  profile.function_codes = j.value("function_codes", profile.function_codes);
+  profile.max_read_bits = j.value("max_read_bits", profile.max_read_bits);
+  profile.inter_frame_delay_ms = j.value("inter_frame_delay_ms", 0);
+
+  return profile;
+}
+
+namespace {
+
+DeviceProfile builtin(const std::string& name, int inputs, int coils, std::vector<int> function_codes,
+                      int max_read_bits) {
+  DeviceProfile profile;
+  profile.name = name;
+  profile.inputs = inputs;
+  profile.coils = coils;
+  profile.function_codes = std::move(function_codes);
+  profile.max_read_bits = max_read_bits;
+  return profile;
+}
+
+}  // namespace
+
+DeviceCatalog::DeviceCatalog() {
+  // Plain digital I/O modules as sold for DIN rail RS-485 buses
+  for (auto profile : {builtin(kGenericProfile, 0, 0, {0x01, 0x02, 0x05, 0x0F}, 8),
+                       builtin("di8", 8, 0, {0x02}, 8),
+                       builtin("di16", 16, 0, {0x02}, 16),
+                       builtin("do8", 0, 8, {0x01, 0x05, 0x0F}, 8),
+                       builtin("do32", 0, 32, {0x01, 0x05, 0x0F}, 32),
+                       builtin("io8", 8, 8, {0x01, 0x02, 0x05, 0x0F}, 8)}) {
+    profiles_.emplace(profile.name, profile);
+  }
+}
+
+void DeviceCatalog::load(const nlohmann::json& config, std::vector<ConfigDiagnostic>& diagnostics) {
+  auto error = [&diagnostics](const std::string& path, const std::string& message) {
+    diagnostics.push_back({ConfigDiagnostic::Severity::ERROR, path, message});
+  };
+
+  const auto profiles = config.value("device_profiles", nlohmann::json::object());
+  for (const auto& [name, j] : profiles.items()) {
+    const std::string path = "/device_profiles/" + name;
+    try {
+      DeviceProfile profile = DeviceProfile::from_json(name, j);
+      if (profile.max_read_bits < 1 || profile.max_read_bits > DeviceProfile::kMaxReadBits) {
+        error(path + "/max_read_bits", "must be 1-" + std::to_string(DeviceProfile::kMaxReadBits));
+      }
+      if (profile.inputs < 0 || profile.coils < 0 || profile.inter_frame_delay_ms < 0) {
+        error(path, "inputs, coils and inter_frame_delay_ms must not be negative");
+      }
+      profiles_[name] = std::move(profile);
+    } catch (const nlohmann::json::exception& e) {
+      error(path, e.what());
+    }
+  }
+
+  const auto slaves = config.value("slaves", nlohmann::json::array());
+  for (std::size_t i = 0; i < slaves.size(); i++) {
+    const std::string path = "/slaves/" + std::to_string(i);
+    try {
+      const std::string profile = slaves[i].at("profile").get<std::string>();
+      for (int slave_id : parse_id_range(slaves[i].at("slave_id"))) {
+        assign(slave_id, profile, path + "/profile", diagnostics);
+      }
+    } catch (const nlohmann::json::exception& e) {
+      error(path, e.what());
+    } catch (const std::invalid_argument& e) {
+      error(path + "/slave_id", e.what());
+    }
+  }
+}
+
+void DeviceCatalog::assign(int slave_id, const std::string& profile, const std::string& path,
+                           std::vector<ConfigDiagnostic>& diagnostics) {
+  if (profiles_.count(profile) == 0) {
+    diagnostics.push_back({ConfigDiagnostic::Severity::ERROR, path, "unknown device profile '" + profile + "'"});
+    return;
+  }
+
+  auto [it, inserted] = assignments_.emplace(slave_id, std::make_pair(profile, path));
+  if (!inserted && it->second.first != profile) {
+    diagnostics.push_back({ConfigDiagnostic::Severity::ERROR, path,
+                           "slave " + std::to_string(slave_id) + " is already a '" + it->second.first + "' (" +
+                               it->second.second + ")"});
+  }
+}
+
+const DeviceProfile& DeviceCatalog::profile_for(int slave_id) const {
+  auto it = assignments_.find(slave_id);
+  return profiles_.at(it == assignments_.end() ? kGenericProfile : it->second.first);
+}
+
+const DeviceProfile* DeviceCatalog::find(const std::string& name) const {
+  auto it = profiles_.find(name);
+  return it == profiles_.end() ? nullptr : &it->second;
+}
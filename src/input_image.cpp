@@ -0,0 +1,103 @@
+#include "input_image.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+InputImage::InputImage(std::size_t bit_count) : bit_count_(0) {
+  resize(bit_count);
+}
+
+void InputImage::resize(std::size_t bit_count) {
+  bit_count_ = bit_count;
+  words_.assign((bit_count + kBitsPerWord - 1) / kBitsPerWord, 0);
+}
+
+void InputImage::clear() {
+  std::fill(words_.begin(), words_.end(), 0);
+}
+
+void InputImage::set(std::size_t bit, bool value) {
+  const uint64_t mask = uint64_t{1} << (bit % kBitsPerWord);
+  uint64_t& word = words_[bit / kBitsPerWord];
+  word = value ? (word | mask) : (word & ~mask);
+}
+
+void InputImage::load_bits(std::size_t first_bit, const uint8_t* bits, std::size_t count) {
+  std::size_t bit = first_bit;
+  const std::size_t end = std::min(first_bit + count, bit_count_);
+
+  while (bit < end) {
+    // Assemble as many bits as fit in the current word, then store it once
+    const std::size_t offset = bit % kBitsPerWord;
+    const std::size_t take = std::min(kBitsPerWord - offset, end - bit);
+    const uint64_t mask = (take == kBitsPerWord) ? ~uint64_t{0} : (((uint64_t{1} << take) - 1) << offset);
+
+    uint64_t packed = 0;
+    for (std::size_t i = 0; i < take; i++) {
+      packed |= static_cast<uint64_t>(bits[bit - first_bit + i] != 0) << (offset + i);
+    }
+
+    uint64_t& word = words_[bit / kBitsPerWord];
+    word = (word & ~mask) | packed;
+    bit += take;
+  }
+}
+
+std::size_t InputImage::count() const {
+  std::size_t total = 0;
+  for (uint64_t word : words_) {
+    total += static_cast<std::size_t>(__builtin_popcountll(word));
+  }
+  return total;
+}
+
+bool InputImage::equals(const InputImage& other) const {
+  if (bit_count_ != other.bit_count_) {
+    return false;
+  }
+
+  const std::size_t n = words_.size();
+  const uint64_t* a = words_.data();
+  const uint64_t* b = other.words_.data();
+  std::size_t w = 0;
+
+#if defined(__SSE2__)
+  if (n >= kSimdMinWords) {
+    __m128i acc = _mm_setzero_si128();
+    for (; w + 2 <= n; w += 2) {
+      const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + w));
+      const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + w));
+      acc = _mm_or_si128(acc, _mm_xor_si128(va, vb));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF) {
+      return false;
+    }
+  }
+#elif defined(__ARM_NEON)
+  if (n >= kSimdMinWords) {
+    uint64x2_t acc = vdupq_n_u64(0);
+    for (; w + 2 <= n; w += 2) {
+      acc = vorrq_u64(acc, veorq_u64(vld1q_u64(a + w), vld1q_u64(b + w)));
+    }
+    if ((vgetq_lane_u64(acc, 0) | vgetq_lane_u64(acc, 1)) != 0) {
+      return false;
+    }
+  }
+#endif
+
+  uint64_t diff = 0;
+  for (; w < n; w++) {
+    diff |= a[w] ^ b[w];
+  }
+  return diff == 0;
+}
+
+void InputImage::swap(InputImage& other) noexcept {
+  words_.swap(other.words_);
+  std::swap(bit_count_, other.bit_count_);
+}
@@ -0,0 +1,157 @@
+#include "log_level_control.hpp"
+
+#include <nlohmann/json.hpp>
+
+namespace {
+
+// Statements below the compiled floor are gone from the binary, so a lower
+// level would be accepted but change nothing
+LogLevel effective_level(LogLevel level) {
+  return static_cast<int>(level) < LOG_COMPILE_MIN_LEVEL ? static_cast<LogLevel>(LOG_COMPILE_MIN_LEVEL) : level;
+}
+
+}  // namespace
+
+LogLevelControl::LogLevelControl(const std::string& topic_prefix, int default_revert_sec, IMqttManager& mqtt)
+    : topic_prefix_(topic_prefix),
+      default_revert_(default_revert_sec),
+      mqtt_(mqtt),
+      configured_global_(Logger::get_global_level()),
+      dirty_(true),
+      logger_("LogLevelControl") {}
+
+bool LogLevelControl::handle_command(const std::string& topic, const std::string& payload, Clock::time_point now) {
+  // "<prefix>/<component>/set"
+  const std::string prefix = topic_prefix_ + "/";
+  const std::string suffix = "/set";
+
+  if (topic.size() <= prefix.size() + suffix.size() || topic.compare(0, prefix.size(), prefix) != 0 ||
+      topic.compare(topic.size() - suffix.size(), suffix.size(), suffix) != 0) {
+    return false;
+  }
+
+  const std::string component = topic.substr(prefix.size(), topic.size() - prefix.size() - suffix.size());
+  if (component.find('/') != std::string::npos) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (apply(component, payload, now)) {
+    dirty_ = true;
+  }
+  return true;
+}
+
+bool LogLevelControl::apply(const std::string& component, const std::string& payload, Clock::time_point now) {
+  std::string level_name = payload;
+  std::chrono::seconds revert_after = default_revert_;
+
+  if (!payload.empty() && payload.front() == '{') {
+    try {
+      auto j = nlohmann::json::parse(payload);
+      level_name = j.value("level", "");
+      revert_after = std::chrono::seconds(j.value("revert_after_sec", static_cast<int>(default_revert_.count())));
+    } catch (const nlohmann::json::exception& e) {
+      LOG_WARNING(logger_) << "Invalid log level command for " << component << ": " << e.what();
+      return false;
+    }
+  }
+
+  const bool is_global = (component == kGlobalComponent);
+
+  if (level_name == "default") {
+    revert(component);
+    LOG_INFO(logger_) << "Log level of " << component << " back to default";
+    return true;
+  }
+
+  LogLevel level;
+  if (!Logger::parse_level(level_name, level)) {
+    LOG_WARNING(logger_) << "Unknown log level '" << level_name << "' for " << component;
+    return false;
+  }
+  if (effective_level(level) != level) {
+    level = effective_level(level);
+    LOG_WARNING(logger_) << "Log level '" << level_name << "' is not compiled in; using "
+                         << Logger::get_level_string(level) << " for " << component;
+  }
+
+  if (is_global) {
+    Logger::set_global_level(level);
+  } else if (!Logger::set_component_level(component, level)) {
+    LOG_WARNING(logger_) << "Unknown log component: " << component;
+    return false;
+  }
+
+  if (revert_after.count() > 0) {
+    revert_at_[component] = now + revert_after;
+  } else {
+    revert_at_.erase(component);
+  }
+
+  LOG_INFO(logger_) << "Log level of " << component << " set to " << Logger::get_level_string(level)
+                    << (revert_after.count() > 0 ? " for " + std::to_string(revert_after.count()) + "s" : "");
+  return true;
+}
+
+void LogLevelControl::revert(const std::string& component) {
+  if (component == kGlobalComponent) {
+    Logger::set_global_level(configured_global_);
+  } else {
+    Logger::clear_component_level(component);
+  }
+  revert_at_.erase(component);
+}
+
+void LogLevelControl::tick(Clock::time_point now) {
+  std::string state;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto it = revert_at_.begin(); it != revert_at_.end();) {
+      const std::string component = it->first;
+      const bool expired = (now >= it->second);
+      ++it;
+      if (expired) {
+        revert(component);
+        LOG_INFO(logger_) << "Log level override of " << component << " expired";
+        dirty_ = true;
+      }
+    }
+
+    if (!dirty_) {
+      return;
+    }
+    dirty_ = false;
+    state = levels_json();
+  }
+
+  mqtt_.publish(topic_prefix_ + "/levels", state, true);
+}
+
+void LogLevelControl::set_default_global_level(LogLevel level) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  configured_global_ = level;
+  // A temporary global override stays in effect until it expires
+  if (revert_at_.count(kGlobalComponent) == 0) {
+    Logger::set_global_level(level);
+  }
+  dirty_ = true;
+}
+
+std::string LogLevelControl::levels_json() const {
+  nlohmann::json j;
+  j["global"] = Logger::get_level_string(effective_level(Logger::get_global_level()));
+
+  nlohmann::json overrides = nlohmann::json::object();
+  for (const auto& component : Logger::components()) {
+    LogLevel level;
+    if (Logger::get_component_level(component, level)) {
+      overrides[component] = Logger::get_level_string(effective_level(level));
+    }
+  }
+  j["overrides"] = overrides;
+
+  return j.dump();
+}
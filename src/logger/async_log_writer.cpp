@@ -0,0 +1,152 @@
+#include "logger/async_log_writer.hpp"
+
+#include "logger/file_sink.hpp"
+
+#include <cerrno>
+#include <unistd.h>
+
+namespace {
+
+void write_all(int fd, const std::string& data) {
+  std::size_t written = 0;
+  while (written < data.size()) {
+    ssize_t rc = ::write(fd, data.data() + written, data.size() - written);
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    written += static_cast<std::size_t>(rc);
+  }
+}
+
+}  // namespace
+
+AsyncLogWriter::AsyncLogWriter(std::size_t queue_size, LogOverflowPolicy policy)
+    : queue_(queue_size),
+      policy_(policy),
+      running_(true),
+      producers_(0),
+      idle_(false),
+      dropped_(0),
+      reported_dropped_(0) {
+  out_buffer_.reserve(kBatchSize * 128);
+  err_buffer_.reserve(1024);
+  thread_ = std::thread(&AsyncLogWriter::run, this);
+}
+
+AsyncLogWriter::~AsyncLogWriter() {
+  stop();
+}
+
+bool AsyncLogWriter::push(LogRecord&& record) {
+  // Either stop() sees this producer and waits for it, or this sees the stop
+  producers_.fetch_add(1);
+  if (!running_.load()) {
+    producers_.fetch_sub(1);
+    return false;
+  }
+
+  if (queue_.try_push(record)) {
+    if (idle_.load(std::memory_order_relaxed)) {
+      wake_.notify_one();
+    }
+    producers_.fetch_sub(1, std::memory_order_release);
+    return true;
+  }
+
+  if (policy_ == LogOverflowPolicy::DROP) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    producers_.fetch_sub(1, std::memory_order_release);
+    return true;
+  }
+
+  // BLOCK: wait for the writer to make room
+  while (!queue_.try_push(record)) {
+    if (!running_.load(std::memory_order_relaxed)) {
+      producers_.fetch_sub(1);
+      return false;
+    }
+    wake_.notify_one();
+    std::this_thread::yield();
+  }
+  producers_.fetch_sub(1, std::memory_order_release);
+  return true;
+}
+
+void AsyncLogWriter::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+
+  wake_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  // Records pushed while the writer thread finished; nothing else consumes now
+  while (producers_.load(std::memory_order_acquire) > 0) {
+    std::this_thread::yield();
+  }
+  while (drain() > 0) {
+  }
+}
+
+void AsyncLogWriter::run() {
+  while (running_.load(std::memory_order_relaxed)) {
+    if (drain() == 0) {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      idle_.store(true, std::memory_order_relaxed);
+      wake_.wait_for(lock, kIdleWait);
+      idle_.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  // Flush whatever producers queued before stop()
+  while (drain() > 0) {
+  }
+}
+
+std::size_t AsyncLogWriter::drain() {
+  LogRecord record;
+  std::size_t count = 0;
+
+  // A file sink takes every level in order; otherwise errors go to stderr
+  FileLogSink* sink = Logger::file_sink();
+
+  out_buffer_.clear();
+  err_buffer_.clear();
+
+  while (count < kBatchSize && queue_.try_pop(record)) {
+    std::string& buffer = (sink == nullptr && record.level >= LogLevel::LEVEL_ERROR) ? err_buffer_ : out_buffer_;
+    Logger::format_record(record, buffer);
+    buffer += '\n';
+    count++;
+  }
+
+  const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+  if (dropped != reported_dropped_) {
+    LogRecord notice{LogLevel::LEVEL_WARNING, std::chrono::system_clock::now(), "Logger",
+                     std::to_string(dropped - reported_dropped_) + " log records dropped (queue full)"};
+    Logger::format_record(notice, out_buffer_);
+    out_buffer_ += '\n';
+    reported_dropped_ = dropped;
+  }
+
+  if (sink != nullptr) {
+    if (!out_buffer_.empty()) {
+      sink->write(out_buffer_);
+    }
+    return count;
+  }
+
+  if (!out_buffer_.empty()) {
+    write_all(STDOUT_FILENO, out_buffer_);
+  }
+  if (!err_buffer_.empty()) {
+    write_all(STDERR_FILENO, err_buffer_);
+  }
+
+  return count;
+}
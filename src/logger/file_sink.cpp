@@ -0,0 +1,263 @@
+#include "logger/file_sink.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <zlib.h>
+
+namespace {
+
+bool write_all(int fd, const char* data, std::size_t size) {
+  std::size_t written = 0;
+  while (written < size) {
+    ssize_t rc = ::write(fd, data + written, size - written);
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    written += static_cast<std::size_t>(rc);
+  }
+  return true;
+}
+
+bool gzip_file(const std::string& source, const std::string& target) {
+  int in = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0) {
+    return false;
+  }
+
+  gzFile out = gzopen(target.c_str(), "wb6");
+  if (out == nullptr) {
+    ::close(in);
+    return false;
+  }
+
+  char buffer[64 * 1024];
+  bool ok = true;
+  for (;;) {
+    ssize_t n = ::read(in, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      ok = (n == 0);
+      break;
+    }
+    if (gzwrite(out, buffer, static_cast<unsigned>(n)) != n) {
+      ok = false;
+      break;
+    }
+  }
+
+  ::close(in);
+  ok = (gzclose(out) == Z_OK) && ok;
+  return ok;
+}
+
+constexpr std::chrono::milliseconds kMaxReopenDelay{60000};
+
+}  // namespace
+
+FileLogSink::FileLogSink(FileSinkOptions options)
+    : options_(std::move(options)),
+      fd_(-1),
+      size_(0),
+      sequence_(0),
+      rotations_(0),
+      open_failures_(0),
+      closed_(false),
+      reopen_delay_(std::max(options_.reopen_delay_ms, 1)),
+      in_progress_(0),
+      stopping_(false) {
+  if (options_.path.empty()) {
+    throw std::runtime_error("Log file path is empty");
+  }
+
+  open_file();
+  worker_ = std::thread(&FileLogSink::run, this);
+}
+
+FileLogSink::~FileLogSink() {
+  close();
+}
+
+void FileLogSink::open_file() {
+  fd_ = ::open(options_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    throw std::runtime_error("Cannot open log file " + options_.path + ": " + std::strerror(errno));
+  }
+
+  struct stat st {};
+  size_ = (::fstat(fd_, &st) == 0) ? static_cast<std::size_t>(st.st_size) : 0;
+
+#ifdef FALLOC_FL_KEEP_SIZE
+  // Reserve the blocks the file will grow into without changing its length;
+  // filesystems without fallocate support simply skip this
+  if (options_.preallocate && options_.max_size_bytes > size_) {
+    ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(size_),
+                static_cast<off_t>(options_.max_size_bytes - size_));
+  }
+#endif
+}
+
+void FileLogSink::write(const char* data, std::size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (fd_ >= 0 && size_ > 0 && size_ + size > options_.max_size_bytes) {
+    rotate();
+  }
+
+  if (fd_ < 0 && !reopen()) {
+    // Better on stderr than nowhere
+    if (!closed_) {
+      write_all(STDERR_FILENO, data, size);
+    }
+    return;
+  }
+
+  if (write_all(fd_, data, size)) {
+    size_ += size;
+  }
+}
+
+bool FileLogSink::reopen() {
+  const auto now = std::chrono::steady_clock::now();
+  if (closed_ || now < reopen_at_) {
+    return false;
+  }
+
+  try {
+    open_file();
+  } catch (const std::exception& e) {
+    fd_ = -1;
+    open_failures_.fetch_add(1, std::memory_order_relaxed);
+    const std::string message = std::string(e.what()) + "; logging to stderr, retrying in " +
+                                std::to_string(reopen_delay_.count()) + " ms\n";
+    write_all(STDERR_FILENO, message.data(), message.size());
+    reopen_at_ = now + reopen_delay_;
+    reopen_delay_ = std::min(reopen_delay_ * 2, kMaxReopenDelay);
+    return false;
+  }
+
+  reopen_delay_ = std::chrono::milliseconds(std::max(options_.reopen_delay_ms, 1));
+  return true;
+}
+
+std::size_t FileLogSink::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+void FileLogSink::rotate() {
+  // Release the unused preallocated tail before the file is archived
+  if (::ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+    // Not fatal: the file just keeps its reserved blocks
+  }
+  ::close(fd_);
+  fd_ = -1;
+
+  const std::string rotated = options_.path + ".rotating." + std::to_string(sequence_++);
+  const bool renamed = (std::rename(options_.path.c_str(), rotated.c_str()) == 0);
+
+  reopen_at_ = std::chrono::steady_clock::time_point{};
+  reopen();
+
+  if (renamed) {
+    rotations_.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    pending_.push_back(rotated);
+    pending_cv_.notify_one();
+  }
+}
+
+void FileLogSink::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    if (fd_ >= 0) {
+      if (::ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+        // Not fatal: the file just keeps its reserved blocks
+      }
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    stopping_ = true;
+  }
+  pending_cv_.notify_one();
+
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void FileLogSink::wait_idle() {
+  std::unique_lock<std::mutex> lock(pending_mutex_);
+  pending_cv_.wait(lock, [this] { return pending_.empty() && in_progress_ == 0; });
+}
+
+void FileLogSink::run() {
+  std::unique_lock<std::mutex> lock(pending_mutex_);
+
+  for (;;) {
+    pending_cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+    if (pending_.empty()) {
+      return;
+    }
+
+    std::string rotated = std::move(pending_.front());
+    pending_.pop_front();
+    in_progress_++;
+
+    lock.unlock();
+    archive(rotated);
+    lock.lock();
+
+    in_progress_--;
+    pending_cv_.notify_all();
+  }
+}
+
+std::string FileLogSink::history_name(int index, bool compressed) const {
+  return options_.path + "." + std::to_string(index) + (compressed ? ".gz" : "");
+}
+
+void FileLogSink::archive(const std::string& rotated) {
+  if (options_.max_files <= 0) {
+    std::remove(rotated.c_str());
+    return;
+  }
+
+  // Shift path.1 -> path.2 ... dropping the oldest. A slot holds path.N.gz,
+  // or path.N when compression failed, so both names move together.
+  for (bool compressed : {false, true}) {
+    std::remove(history_name(options_.max_files, compressed).c_str());
+  }
+  for (int i = options_.max_files - 1; i >= 1; i--) {
+    for (bool compressed : {false, true}) {
+      std::rename(history_name(i, compressed).c_str(), history_name(i + 1, compressed).c_str());
+    }
+  }
+
+  if (options_.compress) {
+    if (gzip_file(rotated, history_name(1, true))) {
+      std::remove(rotated.c_str());
+      return;
+    }
+    // Keep the data uncompressed rather than losing it
+    std::remove(history_name(1, true).c_str());
+  }
+
+  std::rename(rotated.c_str(), history_name(1, false).c_str());
+}
@@ -0,0 +1,55 @@
+#include "logger/log_rate_limiter.hpp"
+
+#include <algorithm>
+
+LogRateLimiter::LogRateLimiter(double rate_per_sec, double burst)
+    : rate_per_sec_(rate_per_sec), burst_(std::max(burst, 1.0)), suppressed_total_(0) {}
+
+bool LogRateLimiter::allow(const void* site, int64_t key, uint64_t& suppressed, Clock::time_point now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = buckets_.find({site, key});
+  if (it == buckets_.end()) {
+    if (buckets_.size() >= kMaxBuckets) {
+      prune(now);
+    }
+    it = buckets_.emplace(std::make_pair(site, key), Bucket{burst_, now, 0}).first;
+  }
+
+  Bucket& bucket = it->second;
+  const double elapsed = std::chrono::duration<double>(now - bucket.last).count();
+  if (elapsed > 0) {
+    bucket.tokens = std::min(burst_, bucket.tokens + elapsed * rate_per_sec_);
+    bucket.last = now;
+  }
+
+  if (bucket.tokens < 1.0) {
+    bucket.suppressed++;
+    suppressed_total_++;
+    return false;
+  }
+
+  bucket.tokens -= 1.0;
+  suppressed = bucket.suppressed;
+  bucket.suppressed = 0;
+  return true;
+}
+
+uint64_t LogRateLimiter::suppressed_total() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return suppressed_total_;
+}
+
+void LogRateLimiter::prune(Clock::time_point now) {
+  // A bucket that would be full again carries no state worth keeping
+  // (unless it still owes a suppressed count)
+  for (auto it = buckets_.begin(); it != buckets_.end();) {
+    const double elapsed = std::chrono::duration<double>(now - it->second.last).count();
+    const bool full = it->second.tokens + elapsed * rate_per_sec_ >= burst_;
+    if (full && it->second.suppressed == 0) {
+      it = buckets_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
@@ -1,20 +1,111 @@
 #include "logger/logger.hpp"
 
-LogLevel Logger::global_level_ = LogLevel::LEVEL_INFO;
-bool Logger::timestamps_enabled_ = true;
-bool Logger::colors_enabled_ = true;
+#include "logger/async_log_writer.hpp"
+#include "logger/file_sink.hpp"
+
+#include <cctype>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <vector>
+
+std::atomic<LogLevel> Logger::global_level_(LogLevel::LEVEL_INFO);
+std::atomic<bool> Logger::timestamps_enabled_(true);
+std::atomic<bool> Logger::colors_enabled_(true);
 std::mutex Logger::mutex_;
+std::atomic<AsyncLogWriter*> Logger::async_writer_(nullptr);
+std::atomic<FileLogSink*> Logger::file_sink_(nullptr);
+std::atomic<LogFormat> Logger::format_(LogFormat::TEXT);
+
+namespace {
+
+// Owns the writer published through Logger::async_writer_. A disabled writer
+// is kept alive until the next enable_async() so late producers never touch
+// freed memory.
+std::unique_ptr<AsyncLogWriter>& async_writer_storage() {
+  static std::unique_ptr<AsyncLogWriter> writer;
+  return writer;
+}
+
+// Context name -> shared override. Function-local so loggers constructed
+// during static initialization can register.
+struct ComponentRegistry {
+  std::mutex mutex;
+  std::map<std::string, std::unique_ptr<LogComponent>> entries;
+};
+
+ComponentRegistry& component_registry() {
+  static ComponentRegistry registry;
+  return registry;
+}
+
+LogComponent* find_component(const std::string& name, bool create) {
+  auto& registry = component_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  auto it = registry.entries.find(name);
+  if (it != registry.entries.end()) {
+    return it->second.get();
+  }
+  if (!create) {
+    return nullptr;
+  }
+  return registry.entries.emplace(name, std::make_unique<LogComponent>()).first->second.get();
+}
+
+// Owns every sink published through Logger::file_sink_. The async writer
+// loads the pointer once per batch, so a replaced sink is closed but never
+// freed; it is a few strings once its fd and worker are gone.
+std::vector<std::unique_ptr<FileLogSink>>& file_sink_storage() {
+  static std::vector<std::unique_ptr<FileLogSink>> sinks;
+  return sinks;
+}
+
+void append_json_string(const std::string& value, std::string& out) {
+  static const char kHex[] = "0123456789abcdef";
+
+  out += '"';
+  for (char c : value) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          out += "\\u00";
+          out += kHex[(c >> 4) & 0xF];
+          out += kHex[c & 0xF];
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+}  // namespace
 
-Logger::Logger(const std::string& context) : context_(context), instance_level_(LogLevel::LEVEL_DEBUG) {}
+Logger::Logger(const std::string& context)
+    : context_(context), instance_level_(LogLevel::LEVEL_DEBUG), component_(find_component(context, true)) {}
 
 void Logger::set_global_level(LogLevel level) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  global_level_ = level;
+  global_level_.store(level, std::memory_order_relaxed);
 }
 
 LogLevel Logger::get_global_level() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return global_level_;
+  return global_level_.load(std::memory_order_relaxed);
 }
 
 void Logger::set_level(LogLevel level) {
@@ -25,6 +116,72 @@ LogLevel Logger::get_level() const {
   return instance_level_;
 }
 
+bool Logger::set_component_level(const std::string& component, LogLevel level) {
+  LogComponent* entry = find_component(component, false);
+  if (entry == nullptr) {
+    return false;
+  }
+  entry->override_level.store(static_cast<int>(level), std::memory_order_relaxed);
+  return true;
+}
+
+bool Logger::clear_component_level(const std::string& component) {
+  LogComponent* entry = find_component(component, false);
+  if (entry == nullptr) {
+    return false;
+  }
+  entry->override_level.store(LogComponent::kNoOverride, std::memory_order_relaxed);
+  return true;
+}
+
+bool Logger::get_component_level(const std::string& component, LogLevel& level) {
+  LogComponent* entry = find_component(component, false);
+  if (entry == nullptr) {
+    return false;
+  }
+  const int value = entry->override_level.load(std::memory_order_relaxed);
+  if (value == LogComponent::kNoOverride) {
+    return false;
+  }
+  level = static_cast<LogLevel>(value);
+  return true;
+}
+
+std::vector<std::string> Logger::components() {
+  auto& registry = component_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  std::vector<std::string> names;
+  for (const auto& entry : registry.entries) {
+    if (!entry.first.empty()) {
+      names.push_back(entry.first);
+    }
+  }
+  return names;
+}
+
+bool Logger::parse_level(const std::string& name, LogLevel& level) {
+  std::string lower;
+  for (char c : name) {
+    lower += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+
+  if (lower == "debug") {
+    level = LogLevel::LEVEL_DEBUG;
+  } else if (lower == "info") {
+    level = LogLevel::LEVEL_INFO;
+  } else if (lower == "warning" || lower == "warn") {
+    level = LogLevel::LEVEL_WARNING;
+  } else if (lower == "error") {
+    level = LogLevel::LEVEL_ERROR;
+  } else if (lower == "critical") {
+    level = LogLevel::LEVEL_CRITICAL;
+  } else {
+    return false;
+  }
+  return true;
+}
+
 void Logger::enable_timestamps(bool enable) {
   std::lock_guard<std::mutex> lock(mutex_);
   timestamps_enabled_ = enable;
@@ -35,6 +192,81 @@ void Logger::enable_colors(bool enable) {
   colors_enabled_ = enable;
 }
 
+void Logger::enable_async(std::size_t queue_size, LogOverflowPolicy policy) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (async_writer_.load() != nullptr) {
+    return;
+  }
+
+  // Anything written synchronously so far must come out first
+  std::cout.flush();
+  std::cerr.flush();
+
+  auto& storage = async_writer_storage();
+  storage = std::make_unique<AsyncLogWriter>(queue_size, policy);
+  async_writer_.store(storage.get(), std::memory_order_release);
+}
+
+void Logger::disable_async() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  AsyncLogWriter* writer = async_writer_.exchange(nullptr);
+  if (writer != nullptr) {
+    writer->stop();
+  }
+}
+
+void Logger::set_format(LogFormat format) {
+  format_.store(format, std::memory_order_relaxed);
+}
+
+LogFormat Logger::get_format() {
+  return format_.load(std::memory_order_relaxed);
+}
+
+void Logger::enable_file_output(const FileSinkOptions& options) {
+  auto sink = std::make_unique<FileLogSink>(options);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  FileLogSink* previous = file_sink_.exchange(nullptr);
+  if (previous != nullptr) {
+    previous->close();
+  }
+
+  auto& storage = file_sink_storage();
+  storage.push_back(std::move(sink));
+  file_sink_.store(storage.back().get(), std::memory_order_release);
+}
+
+void Logger::disable_file_output() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  FileLogSink* sink = file_sink_.exchange(nullptr);
+  if (sink != nullptr) {
+    sink->close();
+  }
+}
+
+FileLogSink* Logger::file_sink() {
+  return file_sink_.load(std::memory_order_acquire);
+}
+
+bool Logger::is_async() {
+  return async_writer_.load(std::memory_order_acquire) != nullptr;
+}
+
+uint64_t Logger::dropped_count() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& storage = async_writer_storage();
+  return storage ? storage->dropped() : 0;
+}
+
+Logger::LogStream Logger::stream(LogLevel level) {
+  return LogStream(*this, level);
+}
+
 Logger::LogStream Logger::debug() {
   return LogStream(*this, LogLevel::LEVEL_DEBUG);
 }
@@ -62,22 +294,42 @@ void Logger::log(LogLevel level, const std::string& message) {
 }
 
 bool Logger::should_log(LogLevel level) const {
-  return level >= instance_level_ && level >= global_level_;
+  return static_cast<int>(level) >= LOG_COMPILE_MIN_LEVEL && is_enabled(level);
 }
 
-std::string Logger::get_timestamp() const {
-  auto now = std::chrono::system_clock::now();
-  auto time_t = std::chrono::system_clock::to_time_t(now);
-  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
+void Logger::append_timestamp(std::chrono::system_clock::time_point time, std::string& out) {
+  // "YYYY-mm-dd HH:MM:SS.mmm"; the date/time part is formatted once per second
+  // per thread and only the milliseconds are rewritten for each line
+  struct TimestampCache {
+    std::time_t second = -1;
+    char text[kTimestampLength + 1] = {};
+  };
+  thread_local TimestampCache cache;
+
+  const auto ms_since_epoch =
+      std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+  std::time_t second = static_cast<std::time_t>(ms_since_epoch / 1000);
+  int ms = static_cast<int>(ms_since_epoch % 1000);
+  if (ms < 0) {
+    ms += 1000;
+    second -= 1;
+  }
+
+  if (second != cache.second) {
+    std::tm local{};
+    localtime_r(&second, &local);
+    std::strftime(cache.text, sizeof(cache.text), "%Y-%m-%d %H:%M:%S.", &local);
+    cache.second = second;
+  }
 
-  std::ostringstream oss;
-  oss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-  oss << '.' << std::setfill('0') << std::setw(3) << ms.count();
+  cache.text[kTimestampLength - 3] = static_cast<char>('0' + ms / 100);
+  cache.text[kTimestampLength - 2] = static_cast<char>('0' + ms / 10 % 10);
+  cache.text[kTimestampLength - 1] = static_cast<char>('0' + ms % 10);
 
-  return oss.str();
+  out.append(cache.text, kTimestampLength);
 }
 
-std::string Logger::get_level_string(LogLevel level) const {
+std::string Logger::get_level_string(LogLevel level) {
   switch (level) {
     case LogLevel::LEVEL_DEBUG:
       return "DEBUG";
@@ -94,7 +346,7 @@ std::string Logger::get_level_string(LogLevel level) const {
   }
 }
 
-std::string Logger::get_level_color(LogLevel level) const {
+std::string Logger::get_level_color(LogLevel level) {
   if (!colors_enabled_) {
     return "";
   }
@@ -115,32 +367,108 @@ std::string Logger::get_level_color(LogLevel level) const {
   }
 }
 
-void Logger::write_log(LogLevel level, const std::string& message) {
-  std::lock_guard<std::mutex> lock(mutex_);
+void Logger::format_record(const LogRecord& record, std::string& out) {
+  if (format_.load(std::memory_order_relaxed) == LogFormat::JSON) {
+    format_json(record, out);
+  } else {
+    format_text(record, out);
+  }
+}
 
-  std::ostream& out = (level >= LogLevel::LEVEL_ERROR) ? std::cerr : std::cout;
+void Logger::format_text(const LogRecord& record, std::string& out) {
+  // Escape codes only make sense on a terminal
+  const bool colors = colors_enabled_.load(std::memory_order_relaxed) && file_sink() == nullptr;
+
+  if (colors) {
+    out += get_level_color(record.level);
+  }
+
+  if (timestamps_enabled_.load(std::memory_order_relaxed)) {
+    out += '[';
+    append_timestamp(record.time, out);
+    out += "] ";
+  }
 
-  if (colors_enabled_) {
-    out << get_level_color(level);
+  const std::string level = get_level_string(record.level);
+  out += '[';
+  out += level;
+  out.append(level.size() < 8 ? 8 - level.size() : 0, ' ');
+  out += "] ";
+
+  if (!record.context.empty()) {
+    out += '[';
+    out += record.context;
+    out += "] ";
+  }
+
+  out += record.message;
+
+  for (const auto& field : record.fields) {
+    out += ' ';
+    out += field.key;
+    out += '=';
+    out += field.value;
+  }
+
+  if (colors) {
+    out += "\033[0m";
   }
+}
 
-  if (timestamps_enabled_) {
-    out << "[" << get_timestamp() << "] ";
+void Logger::format_json(const LogRecord& record, std::string& out) {
+  const auto mono_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(record.monotonic.time_since_epoch()).count();
+
+  out += "{\"ts\":\"";
+  append_timestamp(record.time, out);
+  out += "\",\"mono_us\":";
+  out += std::to_string(mono_us);
+  out += ",\"level\":\"";
+  out += get_level_string(record.level);
+  out += "\",\"context\":";
+  append_json_string(record.context, out);
+  out += ",\"msg\":";
+  append_json_string(record.message, out);
+
+  if (!record.fields.empty()) {
+    out += ",\"fields\":{";
+    for (std::size_t i = 0; i < record.fields.size(); i++) {
+      if (i > 0) {
+        out += ',';
+      }
+      append_json_string(record.fields[i].key, out);
+      out += ':';
+      append_json_string(record.fields[i].value, out);
+    }
+    out += '}';
   }
 
-  out << "[" << std::setw(8) << std::left << get_level_string(level) << "] ";
+  out += '}';
+}
+
+void Logger::write_log(LogLevel level, std::string message, std::vector<LogField> fields) {
+  LogRecord record{level, std::chrono::system_clock::now(), context_, std::move(message), std::move(fields)};
 
-  if (!context_.empty()) {
-    out << "[" << context_ << "] ";
+  // A stopped writer hands the record back to be written here
+  AsyncLogWriter* writer = async_writer_.load(std::memory_order_acquire);
+  if (writer != nullptr && writer->push(std::move(record))) {
+    return;
   }
 
-  out << message;
+  std::string line;
+  format_record(record, line);
 
-  if (colors_enabled_) {
-    out << "\033[0m";
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  FileLogSink* sink = file_sink_.load(std::memory_order_acquire);
+  if (sink != nullptr) {
+    line += '\n';
+    sink->write(line);
+    return;
   }
 
-  out << std::endl;
+  std::ostream& out = (level >= LogLevel::LEVEL_ERROR) ? std::cerr : std::cout;
+  out << line << std::endl;
 }
 
 Logger::LogStream::LogStream(Logger& logger, LogLevel level)
@@ -148,6 +476,9 @@ Logger::LogStream::LogStream(Logger& logger, LogLevel level)
 
 Logger::LogStream::~LogStream() {
   if (should_log_) {
-    logger_.write_log(level_, stream_.str());
+    if (suppressed_ > 0) {
+      stream_ << " (" << suppressed_ << " messages suppressed)";
+    }
+    logger_.write_log(level_, stream_.str(), std::move(fields_));
   }
 }
\ No newline at end of file
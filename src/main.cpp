@@ -7,6 +7,8 @@
 
 std::atomic<bool> g_running(true);
 std::atomic<bool> g_force_exit(false);
+std::atomic<bool> g_dump_stats(false);
+std::atomic<bool> g_reload(false);
 Logger main_logger("Main");
 
 void signal_handler(int signum) {
@@ -14,55 +16,68 @@ void signal_handler(int signum) {
   signal_count++;
 
   if (signal_count == 1) {
-    main_logger.info() << "Received signal " << signum << ", shutting down gracefully...";
+    LOG_INFO(main_logger) << "Received signal " << signum << ", shutting down gracefully...";
     g_running = false;
   } else {
-    main_logger.critical() << "Received signal " << signum << " again, FORCING EXIT!";
+    LOG_CRITICAL(main_logger) << "Received signal " << signum << " again, FORCING EXIT!";
     g_force_exit = true;
     std::thread([]() {
       std::this_thread::sleep_for(std::chrono::seconds(1));
-      main_logger.critical() << "Terminating process...";
+      LOG_CRITICAL(main_logger) << "Terminating process...";
+      Logger::disable_async();
       _exit(1);
     }).detach();
   }
 }
 
+void dump_stats_handler(int) {
+  g_dump_stats = true;
+}
+
+void reload_handler(int) {
+  g_reload = true;
+}
+
 int main(int argc, char* argv[]) {
   Logger::enable_timestamps(true);
   Logger::enable_colors(true);
-  Logger::set_global_level(LogLevel::LEVEL_DEBUG);
 
-  main_logger.info() << "========================================";
-  main_logger.info() << "Modbus RTU ↔ MQTT Gateway v3.0";
-  main_logger.info() << "Professional Edition with JSON Config";
-  main_logger.info() << "========================================";
+  LOG_INFO(main_logger) << "========================================";
+  LOG_INFO(main_logger) << "Modbus RTU ↔ MQTT Gateway v3.0";
+  LOG_INFO(main_logger) << "Professional Edition with JSON Config";
+  LOG_INFO(main_logger) << "========================================";
 
   signal(SIGINT, signal_handler);
   signal(SIGTERM, signal_handler);
+  signal(SIGUSR1, dump_stats_handler);
+  signal(SIGHUP, reload_handler);
 
   std::string config_file = "config.json";
   if (argc > 1) {
     config_file = argv[1];
   }
 
-  main_logger.debug() << "Using config file: " << config_file;
+  LOG_DEBUG(main_logger) << "Using config file: " << config_file;
 
   try {
     Application app(config_file);
 
     if (!app.initialize()) {
-      main_logger.error() << "Failed to initialize application";
+      LOG_ERROR(main_logger) << "Failed to initialize application";
+      Logger::disable_async();
       return 1;
     }
 
-    app.run(g_running, g_force_exit);
+    app.run(g_running, g_force_exit, g_dump_stats, g_reload);
     app.shutdown();
 
-    main_logger.info() << "Application terminated successfully";
+    LOG_INFO(main_logger) << "Application terminated successfully";
+    Logger::disable_async();
     return 0;
 
   } catch (const std::exception& e) {
-    main_logger.critical() << "Fatal error: " << e.what();
+    LOG_CRITICAL(main_logger) << "Fatal error: " << e.what();
+    Logger::disable_async();
     return 1;
   }
 }
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "metrics/latency_histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram() : count_(0), sum_us_(0), max_us_(0) {
+  for (auto& bucket : counts_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+std::size_t LatencyHistogram::bucket_index(uint64_t value_us) {
+  if (value_us < kSubBucketCount) {
+    return static_cast<std::size_t>(value_us);
+  }
+
+  std::size_t magnitude = 63 - static_cast<std::size_t>(__builtin_clzll(value_us));
+  if (magnitude >= kMaxMagnitude) {
+    return kBucketCount - 1;
+  }
+
+  const std::size_t shift = magnitude - kSubBucketBits;
+  const std::size_t sub = static_cast<std::size_t>(value_us >> shift) - kSubBucketCount;
+  return kSubBucketCount + shift * kSubBucketCount + sub;
+}
+
+uint64_t LatencyHistogram::bucket_lower_bound(std::size_t index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+
+  const std::size_t shift = (index - kSubBucketCount) / kSubBucketCount;
+  const std::size_t sub = (index - kSubBucketCount) % kSubBucketCount;
+  return static_cast<uint64_t>(kSubBucketCount + sub) << shift;
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(std::size_t index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+
+  const std::size_t shift = (index - kSubBucketCount) / kSubBucketCount;
+  return bucket_lower_bound(index) + (uint64_t{1} << shift) - 1;
+}
+
+void LatencyHistogram::record_us(uint64_t value_us) {
+  counts_[bucket_index(value_us)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_us_.fetch_add(value_us, std::memory_order_relaxed);
+
+  uint64_t current_max = max_us_.load(std::memory_order_relaxed);
+  while (value_us > current_max &&
+         !max_us_.compare_exchange_weak(current_max, value_us, std::memory_order_relaxed)) {
+  }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+  Snapshot snap;
+  for (std::size_t i = 0; i < kBucketCount; i++) {
+    snap.counts[i] = counts_[i].load(std::memory_order_relaxed);
+    snap.count += snap.counts[i];
+  }
+  snap.sum_us = sum_us_.load(std::memory_order_relaxed);
+  snap.max_us = max_us_.load(std::memory_order_relaxed);
+  return snap;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const {
+  if (count == 0) {
+    return 0;
+  }
+
+  p = std::min(std::max(p, 0.0), 100.0);
+  const auto target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100.0 * count)));
+
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBucketCount; i++) {
+    seen += counts[i];
+    if (seen >= target) {
+      return std::min(bucket_upper_bound(i), max_us);
+    }
+  }
+
+  return max_us;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Snapshot::since(const Snapshot& earlier) const {
+  Snapshot delta;
+  for (std::size_t i = 0; i < kBucketCount; i++) {
+    delta.counts[i] = counts[i] - earlier.counts[i];
+    delta.count += delta.counts[i];
+    if (delta.counts[i] > 0) {
+      delta.max_us = std::min(bucket_upper_bound(i), max_us);
+    }
+  }
+  delta.sum_us = sum_us - earlier.sum_us;
+  return delta;
+}
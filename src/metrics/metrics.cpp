@@ -0,0 +1,194 @@
+#include "metrics/metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace {
+
+// Histogram bucket boundaries exported to the scraper, in seconds
+constexpr double kHistogramBuckets[] = {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+                                        0.1,    0.25,  0.5,    1.0,   2.5,  5.0,   10.0};
+
+std::string escape_label_value(const std::string& value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      default:
+        escaped += c;
+    }
+  }
+  return escaped;
+}
+
+void write_labels(std::ostream& out, const MetricLabels& labels, const char* extra_name = nullptr,
+                  const std::string& extra_value = "") {
+  if (labels.empty() && extra_name == nullptr) {
+    return;
+  }
+
+  out << '{';
+  bool first = true;
+  for (const auto& [key, value] : labels) {
+    out << (first ? "" : ",") << key << "=\"" << escape_label_value(value) << '"';
+    first = false;
+  }
+  if (extra_name != nullptr) {
+    out << (first ? "" : ",") << extra_name << "=\"" << extra_value << '"';
+  }
+  out << '}';
+}
+
+std::string format_double(double value) {
+  if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  }
+  std::ostringstream oss;
+  oss << value;
+  return oss.str();
+}
+
+}  // namespace
+
+MetricsRegistry::Registration::Registration(Registration&& other) noexcept
+    : registry_(other.registry_), id_(other.id_) {
+  other.registry_ = nullptr;
+}
+
+MetricsRegistry::Registration& MetricsRegistry::Registration::operator=(Registration&& other) noexcept {
+  if (this != &other) {
+    if (registry_) {
+      registry_->remove(id_);
+    }
+    registry_ = other.registry_;
+    id_ = other.id_;
+    other.registry_ = nullptr;
+  }
+  return *this;
+}
+
+MetricsRegistry::Registration::~Registration() {
+  if (registry_) {
+    registry_->remove(id_);
+  }
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+MetricsRegistry::Registration MetricsRegistry::add_counter(const std::string& name, const std::string& help,
+                                                           const MetricLabels& labels, const Counter& counter) {
+  return add(Type::COUNTER, name, help, labels, &counter);
+}
+
+MetricsRegistry::Registration MetricsRegistry::add_gauge(const std::string& name, const std::string& help,
+                                                         const MetricLabels& labels, const Gauge& gauge) {
+  return add(Type::GAUGE, name, help, labels, &gauge);
+}
+
+MetricsRegistry::Registration MetricsRegistry::add_histogram(const std::string& name, const std::string& help,
+                                                             const MetricLabels& labels,
+                                                             const LatencyHistogram& histogram) {
+  return add(Type::HISTOGRAM, name, help, labels, &histogram);
+}
+
+MetricsRegistry::Registration MetricsRegistry::add(Type type, const std::string& name, const std::string& help,
+                                                   const MetricLabels& labels, const void* metric) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const uint64_t id = next_id_++;
+  entries_.push_back({id, type, name, help, labels, metric});
+  return Registration(this, id);
+}
+
+void MetricsRegistry::remove(uint64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [id](const Entry& e) { return e.id == id; }),
+                 entries_.end());
+}
+
+std::size_t MetricsRegistry::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+std::string MetricsRegistry::render() const {
+  std::vector<const Entry*> sorted;
+  std::ostringstream out;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Samples of one metric family must be contiguous
+  sorted.reserve(entries_.size());
+  for (const auto& entry : entries_) {
+    sorted.push_back(&entry);
+  }
+  std::stable_sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) { return a->name < b->name; });
+
+  const std::string* family = nullptr;
+  for (const Entry* entry : sorted) {
+    if (family == nullptr || *family != entry->name) {
+      family = &entry->name;
+      const char* type = entry->type == Type::COUNTER ? "counter" : entry->type == Type::GAUGE ? "gauge" : "histogram";
+      out << "# TYPE " << entry->name << ' ' << type << '\n';
+      out << "# HELP " << entry->name << ' ' << entry->help << '\n';
+    }
+
+    switch (entry->type) {
+      case Type::COUNTER:
+        out << entry->name << "_total";
+        write_labels(out, entry->labels);
+        out << ' ' << static_cast<const Counter*>(entry->metric)->value() << '\n';
+        break;
+
+      case Type::GAUGE:
+        out << entry->name;
+        write_labels(out, entry->labels);
+        out << ' ' << format_double(static_cast<const Gauge*>(entry->metric)->value()) << '\n';
+        break;
+
+      case Type::HISTOGRAM: {
+        const auto snap = static_cast<const LatencyHistogram*>(entry->metric)->snapshot();
+
+        // Fold the fine-grained buckets into the exported boundaries
+        uint64_t cumulative = 0;
+        std::size_t index = 0;
+        for (double bound : kHistogramBuckets) {
+          const auto bound_us = static_cast<uint64_t>(bound * 1e6);
+          while (index < LatencyHistogram::kBucketCount && LatencyHistogram::bucket_upper_bound(index) <= bound_us) {
+            cumulative += snap.counts[index++];
+          }
+          out << entry->name << "_bucket";
+          write_labels(out, entry->labels, "le", format_double(bound));
+          out << ' ' << cumulative << '\n';
+        }
+        out << entry->name << "_bucket";
+        write_labels(out, entry->labels, "le", "+Inf");
+        out << ' ' << snap.count << '\n';
+
+        out << entry->name << "_sum";
+        write_labels(out, entry->labels);
+        out << ' ' << format_double(snap.sum_us / 1e6) << '\n';
+
+        out << entry->name << "_count";
+        write_labels(out, entry->labels);
+        out << ' ' << snap.count << '\n';
+        break;
+      }
+    }
+  }
+
+  out << "# EOF\n";
+  return out.str();
+}
@@ -0,0 +1,147 @@
+#include "metrics/metrics_server.hpp"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kAcceptPollMs = 200;
+constexpr int kClientTimeoutMs = 1000;
+constexpr std::size_t kMaxRequestSize = 4096;
+
+bool write_all(int fd, const std::string& data) {
+  std::size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t rc = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    sent += static_cast<std::size_t>(rc);
+  }
+  return true;
+}
+
+std::string http_response(const std::string& status, const std::string& content_type, const std::string& body) {
+  return "HTTP/1.0 " + status + "\r\nContent-Type: " + content_type +
+         "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+}
+
+}  // namespace
+
+MetricsServer::MetricsServer(const MetricsConfig& config, MetricsRegistry& registry)
+    : config_(config), registry_(registry), listen_fd_(-1), bound_port_(0), running_(false), logger_("MetricsServer") {}
+
+MetricsServer::~MetricsServer() {
+  stop();
+}
+
+bool MetricsServer::start() {
+  if (running_) {
+    return true;
+  }
+
+  listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    LOG_ERROR(logger_) << "Failed to create metrics socket: " << std::strerror(errno);
+    return false;
+  }
+
+  int reuse = 1;
+  ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(config_.port));
+  if (::inet_pton(AF_INET, config_.bind_address.c_str(), &addr.sin_addr) != 1) {
+    LOG_ERROR(logger_) << "Invalid metrics bind address: " << config_.bind_address;
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+
+  if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listen_fd_, 8) < 0) {
+    LOG_ERROR(logger_) << "Failed to listen on " << config_.bind_address << ":" << config_.port << ": "
+                       << std::strerror(errno);
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+
+  socklen_t len = sizeof(addr);
+  ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+  bound_port_ = ntohs(addr.sin_port);
+
+  running_ = true;
+  thread_ = std::thread(&MetricsServer::serve, this);
+
+  LOG_INFO(logger_) << "Metrics endpoint: http://" << config_.bind_address << ":" << bound_port_ << "/metrics";
+
+  return true;
+}
+
+void MetricsServer::stop() {
+  running_ = false;
+
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  if (listen_fd_ >= 0) {
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+  }
+}
+
+void MetricsServer::serve() {
+  while (running_) {
+    pollfd pfd{listen_fd_, POLLIN, 0};
+    int rc = ::poll(&pfd, 1, kAcceptPollMs);
+    if (rc <= 0) {
+      continue;
+    }
+
+    int client_fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client_fd < 0) {
+      continue;
+    }
+
+    handle_client(client_fd);
+    ::close(client_fd);
+  }
+}
+
+void MetricsServer::handle_client(int client_fd) {
+  std::string request;
+  char buffer[1024];
+
+  // Read until the end of the request headers; the body is never needed
+  while (request.find("\r\n\r\n") == std::string::npos && request.size() < kMaxRequestSize) {
+    pollfd pfd{client_fd, POLLIN, 0};
+    if (::poll(&pfd, 1, kClientTimeoutMs) <= 0) {
+      return;
+    }
+
+    ssize_t n = ::recv(client_fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      return;
+    }
+    request.append(buffer, static_cast<std::size_t>(n));
+  }
+
+  if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET /metrics?", 0) == 0) {
+    write_all(client_fd, http_response("200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8",
+                                       registry_.render()));
+  } else if (request.rfind("GET ", 0) == 0) {
+    write_all(client_fd, http_response("404 Not Found", "text/plain", "Not Found\n"));
+  } else {
+    write_all(client_fd, http_response("405 Method Not Allowed", "text/plain", "Method Not Allowed\n"));
+  }
+}
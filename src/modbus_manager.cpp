@@ -1,23 +1,40 @@
 #include "modbus_manager.hpp"
 
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
-#include <thread>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+
+std::string describe_timeouts(const ModbusConfig& config, const RtuTimeouts& timeouts) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1) << timeouts.response.count() / 1000.0 << "ms response, "
+      << timeouts.byte.count() / 1000.0 << "ms byte (" << (config.timing == "fixed" ? "fixed" : "auto") << ")";
+  return out.str();
+}
+
+}  // namespace
 
 ModbusManagerStats::ModbusManagerStats() : read_success(0), read_errors(0), write_success(0), write_errors(0) {}
 
-ModbusManagerStats::ModbusManagerStats(int rs, int re, int ws, int we)
+ModbusManagerStats::ModbusManagerStats(uint64_t rs, uint64_t re, uint64_t ws, uint64_t we)
     : read_success(rs), read_errors(re), write_success(ws), write_errors(we) {}
 
-ModbusManager::ModbusManager(const ModbusConfig& config)
+ModbusManager::ModbusManager(const ModbusConfig& config, Clock& clock)
     : config_(config),
+      timeouts_(rtu_timeouts(config)),
       ctx_(nullptr),
       connected_(false),
+      clock_(clock),
       logger_("ModbusManager"),
-      read_success_(0),
-      read_errors_(0),
-      write_success_(0),
-      write_errors_(0) {}
+      error_log_limiter_(kErrorLogRate, kErrorLogBurst) {
+  register_bus_metrics();
+}
 
 ModbusManager::~ModbusManager() {
   disconnect();
@@ -30,45 +47,127 @@ bool ModbusManager::connect() {
     return true;
   }
 
+  const bool native = config_.transport == "native";
+  if (!(native ? open_native() : open_libmodbus())) {
+    return false;
+  }
+
+  connected_ = true;
+  connected_gauge_.set(1);
+
+  LOG_INFO(logger_) << "Modbus RTU connected: " << config_.port << " @ " << config_.baudrate << " baud"
+                    << (native ? " (native)" : "") << "  Timeouts: " << describe_timeouts(config_, timeouts_);
+
+  return true;
+}
+
+bool ModbusManager::open_libmodbus() {
   ctx_ = modbus_new_rtu(config_.port.c_str(), config_.baudrate, config_.parity, config_.data_bits, config_.stop_bits);
 
   if (ctx_ == nullptr) {
-    logger_.critical() << "Failed to create Modbus RTU context";
+    LOG_CRITICAL(logger_) << "Failed to create Modbus RTU context";
     return false;
   }
 
   if (modbus_set_slave(ctx_, 1) == -1) {
-    logger_.critical() << "Failed to set Modbus slave";
+    LOG_CRITICAL(logger_) << "Failed to set Modbus slave";
     modbus_free(ctx_);
     ctx_ = nullptr;
     return false;
   }
 
   if (modbus_connect(ctx_) == -1) {
-    logger_.critical() << "Modbus connection failed: " << modbus_strerror(errno);
+    LOG_CRITICAL(logger_) << "Modbus connection failed: " << modbus_strerror(errno);
     modbus_free(ctx_);
     ctx_ = nullptr;
     return false;
   }
 
   // Set timeouts
-  struct timeval response_timeout;
-  response_timeout.tv_sec = 0;
-  response_timeout.tv_usec = config_.response_timeout_ms * 1000;
-  modbus_set_response_timeout(ctx_, response_timeout.tv_sec, response_timeout.tv_usec);
+  apply_timeouts();
+  return true;
+}
 
-  struct timeval byte_timeout;
-  byte_timeout.tv_sec = 0;
-  byte_timeout.tv_usec = config_.byte_timeout_ms * 1000;
-  modbus_set_byte_timeout(ctx_, byte_timeout.tv_sec, byte_timeout.tv_usec);
+bool ModbusManager::open_native() {
+  try {
+    bus_ = std::make_unique<RtuBus>(config_, timeouts_);
+    bus_->open();
+    loop_ = std::make_unique<RtuEventLoop>();
+    loop_->add(*bus_);
+  } catch (const std::system_error& e) {
+    LOG_CRITICAL(logger_) << "Modbus connection failed: " << e.what();
+    loop_.reset();
+    bus_.reset();
+    return false;
+  }
+  return true;
+}
 
-  connected_ = true;
+void ModbusManager::apply_timeouts() {
+  if (bus_) {
+    bus_->set_timeouts(timeouts_);
+    return;
+  }
 
-  logger_.info() << "Modbus RTU connected: " << config_.port << " @ " << config_.baudrate << " baud"
-                 << "  Timeouts: " << config_.response_timeout_ms << "ms response, " << config_.byte_timeout_ms
-                 << "ms byte";
+  // libmodbus wants the microseconds below one second
+  const auto response = timeouts_.response.count();
+  modbus_set_response_timeout(ctx_, static_cast<uint32_t>(response / 1000000),
+                              static_cast<uint32_t>(response % 1000000));
 
-  return true;
+  const auto byte = timeouts_.byte.count();
+  modbus_set_byte_timeout(ctx_, static_cast<uint32_t>(byte / 1000000), static_cast<uint32_t>(byte % 1000000));
+}
+
+void ModbusManager::wait_out_reply(std::chrono::microseconds silence) {
+  // Whatever arrives during the silence belongs to the failed transaction
+  clock_.sleep_for(silence);
+  if (bus_) {
+    bus_->discard_input();
+  } else {
+    modbus_flush(ctx_);
+  }
+}
+
+bool ModbusManager::reconfigure(const ModbusConfig& config) {
+  const bool same_line = config.port == config_.port && config.baudrate == config_.baudrate &&
+                         config.parity == config_.parity && config.data_bits == config_.data_bits &&
+                         config.stop_bits == config_.stop_bits && config.transport == config_.transport;
+
+  if (same_line) {
+    // Timeouts and retries apply to the open port
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+    timeouts_ = rtu_timeouts(config_);
+    if (ctx_ || bus_) {
+      apply_timeouts();
+    }
+    LOG_INFO(logger_) << "Modbus timeouts updated: " << describe_timeouts(config_, timeouts_);
+    return true;
+  }
+
+  disconnect();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+    timeouts_ = rtu_timeouts(config_);
+    register_bus_metrics();
+  }
+  return connect();
+}
+
+void ModbusManager::register_bus_metrics() {
+  auto& registry = MetricsRegistry::instance();
+  const MetricLabels labels = {{"bus", config_.port}};
+
+  // Per-slave series carry the bus label too; they are registered again on first use
+  slave_metrics_.clear();
+  metric_registrations_.clear();
+  metric_registrations_.push_back(
+      registry.add_counter("modbus_retries", "Modbus transaction attempts that were retried", labels, retries_));
+  metric_registrations_.push_back(
+      registry.add_counter("modbus_broadcasts", "Broadcast coil writes sent", labels, broadcasts_));
+  metric_registrations_.push_back(
+      registry.add_gauge("modbus_connected", "Whether the serial bus is open", labels, connected_gauge_));
 }
 
 void ModbusManager::disconnect() {
@@ -79,49 +178,135 @@ void ModbusManager::disconnect() {
     modbus_free(ctx_);
     ctx_ = nullptr;
   }
+  if (bus_) {
+    loop_->remove(*bus_);
+    loop_.reset();
+    bus_.reset();
+  }
 
   connected_ = false;
+  connected_gauge_.set(0);
 }
 
 bool ModbusManager::read_discrete_inputs(int slave_id, int start_addr, std::array<uint8_t, 8>& dest) {
-  return read_with_retry(slave_id, start_addr, dest);
+  return read_with_retry(slave_id, start_addr, static_cast<int>(dest.size()), dest.data(), false);
+}
+
+bool ModbusManager::read_input_bits(int slave_id, int start_addr, int count, uint8_t* dest) {
+  return read_with_retry(slave_id, start_addr, count, dest, false);
+}
+
+bool ModbusManager::read_coils(int slave_id, int start_addr, int count, uint8_t* dest) {
+  return read_with_retry(slave_id, start_addr, count, dest, true);
 }
 
 bool ModbusManager::write_coil(int slave_id, int address, bool state) {
   return write_with_retry(slave_id, address, state);
 }
 
-bool ModbusManager::read_with_retry(int slave_id, int start_addr, std::array<uint8_t, 8>& dest) {
+bool ModbusManager::broadcast_coils(int start_addr, int count, bool state) {
   std::lock_guard<std::mutex> lock(mutex_);
 
-  if (!connected_ || !ctx_) {
+  if (!connected_) {
     return false;
   }
 
-  for (int retry = 0; retry < config_.max_retries; retry++) {
-    modbus_set_slave(ctx_, slave_id);
+  const std::vector<uint8_t> values(static_cast<std::size_t>(std::max(count, 0)), state ? 1 : 0);
+  RtuRequest request;
+  request.unit_id = MODBUS_BROADCAST_ADDRESS;
+  request.function = count == 1 ? ModbusFunction::WRITE_SINGLE_COIL : ModbusFunction::WRITE_MULTIPLE_COILS;
+  request.address = start_addr;
+  request.count = count;
+  request.values = values.data();
+
+  const auto queued = clock_.now();
+  bool sent = transact(request);
+  if (!bus_) {
+    if (!sent && errno == ETIMEDOUT) {
+      // libmodbus waits for a reply to broadcasts as well
+      sent = true;
+    }
+    if (sent) {
+      // libmodbus returns once the frame is queued, and up to 255 bytes take
+      // a while on the wire; the slaves get the response timeout after that.
+      // The native bus holds the line for the same time by itself.
+      const std::size_t bytes = count == 1 ? BusTiming::write_coil_request_size(request.function)
+                                           : BusTiming::write_coils_request_size(count);
+      clock_.sleep_until(queued + BusTiming(config_).frame_time(bytes) + timeouts_.response);
+    }
+  }
+
+  if (!sent) {
+    write_errors_.inc();
+    LOG_ERROR(logger_) << "Modbus broadcast of coils " << start_addr << "-" << (start_addr + count - 1)
+                       << " failed: " << modbus_strerror(errno);
+    return false;
+  }
+  broadcasts_.inc();
+  return true;
+}
+
+void ModbusManager::set_device_profiles(const std::map<int, DeviceProfile>& profiles) {
+  std::map<int, SlaveProtocol> protocols;
+  for (const auto& [slave_id, profile] : profiles) {
+    SlaveProtocol protocol;
+    profile.read_function(protocol.read_function);
+    profile.write_function(protocol.write_function);
+    protocol.inter_frame_delay = std::chrono::milliseconds(profile.inter_frame_delay_ms);
+    protocols.emplace(slave_id, protocol);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  slave_protocols_.swap(protocols);
+}
+
+ModbusManager::SlaveProtocol ModbusManager::protocol(int slave_id) const {
+  auto it = slave_protocols_.find(slave_id);
+  return it == slave_protocols_.end() ? SlaveProtocol() : it->second;
+}
+
+bool ModbusManager::read_with_retry(int slave_id, int start_addr, int count, uint8_t* dest, bool coils) {
+  std::lock_guard<std::mutex> lock(mutex_);
 
-    int rc = modbus_read_input_bits(ctx_, start_addr, dest.size(), dest.data());
-    if (rc != -1) {
-      read_success_++;
+  if (!connected_) {
+    return false;
+  }
+
+  SlaveMetrics& slave = slave_metrics(slave_id);
+  const SlaveProtocol proto = protocol(slave_id);
+
+  for (int retry = 0; retry < config_.max_retries; retry++) {
+    RtuRequest request;
+    request.unit_id = slave_id;
+    // Some modules only expose their inputs as coils
+    request.function = coils ? ModbusFunction::READ_COILS : proto.read_function;
+    request.address = start_addr;
+    request.count = count;
+    request.dest = dest;
+
+    const bool ok = transact(request);
+    if (proto.inter_frame_delay.count() > 0) {
+      clock_.sleep_for(proto.inter_frame_delay);
+    }
+    if (ok) {
+      read_success_.inc();
+      slave.read_success.inc();
       return true;
     }
 
     if (retry < config_.max_retries - 1) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(30));
+      retries_.inc();
+      wait_out_reply(timeouts_.read_retry_delay);
     }
   }
 
-  read_errors_++;
+  const int error = errno;
+  read_errors_.inc();
+  slave.read_errors.inc();
 
-  // Log errors periodically (not every time to avoid spam)
-  static auto last_error_log = std::chrono::steady_clock::now();
-  auto now = std::chrono::steady_clock::now();
-  if (std::chrono::duration_cast<std::chrono::seconds>(now - last_error_log).count() > 10) {
-    logger_.error() << "Modbus read error: slave " << slave_id << " addr " << start_addr << " count " << dest.size()
-                    << " (after " << config_.max_retries << " retries): " << modbus_strerror(errno);
-    last_error_log = now;
-  }
+  LOG_LIMITED(logger_, LogLevel::LEVEL_ERROR, error_log_limiter_, slave_id)
+      << "Modbus read error: slave " << slave_id << " addr " << start_addr << " count " << count << " (after "
+      << config_.max_retries << " retries): " << modbus_strerror(error);
 
   return false;
 }
@@ -129,41 +314,112 @@ bool ModbusManager::read_with_retry(int slave_id, int start_addr, std::array<uin
 bool ModbusManager::write_with_retry(int slave_id, int address, bool state) {
   std::lock_guard<std::mutex> lock(mutex_);
 
-  if (!connected_ || !ctx_) {
+  if (!connected_) {
     return false;
   }
 
-  for (int retry = 0; retry < config_.max_retries; retry++) {
-    modbus_set_slave(ctx_, slave_id);
+  SlaveMetrics& slave = slave_metrics(slave_id);
+  const SlaveProtocol proto = protocol(slave_id);
+  const uint8_t value = state ? 1 : 0;
 
-    int rc = modbus_write_bit(ctx_, address, state ? 1 : 0);
-    if (rc != -1) {
-      write_success_++;
+  for (int retry = 0; retry < config_.max_retries; retry++) {
+    RtuRequest request;
+    request.unit_id = slave_id;
+    // FC15 with a single coil for modules without FC05
+    request.function = proto.write_function;
+    request.address = address;
+    request.count = 1;
+    request.values = &value;
+
+    const bool ok = transact(request);
+    if (proto.inter_frame_delay.count() > 0) {
+      clock_.sleep_for(proto.inter_frame_delay);
+    }
+    if (ok) {
+      write_success_.inc();
+      slave.write_success.inc();
       return true;
     }
 
     if (retry < config_.max_retries - 1) {
-      logger_.warning() << "Modbus write error: slave " << slave_id << " addr " << address << " (attempt "
-                        << (retry + 1) << "/" << config_.max_retries << "): " << modbus_strerror(errno);
-      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      retries_.inc();
+      LOG_LIMITED(logger_, LogLevel::LEVEL_WARNING, error_log_limiter_, slave_id)
+          << "Modbus write error: slave " << slave_id << " addr " << address << " (attempt " << (retry + 1) << "/"
+          << config_.max_retries << "): " << modbus_strerror(errno);
+      wait_out_reply(timeouts_.write_retry_delay);
     }
   }
 
-  write_errors_++;
-  logger_.error() << "Failed to write coil slave " << slave_id << " addr " << address << " after "
-                  << config_.max_retries << " attempts!";
+  write_errors_.inc();
+  slave.write_errors.inc();
+  LOG_LIMITED(logger_, LogLevel::LEVEL_ERROR, error_log_limiter_, slave_id)
+      << "Failed to write coil slave " << slave_id << " addr " << address << " after " << config_.max_retries
+      << " attempts!";
 
   return false;
 }
 
-std::unique_ptr<ModbusManagerStats> ModbusManager::get_stats() const {
-  return std::make_unique<ModbusManagerStats>(read_success_.load(), read_errors_.load(), write_success_.load(),
-                                              write_errors_.load());
+bool ModbusManager::transact(const RtuRequest& request) {
+  if (bus_) {
+    int error = EBADF;
+    try {
+      if (bus_->submit(request, [&error](int result) { error = result; })) {
+        loop_->run_until_idle(*bus_);
+      }
+    } catch (const std::invalid_argument&) {
+      error = EMBMDATA;  // what libmodbus reports for oversized requests
+    }
+    errno = error;
+    return error == 0;
+  }
+
+  modbus_set_slave(ctx_, request.unit_id);
+  int rc = -1;
+  switch (request.function) {
+    case ModbusFunction::READ_COILS:
+      rc = modbus_read_bits(ctx_, request.address, request.count, request.dest);
+      break;
+    case ModbusFunction::READ_DISCRETE_INPUTS:
+      rc = modbus_read_input_bits(ctx_, request.address, request.count, request.dest);
+      break;
+    case ModbusFunction::WRITE_SINGLE_COIL:
+      rc = modbus_write_bit(ctx_, request.address, request.values[0]);
+      break;
+    case ModbusFunction::WRITE_MULTIPLE_COILS:
+      rc = modbus_write_bits(ctx_, request.address, request.count, request.values);
+      break;
+  }
+  return rc != -1;
 }
 
-void ModbusManager::reset_stats() {
-  read_success_ = 0;
-  read_errors_ = 0;
-  write_success_ = 0;
-  write_errors_ = 0;
-}
\ No newline at end of file
+ModbusManagerStats ModbusManager::get_stats() const {
+  return ModbusManagerStats(read_success_.value(), read_errors_.value(), write_success_.value(),
+                            write_errors_.value());
+}
+
+ModbusManager::SlaveMetrics& ModbusManager::slave_metrics(int slave_id) {
+  auto it = slave_metrics_.find(slave_id);
+  if (it != slave_metrics_.end()) {
+    return *it->second;
+  }
+
+  // First transaction with this slave: register its counters once
+  auto metrics = std::make_unique<SlaveMetrics>();
+  auto& registry = MetricsRegistry::instance();
+  const std::string slave = std::to_string(slave_id);
+
+  metrics->registrations.push_back(registry.add_counter("modbus_reads", "Discrete input reads",
+                                                        {{"bus", config_.port}, {"slave", slave}, {"result", "success"}},
+                                                        metrics->read_success));
+  metrics->registrations.push_back(registry.add_counter("modbus_reads", "Discrete input reads",
+                                                        {{"bus", config_.port}, {"slave", slave}, {"result", "error"}},
+                                                        metrics->read_errors));
+  metrics->registrations.push_back(registry.add_counter("modbus_writes", "Coil writes",
+                                                        {{"bus", config_.port}, {"slave", slave}, {"result", "success"}},
+                                                        metrics->write_success));
+  metrics->registrations.push_back(registry.add_counter("modbus_writes", "Coil writes",
+                                                        {{"bus", config_.port}, {"slave", slave}, {"result", "error"}},
+                                                        metrics->write_errors));
+
+  return *slave_metrics_.emplace(slave_id, std::move(metrics)).first->second;
+}
@@ -1,28 +1,37 @@
 #include "mqtt_manager.hpp"
 
-MqttManagerStats::MqttManagerStats(int ps, int pe, int mr)
+#include <algorithm>
+
+MqttManagerStats::MqttManagerStats() : publish_success(0), publish_errors(0), messages_received(0) {}
+
+MqttManagerStats::MqttManagerStats(uint64_t ps, uint64_t pe, uint64_t mr)
     : publish_success(ps), publish_errors(pe), messages_received(mr) {}
 
 MqttManager::MqttManager(const MqttConfig& config)
-    : config_(config), publish_success_(0), publish_errors_(0), messages_received_(0), logger_("MqttManager") {
+    : config_(config), logger_("MqttManager"), error_log_limiter_(kErrorLogRate, kErrorLogBurst) {
 
   client_ = std::make_unique<mqtt::async_client>(config_.broker_address, config_.client_id);
 
   client_->set_callback(*this);
 
-  logger_.debug() << "MqttManager created for broker: " << config_.broker_address;
+  register_broker_metrics();
+
+  LOG_DEBUG(logger_) << "MqttManager created for broker: " << config_.broker_address;
 }
 
 MqttManager::~MqttManager() {
-  logger_.debug() << "MqttManager destructor called";
+  LOG_DEBUG(logger_) << "MqttManager destructor called";
   disconnect();
 }
 
 bool MqttManager::connect() {
-  std::lock_guard<std::mutex> lock(mutex_);
+  mqtt::async_client* client = nullptr;
+  mqtt::connect_options connOpts;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    client = client_.get();
 
-  try {
-    mqtt::connect_options connOpts;
     connOpts.set_clean_session(true);
     connOpts.set_automatic_reconnect(true);
     connOpts.set_keep_alive_interval(config_.keep_alive_sec);
@@ -30,43 +39,136 @@ bool MqttManager::connect() {
     if (!config_.username.empty()) {
       connOpts.set_user_name(config_.username);
       connOpts.set_password(config_.password);
-      logger_.debug() << "Using authentication for user: " << config_.username;
+      LOG_DEBUG(logger_) << "Using authentication for user: " << config_.username;
     }
 
     mqtt::message willmsg("modbus/poller/status", "offline", config_.qos, config_.retained);
     mqtt::will_options will(willmsg);
     connOpts.set_will(will);
+  }
 
-    logger_.info() << "Connecting to MQTT broker: " << config_.broker_address;
+  // Not under mutex_: publishes go to the outbox while this waits
+  try {
+    LOG_INFO(logger_) << "Connecting to MQTT broker: " << config_.broker_address;
 
-    auto conntok = client_->connect(connOpts);
+    connecting_ = true;
+
+    auto conntok = client->connect(connOpts);
     if (!conntok->wait_for(std::chrono::milliseconds(5000))) {
-      logger_.error() << "MQTT connection timeout";
+      // Should it still come up, connected() treats it as a reconnect
+      connecting_ = false;
+      LOG_ERROR(logger_) << "MQTT connection timeout";
       return false;
     }
+  } catch (const mqtt::exception& exc) {
+    connecting_ = false;
+    LOG_ERROR(logger_) << "MQTT connection error: " << exc.what();
+    return false;
+  }
 
-    logger_.info() << "MQTT connected successfully";
+  LOG_INFO(logger_) << "MQTT connected successfully";
+  connected_gauge_.set(1);
+  connected_once_ = true;
 
+  try {
     // Publish online status
+    std::lock_guard<std::mutex> lock(mutex_);
     auto msg = mqtt::make_message("modbus/poller/status", "online");
     msg->set_qos(config_.qos);
     msg->set_retained(config_.retained);
     client_->publish(msg);
+  } catch (const mqtt::exception& exc) {
+    LOG_ERROR(logger_) << "MQTT status publish error: " << exc.what();
+  }
 
-    return true;
+  // Clean session: the broker does not know our subscriptions yet
+  return restore_session();
+}
 
-  } catch (const mqtt::exception& exc) {
-    logger_.error() << "MQTT connection error: " << exc.what();
-    return false;
+void MqttManager::connect_in_background() {
+  stop_connector();
+
+  {
+    std::lock_guard<std::mutex> lock(connector_mutex_);
+    connector_stop_ = false;
+  }
+  connector_ = std::thread(&MqttManager::connector_loop, this);
+}
+
+void MqttManager::connector_loop() {
+  auto delay = kReconnectMinDelay;
+
+  std::unique_lock<std::mutex> lock(connector_mutex_);
+  while (!connector_stop_) {
+    lock.unlock();
+
+    // After the first session paho reconnects by itself; this only has to
+    // resubscribe and flush the outbox when it did
+    bool up = is_connected();
+    if (!up && !connected_once_) {
+      up = connect();
+      delay = up ? kReconnectMinDelay : std::min(delay * 2, kReconnectMaxDelay);
+      if (!up) {
+        LOG_INFO(logger_) << "MQTT broker not reachable, retrying in " << delay.count() << "ms";
+      }
+    } else if (up && session_lost_.exchange(false)) {
+      restore_session();
+    }
+
+    lock.lock();
+    connector_cv_.wait_for(lock, up || connected_once_ ? kReconnectMaxDelay : delay,
+                           [this] { return connector_stop_ || session_lost_; });
+  }
+}
+
+void MqttManager::stop_connector() {
+  {
+    std::lock_guard<std::mutex> lock(connector_mutex_);
+    connector_stop_ = true;
+  }
+  connector_cv_.notify_all();
+
+  if (connector_.joinable()) {
+    connector_.join();
   }
 }
 
+bool MqttManager::restore_session() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  bool ok = true;
+  for (const auto& topic : subscriptions_) {
+    ok = subscribe_locked(topic) && ok;
+  }
+
+  // Under the same lock as the flush, so a newer direct publish cannot be
+  // overtaken by its stale outbox entry
+  if (!outbox_.empty()) {
+    std::vector<MqttMessage> messages;
+    messages.reserve(outbox_.size());
+    for (auto& [topic, payload] : outbox_) {
+      messages.push_back({topic, std::move(payload)});
+    }
+    outbox_.clear();
+    outbox_depth_.set(0);
+
+    const std::size_t published = publish_batch_locked(messages, true);
+    LOG_INFO(logger_) << "Flushed outbox: " << published << "/" << messages.size() << " messages";
+    ok = ok && published == messages.size();
+  }
+
+  return ok;
+}
+
 void MqttManager::disconnect() {
+  stop_connector();
+
   std::lock_guard<std::mutex> lock(mutex_);
+  connected_once_ = false;
 
   if (client_ && client_->is_connected()) {
     try {
-      logger_.info() << "Disconnecting from MQTT broker";
+      LOG_INFO(logger_) << "Disconnecting from MQTT broker";
 
       auto msg = mqtt::make_message("modbus/poller/status", "offline");
       msg->set_qos(config_.qos);
@@ -77,9 +179,10 @@ void MqttManager::disconnect() {
 
       client_->disconnect()->wait_for(std::chrono::milliseconds(1000));
 
-      logger_.info() << "MQTT disconnected";
+      LOG_INFO(logger_) << "MQTT disconnected";
+      connected_gauge_.set(0);
     } catch (const mqtt::exception& exc) {
-      logger_.error() << "MQTT disconnect error: " << exc.what();
+      LOG_ERROR(logger_) << "MQTT disconnect error: " << exc.what();
     }
   }
 }
@@ -89,26 +192,133 @@ bool MqttManager::is_connected() const {
   return client_ && client_->is_connected();
 }
 
+bool MqttManager::reconfigure(const MqttConfig& config) {
+  const bool background = connector_.joinable();
+  disconnect();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const bool same_client =
+        config.broker_address == config_.broker_address && config.client_id == config_.client_id;
+    config_ = config;
+
+    if (!same_client) {
+      client_ = std::make_unique<mqtt::async_client>(config_.broker_address, config_.client_id);
+      client_->set_callback(*this);
+      register_broker_metrics();
+    }
+  }
+
+  if (background) {
+    connect_in_background();
+    return true;
+  }
+  return connect();
+}
+
+void MqttManager::register_broker_metrics() {
+  auto& registry = MetricsRegistry::instance();
+  const MetricLabels labels = {{"broker", config_.broker_address}};
+
+  metric_registrations_.clear();
+  metric_registrations_.push_back(registry.add_counter("mqtt_messages_received", "Messages received from the broker",
+                                                       labels, messages_received_));
+  metric_registrations_.push_back(
+      registry.add_gauge("mqtt_connected", "Whether the broker connection is up", labels, connected_gauge_));
+  metric_registrations_.push_back(
+      registry.add_gauge("mqtt_outbox_depth", "Retained messages waiting for the broker", labels, outbox_depth_));
+  metric_registrations_.push_back(registry.add_counter(
+      "mqtt_outbox_dropped", "Retained messages dropped because the outbox was full", labels, outbox_dropped_));
+}
+
+bool MqttManager::unsubscribe(const std::string& topic) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  subscriptions_.erase(topic);
+
+  if (!client_->is_connected()) {
+    return true;
+  }
+
+  try {
+    if (client_->unsubscribe(topic)->wait_for(std::chrono::milliseconds(2000))) {
+      LOG_INFO(logger_) << "Unsubscribed from: " << topic;
+      return true;
+    }
+    LOG_ERROR(logger_) << "Unsubscribe timeout for topic: " << topic;
+    return false;
+  } catch (const mqtt::exception& exc) {
+    LOG_ERROR(logger_) << "Unsubscribe error: " << exc.what();
+    return false;
+  }
+}
+
 bool MqttManager::subscribe(const std::string& topic) {
   std::lock_guard<std::mutex> lock(mutex_);
+  subscriptions_.insert(topic);
 
+  if (!client_->is_connected()) {
+    LOG_DEBUG(logger_) << "Subscribing to " << topic << " once connected";
+    return true;
+  }
+  return subscribe_locked(topic);
+}
+
+bool MqttManager::subscribe_locked(const std::string& topic) {
   try {
     auto subtok = client_->subscribe(topic, config_.qos);
     if (subtok->wait_for(std::chrono::milliseconds(2000))) {
-      logger_.info() << "Subscribed to: " << topic;
+      LOG_INFO(logger_) << "Subscribed to: " << topic;
       return true;
     } else {
-      logger_.error() << "Subscribe timeout for topic: " << topic;
+      LOG_ERROR(logger_) << "Subscribe timeout for topic: " << topic;
       return false;
     }
   } catch (const mqtt::exception& exc) {
-    logger_.error() << "Subscribe error: " << exc.what();
+    LOG_ERROR(logger_) << "Subscribe error: " << exc.what();
+    return false;
+  }
+}
+
+bool MqttManager::queue_offline(const std::string& topic, const std::string& payload, bool retained) {
+  // Only retained state is worth replaying; anything else is stale by then
+  if (!retained) {
+    publish_errors_.inc();
+    topic_metrics(topic).publish_errors.inc();
     return false;
   }
+
+  auto it = outbox_.find(topic);
+  if (it != outbox_.end()) {
+    it->second = payload;
+    return true;
+  }
+
+  if (outbox_.size() >= kOutboxLimit) {
+    outbox_dropped_.inc();
+    LOG_LIMITED(logger_, LogLevel::LEVEL_WARNING, error_log_limiter_, 0)
+        << "MQTT outbox full (" << kOutboxLimit << " topics), dropping " << topic;
+    return false;
+  }
+
+  outbox_.emplace(topic, payload);
+  outbox_depth_.set(static_cast<double>(outbox_.size()));
+  return true;
 }
 
 bool MqttManager::publish(const std::string& topic, const std::string& payload, bool retained) {
   std::lock_guard<std::mutex> lock(mutex_);
+  return publish_locked(topic, payload, retained);
+}
+
+bool MqttManager::publish_locked(const std::string& topic, const std::string& payload, bool retained) {
+  if (!client_->is_connected()) {
+    return queue_offline(topic, payload, retained);
+  }
+
+  // Newer than anything still waiting for the flush
+  if (!outbox_.empty() && outbox_.erase(topic) > 0) {
+    outbox_depth_.set(static_cast<double>(outbox_.size()));
+  }
 
   try {
     auto msg = mqtt::make_message(topic, payload);
@@ -118,29 +328,99 @@ bool MqttManager::publish(const std::string& topic, const std::string& payload,
     auto tok = client_->publish(msg);
 
     if (tok->wait_for(std::chrono::milliseconds(config_.operation_timeout_ms))) {
-      publish_success_++;
-      logger_.debug() << "Published to " << topic << ": " << payload;
+      publish_success_.inc();
+      topic_metrics(topic).publish_success.inc();
+      LOG_DEBUG(logger_) << "Published to " << topic << ": " << payload;
       return true;
     } else {
-      publish_errors_++;
-      logger_.warning() << "Publish timeout for topic: " << topic;
+      publish_errors_.inc();
+      topic_metrics(topic).publish_errors.inc();
+      LOG_LIMITED(logger_, LogLevel::LEVEL_WARNING, error_log_limiter_, 0) << "Publish timeout for topic: " << topic;
       return false;
     }
 
   } catch (const mqtt::exception& exc) {
-    publish_errors_++;
-    logger_.error() << "Publish error (" << topic << "): " << exc.what();
+    publish_errors_.inc();
+    topic_metrics(topic).publish_errors.inc();
+    LOG_LIMITED(logger_, LogLevel::LEVEL_ERROR, error_log_limiter_, 0)
+        << "Publish error (" << topic << "): " << exc.what();
     return false;
   }
 }
 
+std::size_t MqttManager::publish_batch(const std::vector<MqttMessage>& messages, bool retained) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return publish_batch_locked(messages, retained);
+}
+
+std::size_t MqttManager::publish_batch_locked(const std::vector<MqttMessage>& messages, bool retained) {
+  if (!client_->is_connected()) {
+    std::size_t queued = 0;
+    for (const auto& message : messages) {
+      if (queue_offline(message.topic, message.payload, retained)) {
+        queued++;
+      }
+    }
+    LOG_DEBUG(logger_) << "Queued batch while offline: " << queued << "/" << messages.size();
+    return queued;
+  }
+
+  std::vector<std::pair<const MqttMessage*, mqtt::delivery_token_ptr>> pending;
+  pending.reserve(messages.size());
+  std::size_t published = 0;
+
+  for (const auto& message : messages) {
+    try {
+      auto msg = mqtt::make_message(message.topic, message.payload);
+      msg->set_qos(config_.qos);
+      msg->set_retained(retained);
+      pending.emplace_back(&message, client_->publish(msg));
+    } catch (const mqtt::exception& exc) {
+      publish_errors_.inc();
+      topic_metrics(message.topic).publish_errors.inc();
+      LOG_LIMITED(logger_, LogLevel::LEVEL_ERROR, error_log_limiter_, 0)
+          << "Publish error (" << message.topic << "): " << exc.what();
+    }
+  }
+
+  // One timeout for the whole batch, not one per message
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config_.operation_timeout_ms);
+  for (const auto& [message, tok] : pending) {
+    bool delivered = false;
+    try {
+      const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      delivered = tok->wait_for(std::max(remaining, std::chrono::milliseconds(0)));
+    } catch (const mqtt::exception& exc) {
+      LOG_LIMITED(logger_, LogLevel::LEVEL_ERROR, error_log_limiter_, 0)
+          << "Publish error (" << message->topic << "): " << exc.what();
+    }
+
+    if (delivered) {
+      published++;
+      publish_success_.inc();
+      topic_metrics(message->topic).publish_success.inc();
+    } else {
+      publish_errors_.inc();
+      topic_metrics(message->topic).publish_errors.inc();
+    }
+  }
+
+  LOG_DEBUG(logger_) << "Published batch: " << published << "/" << messages.size();
+  if (published < pending.size()) {
+    LOG_LIMITED(logger_, LogLevel::LEVEL_WARNING, error_log_limiter_, 0)
+        << "Publish timeout for " << (pending.size() - published) << " of " << messages.size() << " batched messages";
+  }
+  return published;
+}
+
 void MqttManager::set_message_callback(MqttMessageCallback callback) {
   message_callback_ = callback;
 }
 
 void MqttManager::message_arrived(mqtt::const_message_ptr msg) {
-  messages_received_++;
-  logger_.debug() << "Message received on " << msg->get_topic() << ": " << msg->to_string();
+  messages_received_.inc();
+  LOG_DEBUG(logger_) << "Message received on " << msg->get_topic() << ": " << msg->to_string();
 
   if (message_callback_) {
     message_callback_(msg->get_topic(), msg->to_string());
@@ -148,20 +428,45 @@ void MqttManager::message_arrived(mqtt::const_message_ptr msg) {
 }
 
 void MqttManager::connection_lost(const std::string& cause) {
-  logger_.warning() << "MQTT connection lost: " << cause;
-  logger_.info() << "Auto-reconnect should restore connection...";
+  connected_gauge_.set(0);
+  LOG_WARNING(logger_) << "MQTT connection lost: " << cause;
+  LOG_INFO(logger_) << "Auto-reconnect should restore connection...";
 }
 
 void MqttManager::connected(const std::string&) {
-  logger_.info() << "MQTT reconnected successfully";
+  connected_gauge_.set(1);
+  if (connecting_.exchange(false)) {
+    return;  // connect() restores the session itself
+  }
+  LOG_INFO(logger_) << "MQTT reconnected successfully";
+
+  // Runs on paho's thread, which must not wait on tokens; the connector
+  // resubscribes and flushes the outbox
+  {
+    std::lock_guard<std::mutex> lock(connector_mutex_);
+    session_lost_ = true;
+  }
+  connector_cv_.notify_all();
 }
 
-std::unique_ptr<MqttManagerStats> MqttManager::get_stats() const {
-  return std::make_unique<MqttManagerStats>(publish_success_.load(), publish_errors_.load(), messages_received_.load());
+MqttManagerStats MqttManager::get_stats() const {
+  return MqttManagerStats(publish_success_.value(), publish_errors_.value(), messages_received_.value());
 }
 
-void MqttManager::reset_stats() {
-  publish_success_ = 0;
-  publish_errors_ = 0;
-  messages_received_ = 0;
-}
\ No newline at end of file
+MqttManager::TopicMetrics& MqttManager::topic_metrics(const std::string& topic) {
+  auto it = topic_metrics_.find(topic);
+  if (it != topic_metrics_.end()) {
+    return *it->second;
+  }
+
+  // First publish on this topic: register its counters once
+  auto metrics = std::make_unique<TopicMetrics>();
+  auto& registry = MetricsRegistry::instance();
+
+  metrics->registrations.push_back(registry.add_counter(
+      "mqtt_publishes", "Messages published", {{"topic", topic}, {"result", "success"}}, metrics->publish_success));
+  metrics->registrations.push_back(registry.add_counter(
+      "mqtt_publishes", "Messages published", {{"topic", topic}, {"result", "error"}}, metrics->publish_errors));
+
+  return *topic_metrics_.emplace(topic, std::move(metrics)).first->second;
+}
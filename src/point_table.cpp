@@ -0,0 +1,305 @@
+#include "point_table.hpp"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+constexpr int kMaxSlaveId = 247;
+constexpr int kMaxAddress = 65535;
+constexpr std::size_t kMaxReadsPerSlave = 32;  // beyond this one slave dominates the poll cycle
+constexpr int kMaxWriteCoils = 1968;           // FC15 limit
+
+class Checker {
+ public:
+  explicit Checker(std::vector<ConfigDiagnostic>& diagnostics) : diagnostics_(diagnostics) {}
+
+  void error(const std::string& path, const std::string& message) {
+    diagnostics_.push_back({ConfigDiagnostic::Severity::ERROR, path, message});
+  }
+
+  void warning(const std::string& path, const std::string& message) {
+    diagnostics_.push_back({ConfigDiagnostic::Severity::WARNING, path, message});
+  }
+
+  void check_name(const std::string& path, const std::string& name, const char* kind) {
+    if (name.empty()) {
+      error(path, std::string(kind) + " name must not be empty");
+      return;
+    }
+    auto [it, inserted] = names_[kind].emplace(name, path);
+    if (!inserted) {
+      error(path, std::string("duplicate ") + kind + " name '" + name + "' (first at " + it->second + ")");
+    }
+  }
+
+  void check_address(const std::string& path, int address) {
+    if (address < 0 || address > kMaxAddress) {
+      error(path, "address " + std::to_string(address) + " is outside 0-" + std::to_string(kMaxAddress));
+    }
+  }
+
+  // Topics the gateway publishes to must be concrete and owned by one point
+  void check_published_topic(const std::string& path, const std::string& topic) {
+    if (!check_topic(path, topic)) {
+      return;
+    }
+    auto [it, inserted] = published_.emplace(topic, path);
+    if (!inserted) {
+      error(path, "topic '" + topic + "' is also published by " + it->second);
+    }
+  }
+
+  bool check_topic(const std::string& path, const std::string& topic) {
+    if (topic.empty()) {
+      error(path, "topic must not be empty");
+      return false;
+    }
+    if (topic.find_first_of("+#") != std::string::npos) {
+      error(path, "topic '" + topic + "' contains an MQTT wildcard");
+      return false;
+    }
+    return true;
+  }
+
+  const std::string* publisher(const std::string& topic) const {
+    auto it = published_.find(topic);
+    return it == published_.end() ? nullptr : &it->second;
+  }
+
+ private:
+  std::vector<ConfigDiagnostic>& diagnostics_;
+  std::map<std::string, std::unordered_map<std::string, std::string>> names_;  // kind -> name -> path
+  std::unordered_map<std::string, std::string> published_;                    // topic -> path
+};
+
+std::string source_path(const std::vector<std::string>& sources, const char* list, std::size_t index) {
+  return index < sources.size() ? sources[index] : std::string("/") + list + "/" + std::to_string(index);
+}
+
+}  // namespace
+
+PointTable compile_points(const std::vector<DigitalInput>& inputs, const std::vector<Relay>& relays,
+                          std::vector<ConfigDiagnostic>& diagnostics, const PointSources& sources,
+                          const DeviceCatalog& catalog, const std::vector<BroadcastGroup>& groups) {
+  Checker check(diagnostics);
+  auto input_path = [&sources](std::size_t i) { return source_path(sources.inputs, "digital_inputs", i); };
+  auto relay_path = [&sources](std::size_t i) { return source_path(sources.relays, "relays", i); };
+
+  PointTable table;
+  table.inputs = inputs;
+  table.relays = relays;
+
+  // Inputs: group by slave, one bit table per slave
+  std::map<int, std::vector<std::size_t>> slave_inputs;
+  std::map<std::pair<int, int>, std::string> read_bits;
+
+  for (std::size_t i = 0; i < inputs.size(); i++) {
+    const DigitalInput& input = inputs[i];
+    const std::string path = input_path(i);
+
+    check.check_name(path + "/name", input.name, "input");
+    check.check_published_topic(path + "/mqtt_topic", input.mqtt_topic);
+
+    if (input.slave_id < 1 || input.slave_id > kMaxSlaveId) {
+      check.error(path + "/slave_id", "slave id " + std::to_string(input.slave_id) + " is outside 1-" +
+                                          std::to_string(kMaxSlaveId) + " and cannot be read");
+    }
+    check.check_address(path + "/address", input.address);
+
+    const DeviceProfile& profile = catalog.profile_for(input.slave_id);
+    table.profiles.emplace(input.slave_id, profile);
+    ModbusFunction function;
+    if (!profile.read_function(function) || (profile.inputs == 0 && profile.coils > 0)) {
+      check.error(path + "/slave_id", "device profile '" + profile.name + "' of slave " +
+                                          std::to_string(input.slave_id) + " has no inputs");
+    }
+    if (profile.inputs > 0 && input.address >= profile.inputs) {
+      check.error(path + "/address", "address " + std::to_string(input.address) + " is beyond the " +
+                                         std::to_string(profile.inputs) + " inputs of device profile '" +
+                                         profile.name + "'");
+    }
+
+    auto [bit, inserted] = read_bits.emplace(std::make_pair(input.slave_id, input.address), path);
+    if (!inserted) {
+      check.warning(path + "/address", "same discrete input as " + bit->second);
+    }
+
+    if (input.address >= 0) {
+      slave_inputs[input.slave_id].push_back(i);
+    }
+  }
+
+  for (const auto& [slave_id, indices] : slave_inputs) {
+    const DeviceProfile& profile = table.profiles.at(slave_id);
+
+    PointTable::Slave slave;
+    slave.slave_id = slave_id;
+    slave.read_bits = static_cast<std::size_t>(std::max(profile.max_read_bits, 1));
+
+    std::size_t highest = 0;
+    std::size_t highest_index = indices.front();
+    for (std::size_t index : indices) {
+      const auto address = static_cast<std::size_t>(inputs[index].address);
+      if (address >= highest) {
+        highest = address;
+        highest_index = index;
+      }
+    }
+
+    // Images are read in whole blocks starting at address 0, but not past the module's last input
+    slave.bit_count = (highest / PointTable::kReadBlockBits + 1) * PointTable::kReadBlockBits;
+    if (profile.inputs > 0) {
+      slave.bit_count = std::max(highest + 1, std::min(slave.bit_count, static_cast<std::size_t>(profile.inputs)));
+    }
+    slave.bit_inputs.resize(slave.bit_count);
+    for (std::size_t index : indices) {
+      slave.bit_inputs[static_cast<std::size_t>(inputs[index].address)].push_back(index);
+    }
+
+    const std::size_t reads = (slave.bit_count + slave.read_bits - 1) / slave.read_bits;
+    if (reads > kMaxReadsPerSlave) {
+      check.warning(input_path(highest_index) + "/address",
+                    "address " + std::to_string(highest) + " makes slave " + std::to_string(slave_id) + " take " +
+                        std::to_string(reads) + " reads per poll cycle");
+    }
+
+    table.slaves.push_back(std::move(slave));
+  }
+
+  // Relays: state topics first so command topics can be checked against every published topic
+  std::map<std::pair<int, int>, std::string> coils;
+
+  for (std::size_t i = 0; i < relays.size(); i++) {
+    const Relay& relay = relays[i];
+    const std::string path = relay_path(i);
+
+    check.check_name(path + "/name", relay.name, "relay");
+    check.check_published_topic(path + "/mqtt_state_topic", relay.mqtt_state_topic);
+
+    if (relay.slave_id == 0) {
+      check.warning(path + "/slave_id", "slave id 0 is the broadcast address; writes are not acknowledged");
+    } else if (relay.slave_id < 0 || relay.slave_id > kMaxSlaveId) {
+      check.error(path + "/slave_id",
+                  "slave id " + std::to_string(relay.slave_id) + " is outside 0-" + std::to_string(kMaxSlaveId));
+    }
+    check.check_address(path + "/address", relay.address);
+
+    const DeviceProfile& profile = catalog.profile_for(relay.slave_id);
+    table.profiles.emplace(relay.slave_id, profile);
+    ModbusFunction function;
+    if (!profile.write_function(function) || (profile.coils == 0 && profile.inputs > 0)) {
+      check.error(path + "/slave_id", "device profile '" + profile.name + "' of slave " +
+                                          std::to_string(relay.slave_id) + " has no coils");
+    }
+    if (profile.coils > 0 && relay.address >= profile.coils) {
+      check.error(path + "/address", "address " + std::to_string(relay.address) + " is beyond the " +
+                                         std::to_string(profile.coils) + " coils of device profile '" +
+                                         profile.name + "'");
+    }
+
+    auto [coil, inserted] = coils.emplace(std::make_pair(relay.slave_id, relay.address), path);
+    if (!inserted) {
+      check.warning(path + "/address", "same coil as " + coil->second);
+    }
+  }
+
+  std::unordered_map<std::string, std::string> route_paths;  // topic -> path of the relay it routes to
+
+  for (std::size_t i = 0; i < relays.size(); i++) {
+    const Relay& relay = relays[i];
+    const std::string path = relay_path(i);
+
+    const std::string legacy_topic = "modbus/relay/" + relay.name + "/set";
+    auto [legacy, added] = table.command_routes.emplace(legacy_topic, i);
+    if (added) {
+      route_paths.emplace(legacy_topic, path);
+    } else if (legacy->second != i && relays[legacy->second].name != relay.name) {
+      check.error(path + "/name", "command topic '" + legacy_topic + "' already controls " + route_paths[legacy_topic]);
+    }
+
+    if (relay.mqtt_command_topic.empty() ||
+        !check.check_topic(path + "/mqtt_command_topic", relay.mqtt_command_topic)) {
+      continue;
+    }
+
+    if (const std::string* publisher = check.publisher(relay.mqtt_command_topic)) {
+      check.error(path + "/mqtt_command_topic",
+                  "command topic '" + relay.mqtt_command_topic + "' is published by " + *publisher);
+    }
+
+    auto [route, inserted] = table.command_routes.emplace(relay.mqtt_command_topic, i);
+    if (inserted) {
+      route_paths.emplace(relay.mqtt_command_topic, path);
+    } else if (route->second != i && relays[route->second].name != relay.name) {
+      check.error(path + "/mqtt_command_topic",
+                  "command topic '" + relay.mqtt_command_topic + "' already controls " + route_paths[route->first]);
+    }
+  }
+
+  for (std::size_t i = 0; i < groups.size(); i++) {
+    const BroadcastGroup& config = groups[i];
+    const std::string path = "/broadcast_groups/" + std::to_string(i);
+
+    check.check_name(path + "/name", config.name, "broadcast group");
+    check.check_address(path + "/address", config.address);
+    if (config.count < 1 || config.count > kMaxWriteCoils) {
+      check.error(path + "/count", "count " + std::to_string(config.count) + " is outside 1-" +
+                                       std::to_string(kMaxWriteCoils));
+    }
+
+    PointTable::Group group{config.name, config.address, config.count, config.verify, {}};
+    std::map<int, std::vector<std::size_t>> members;
+    for (std::size_t r = 0; r < relays.size(); r++) {
+      const Relay& relay = relays[r];
+      if (relay.slave_id >= 1 && relay.address >= config.address && relay.address < config.address + config.count) {
+        members[relay.slave_id].push_back(r);
+      }
+    }
+    if (members.empty()) {
+      check.warning(path, "no configured relay in coils " + std::to_string(config.address) + "-" +
+                              std::to_string(config.address + config.count - 1));
+    }
+
+    const ModbusFunction function =
+        config.count == 1 ? ModbusFunction::WRITE_SINGLE_COIL : ModbusFunction::WRITE_MULTIPLE_COILS;
+    for (auto& [slave_id, indices] : members) {
+      const DeviceProfile& profile = table.profiles.at(slave_id);
+      const std::string slave = "slave " + std::to_string(slave_id) + " (" + profile.name + ")";
+      if (!profile.supports(function)) {
+        check.warning(path, slave + " does not support FC" + std::to_string(static_cast<int>(function)) +
+                                " and ignores the broadcast");
+      }
+      if (config.verify && !profile.supports(ModbusFunction::READ_COILS)) {
+        check.warning(path + "/verify", slave + " cannot read back coils; its relay states stay unpublished");
+      }
+      std::sort(indices.begin(), indices.end(),
+                [&relays](std::size_t a, std::size_t b) { return relays[a].address < relays[b].address; });
+      group.members.push_back({slave_id, std::move(indices)});
+    }
+
+    if (check.check_topic(path + "/mqtt_command_topic", config.mqtt_command_topic)) {
+      const std::string topic = config.mqtt_command_topic;
+      auto relay_route = table.command_routes.find(topic);
+      if (relay_route != table.command_routes.end()) {
+        check.error(path + "/mqtt_command_topic",
+                    "command topic '" + topic + "' already controls " + route_paths[relay_route->first]);
+      } else if (const std::string* publisher = check.publisher(topic)) {
+        check.error(path + "/mqtt_command_topic", "command topic '" + topic + "' is published by " + *publisher);
+      } else if (!table.group_routes.emplace(topic, table.groups.size()).second) {
+        check.error(path + "/mqtt_command_topic", "command topic '" + topic + "' already controls another group");
+      }
+    }
+
+    table.groups.push_back(std::move(group));
+  }
+
+  return table;
+}
+
+PointTable compile_points(const std::vector<DigitalInput>& inputs, const std::vector<Relay>& relays) {
+  std::vector<ConfigDiagnostic> diagnostics;
+  return compile_points(inputs, relays, diagnostics);
+}
@@ -0,0 +1,281 @@
+#include "point_templates.hpp"
+
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr long kMaxRangeSize = 65536;
+
+// Values substituted into name and topic patterns
+struct PatternVars {
+  int slave;
+  int address;
+  std::size_t index;
+  const std::string* module;  // nullptr outside modules
+};
+
+int parse_int(const std::string& text) {
+  std::size_t used = 0;
+  int value = 0;
+  try {
+    value = std::stoi(text, &used);
+  } catch (const std::exception&) {
+    used = 0;
+  }
+  if (used == 0 || used != text.size()) {
+    throw std::invalid_argument("'" + text + "' is not a number");
+  }
+  return value;
+}
+
+// "0-7,12" -> 0..7, 12
+void parse_range_text(const std::string& text, std::vector<int>& values) {
+  std::size_t pos = 0;
+  while (pos <= text.size()) {
+    std::size_t end = text.find(',', pos);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    const std::string part = text.substr(pos, end - pos);
+
+    const std::size_t dash = part.find('-', 1);
+    const int first = parse_int(part.substr(0, dash));
+    const int last = (dash == std::string::npos) ? first : parse_int(part.substr(dash + 1));
+    if (last < first) {
+      throw std::invalid_argument("range '" + part + "' runs backwards");
+    }
+    if (static_cast<long>(last) - first >= kMaxRangeSize) {
+      throw std::invalid_argument("range '" + part + "' is too large");
+    }
+    for (int value = first; value <= last; value++) {
+      values.push_back(value);
+    }
+
+    pos = end + 1;
+  }
+}
+
+std::string substitute(const std::string& pattern, const PatternVars& vars) {
+  if (pattern.find('{') == std::string::npos) {
+    return pattern;
+  }
+
+  std::string out;
+  out.reserve(pattern.size() + 8);
+
+  for (std::size_t i = 0; i < pattern.size(); i++) {
+    const std::size_t close = (pattern[i] == '{') ? pattern.find('}', i) : std::string::npos;
+    if (close == std::string::npos) {
+      out += pattern[i];
+      continue;
+    }
+
+    const std::string key = pattern.substr(i + 1, close - i - 1);
+    if (key == "slave") {
+      out += std::to_string(vars.slave);
+    } else if (key == "address") {
+      out += std::to_string(vars.address);
+    } else if (key == "index") {
+      out += std::to_string(vars.index);
+    } else if (key == "module" && vars.module != nullptr) {
+      out += *vars.module;
+    } else {
+      throw std::invalid_argument("unknown placeholder {" + key + "} in '" + pattern + "'");
+    }
+    i = close;
+  }
+
+  return out;
+}
+
+std::string pattern_field(const nlohmann::json& entry, const char* key, const PatternVars& vars,
+                          const std::string& fallback) {
+  return entry.contains(key) ? substitute(entry.at(key).get<std::string>(), vars) : fallback;
+}
+
+// Topics default to the same layout as DigitalInput/Relay::from_json
+void fill_topics(DigitalInput& input, const nlohmann::json& entry, const PatternVars& vars) {
+  input.mqtt_topic = pattern_field(entry, "mqtt_topic", vars, "modbus/input/" + input.name + "/state");
+}
+
+void fill_topics(Relay& relay, const nlohmann::json& entry, const PatternVars& vars) {
+  relay.mqtt_command_topic = pattern_field(entry, "mqtt_command_topic", vars, "modbus/relay/" + relay.name + "/set");
+  relay.mqtt_state_topic = pattern_field(entry, "mqtt_state_topic", vars, "modbus/relay/" + relay.name + "/state");
+}
+
+bool is_single_point(const nlohmann::json& entry) {
+  return entry.is_object() && entry.contains("slave_id") && entry.at("slave_id").is_number_integer() &&
+         entry.contains("address") && entry.at("address").is_number_integer() &&
+         !(entry.contains("name") && entry.at("name").is_array());
+}
+
+class Expander {
+ public:
+  Expander(ExpandedPoints& out, std::vector<ConfigDiagnostic>& diagnostics) : out_(out), diagnostics_(diagnostics) {}
+
+  void expand_list(const nlohmann::json& config, const char* key) {
+    if (!config.contains(key)) {
+      return;
+    }
+    const std::string path = std::string("/") + key;
+    const auto& entries = config.at(key);
+    if (!entries.is_array()) {
+      error(path, "must be an array");
+      return;
+    }
+
+    for (std::size_t i = 0; i < entries.size(); i++) {
+      const std::string entry_path = path + "/" + std::to_string(i);
+      if (key == std::string("relays")) {
+        expand(entries[i], entry_path, entry_path, nullptr, nullptr, out_.relays, out_.sources.relays);
+      } else {
+        expand(entries[i], entry_path, entry_path, nullptr, nullptr, out_.inputs, out_.sources.inputs);
+      }
+    }
+  }
+
+  void expand_modules(const nlohmann::json& config) {
+    if (!config.contains("modules")) {
+      return;
+    }
+    const auto& modules = config.at("modules");
+    const auto templates = config.value("templates", nlohmann::json::object());
+    if (!modules.is_array()) {
+      error("/modules", "must be an array");
+      return;
+    }
+
+    for (std::size_t i = 0; i < modules.size(); i++) {
+      const std::string path = "/modules/" + std::to_string(i);
+      const auto& module = modules[i];
+
+      try {
+        const std::string type = module.at("template").get<std::string>();
+        if (!templates.contains(type)) {
+          error(path + "/template", "unknown template '" + type + "'");
+          continue;
+        }
+        const auto& tmpl = templates.at(type);
+        const auto inputs = tmpl.value("digital_inputs", nlohmann::json::array());
+        const auto relays = tmpl.value("relays", nlohmann::json::array());
+        const std::string template_path = "/templates/" + type;
+        const std::string name_pattern = module.value("name", type + "_{slave}");
+        const std::string profile = tmpl.value("profile", "");
+
+        for (int slave : parse_id_range(module.at("slave_id"))) {
+          const std::string name = substitute(name_pattern, {slave, 0, 0, nullptr});
+          if (!profile.empty()) {
+            out_.profiles.push_back({slave, profile, template_path + "/profile"});
+          }
+
+          for (std::size_t j = 0; j < inputs.size(); j++) {
+            expand(inputs[j], template_path + "/digital_inputs/" + std::to_string(j), path, &slave, &name,
+                   out_.inputs, out_.sources.inputs);
+          }
+          for (std::size_t j = 0; j < relays.size(); j++) {
+            expand(relays[j], template_path + "/relays/" + std::to_string(j), path, &slave, &name, out_.relays,
+                   out_.sources.relays);
+          }
+        }
+      } catch (const nlohmann::json::exception& e) {
+        error(path, e.what());
+      } catch (const std::invalid_argument& e) {
+        error(path, e.what());
+      }
+    }
+  }
+
+ private:
+  ExpandedPoints& out_;
+  std::vector<ConfigDiagnostic>& diagnostics_;
+
+  void error(const std::string& path, const std::string& message) {
+    diagnostics_.push_back({ConfigDiagnostic::Severity::ERROR, path, message});
+  }
+
+  // Errors are reported at `path`; expanded points get `source` plus their slave and address
+  template <typename Point>
+  void expand(const nlohmann::json& entry, const std::string& path, const std::string& source, const int* slave,
+              const std::string* module, std::vector<Point>& points, std::vector<std::string>& sources) {
+    try {
+      if (slave == nullptr && is_single_point(entry)) {
+        points.push_back(Point::from_json(entry));
+        sources.push_back(source);
+        return;
+      }
+
+      const std::vector<int> slaves = slave ? std::vector<int>{*slave} : parse_id_range(entry.at("slave_id"));
+      const std::vector<int> addresses = parse_id_range(entry.at("address"));
+      const auto& name = entry.at("name");
+
+      const std::size_t count = slaves.size() * addresses.size();
+      if (name.is_array() && name.size() != count) {
+        throw std::invalid_argument("name lists " + std::to_string(name.size()) + " names for " +
+                                    std::to_string(count) + " points");
+      }
+
+      std::size_t index = 0;
+      for (int slave_id : slaves) {
+        for (int address : addresses) {
+          const PatternVars vars{slave_id, address, index, module};
+
+          Point point;
+          point.slave_id = slave_id;
+          point.address = address;
+          point.name = name.is_array() ? name[index].get<std::string>() : substitute(name.get<std::string>(), vars);
+          fill_topics(point, entry, vars);
+
+          points.push_back(std::move(point));
+          sources.push_back(source + "[slave=" + std::to_string(slave_id) + ",address=" + std::to_string(address) +
+                            "]");
+          index++;
+        }
+      }
+    } catch (const nlohmann::json::exception& e) {
+      error(path, e.what());
+    } catch (const std::invalid_argument& e) {
+      error(path, e.what());
+    }
+  }
+};
+
+}  // namespace
+
+ExpandedPoints expand_points(const nlohmann::json& config, std::vector<ConfigDiagnostic>& diagnostics) {
+  ExpandedPoints out;
+  Expander expander(out, diagnostics);
+
+  expander.expand_list(config, "digital_inputs");
+  expander.expand_list(config, "relays");
+  expander.expand_modules(config);
+
+  return out;
+}
+
+std::vector<int> parse_id_range(const nlohmann::json& j) {
+  std::vector<int> values;
+
+  auto add = [&values](const nlohmann::json& item) {
+    if (item.is_number_integer()) {
+      values.push_back(item.get<int>());
+    } else if (item.is_string()) {
+      parse_range_text(item.get<std::string>(), values);
+    } else {
+      throw std::invalid_argument("expected a number or a range like \"0-7\"");
+    }
+  };
+
+  if (j.is_array()) {
+    for (const auto& item : j) {
+      add(item);
+    }
+  } else {
+    add(j);
+  }
+
+  if (values.empty()) {
+    throw std::invalid_argument("empty range");
+  }
+  return values;
+}
@@ -0,0 +1,49 @@
+#include "rtu/crc16.hpp"
+
+#include <array>
+
+namespace {
+
+constexpr std::size_t kSlices = 8;
+using CrcTables = std::array<std::array<uint16_t, 256>, kSlices>;
+
+constexpr CrcTables make_tables() {
+  CrcTables tables{};
+  for (std::size_t i = 0; i < 256; i++) {
+    uint16_t crc = static_cast<uint16_t>(i);
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) ? static_cast<uint16_t>((crc >> 1) ^ 0xA001) : static_cast<uint16_t>(crc >> 1);
+    }
+    tables[0][i] = crc;
+  }
+  // tables[k][i]: the CRC of byte i followed by k zero bytes
+  for (std::size_t k = 1; k < kSlices; k++) {
+    for (std::size_t i = 0; i < 256; i++) {
+      const uint16_t previous = tables[k - 1][i];
+      tables[k][i] = static_cast<uint16_t>((previous >> 8) ^ tables[0][previous & 0xFF]);
+    }
+  }
+  return tables;
+}
+
+constexpr CrcTables kTables = make_tables();
+
+}  // namespace
+
+uint16_t rtu_crc16(const uint8_t* data, std::size_t length) {
+  uint16_t crc = 0xFFFF;
+
+  while (length >= kSlices) {
+    crc ^= static_cast<uint16_t>(data[0] | (data[1] << 8));
+    crc = static_cast<uint16_t>(kTables[7][crc & 0xFF] ^ kTables[6][crc >> 8] ^ kTables[5][data[2]] ^
+                                kTables[4][data[3]] ^ kTables[3][data[4]] ^ kTables[2][data[5]] ^
+                                kTables[1][data[6]] ^ kTables[0][data[7]]);
+    data += kSlices;
+    length -= kSlices;
+  }
+
+  while (length-- > 0) {
+    crc = static_cast<uint16_t>((crc >> 8) ^ kTables[0][(crc ^ *data++) & 0xFF]);
+  }
+  return crc;
+}
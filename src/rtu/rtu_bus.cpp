@@ -0,0 +1,356 @@
+#include "rtu/rtu_bus.hpp"
+
+#include "rtu/crc16.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <modbus/modbus.h>
+#include <stdexcept>
+#include <system_error>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t kExceptionReplySize = 5;
+constexpr std::size_t kWriteReplySize = 8;
+constexpr std::size_t kCrcSize = 2;
+
+speed_t baud_constant(int baudrate) {
+  switch (baudrate) {
+    case 1200: return B1200;
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default: return B0;
+  }
+}
+
+void put_word(uint8_t* p, int value) {
+  p[0] = static_cast<uint8_t>((value >> 8) & 0xFF);
+  p[1] = static_cast<uint8_t>(value & 0xFF);
+}
+
+}  // namespace
+
+RtuBus::RtuBus(const ModbusConfig& config, const RtuTimeouts& timeouts)
+    : config_(config), timing_(config), timeouts_(timeouts) {}
+
+RtuBus::~RtuBus() {
+  close();
+}
+
+void RtuBus::open() {
+  if (fd_ >= 0) {
+    return;
+  }
+
+  const speed_t speed = baud_constant(config_.baudrate);
+  if (speed == B0) {
+    throw std::system_error(EINVAL, std::generic_category(),
+                            "unsupported baud rate " + std::to_string(config_.baudrate));
+  }
+
+  const int fd = ::open(config_.port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "cannot open " + config_.port);
+  }
+
+  termios tio{};
+  if (tcgetattr(fd, &tio) != 0) {
+    const int error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), "not a serial port: " + config_.port);
+  }
+
+  cfmakeraw(&tio);
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+
+  tio.c_cflag &= ~static_cast<tcflag_t>(CSIZE | PARENB | PARODD | CSTOPB);
+  tio.c_cflag |= CLOCAL | CREAD;
+  switch (config_.data_bits) {
+    case 5: tio.c_cflag |= CS5; break;
+    case 6: tio.c_cflag |= CS6; break;
+    case 7: tio.c_cflag |= CS7; break;
+    default: tio.c_cflag |= CS8; break;
+  }
+  if (config_.parity == 'E') {
+    tio.c_cflag |= PARENB;
+  } else if (config_.parity == 'O') {
+    tio.c_cflag |= PARENB | PARODD;
+  }
+  if (config_.stop_bits == 2) {
+    tio.c_cflag |= CSTOPB;
+  }
+  // Non-blocking reads return what is there
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+
+  if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+    const int error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), "cannot configure " + config_.port);
+  }
+  tcflush(fd, TCIOFLUSH);
+
+  fd_ = fd;
+  state_ = State::IDLE;
+  stale_input_ = false;
+  quiet_at_ = std::chrono::steady_clock::now();
+}
+
+void RtuBus::close() {
+  if (fd_ < 0) {
+    return;
+  }
+  ::close(fd_);
+  fd_ = -1;
+
+  if (state_ != State::IDLE) {
+    finish(EBADF, std::chrono::steady_clock::now());
+  }
+}
+
+bool RtuBus::submit(const RtuRequest& request, Completion done) {
+  if (busy() || fd_ < 0) {
+    return false;
+  }
+
+  const bool read = request.function == ModbusFunction::READ_COILS ||
+                    request.function == ModbusFunction::READ_DISCRETE_INPUTS;
+  const int max_count = read ? kMaxReadBits
+                             : (request.function == ModbusFunction::WRITE_MULTIPLE_COILS ? kMaxWriteCoils : 1);
+  if (request.count < 1 || request.count > max_count || (read ? !request.dest : !request.values) ||
+      (read && request.unit_id == kBroadcastUnit)) {
+    throw std::invalid_argument("invalid Modbus request: function " +
+                                std::to_string(static_cast<int>(request.function)) + ", " +
+                                std::to_string(request.count) + " bits");
+  }
+
+  request_ = request;
+  done_ = std::move(done);
+  build_frame();
+
+  const TimePoint now = std::chrono::steady_clock::now();
+  // The whole transaction, silence included, is bounded by the response timeout
+  reply_deadline_ = std::max(now, quiet_at_) + timing_.frame_time(tx_length_) + timeouts_.response;
+  state_ = State::WAITING_FOR_SILENCE;
+  process(now);
+  return true;
+}
+
+void RtuBus::build_frame() {
+  tx_[0] = static_cast<uint8_t>(request_.unit_id);
+  tx_[1] = static_cast<uint8_t>(request_.function);
+  put_word(&tx_[2], request_.address);
+
+  switch (request_.function) {
+    case ModbusFunction::READ_COILS:
+    case ModbusFunction::READ_DISCRETE_INPUTS:
+      put_word(&tx_[4], request_.count);
+      tx_length_ = 6;
+      break;
+    case ModbusFunction::WRITE_SINGLE_COIL:
+      put_word(&tx_[4], request_.values[0] ? 0xFF00 : 0x0000);
+      tx_length_ = 6;
+      break;
+    case ModbusFunction::WRITE_MULTIPLE_COILS: {
+      const std::size_t bytes = (static_cast<std::size_t>(request_.count) + 7) / 8;
+      put_word(&tx_[4], request_.count);
+      tx_[6] = static_cast<uint8_t>(bytes);
+      for (std::size_t i = 0; i < bytes; i++) {
+        tx_[7 + i] = 0;
+      }
+      for (int bit = 0; bit < request_.count; bit++) {
+        if (request_.values[bit]) {
+          tx_[7 + bit / 8] |= static_cast<uint8_t>(1 << (bit % 8));
+        }
+      }
+      tx_length_ = 7 + bytes;
+      break;
+    }
+  }
+
+  const uint16_t crc = rtu_crc16(tx_.data(), tx_length_);
+  tx_[tx_length_++] = static_cast<uint8_t>(crc & 0xFF);
+  tx_[tx_length_++] = static_cast<uint8_t>(crc >> 8);
+  tx_sent_ = 0;
+}
+
+bool RtuBus::discard_input() {
+  if (fd_ < 0) {
+    return false;
+  }
+  uint8_t scratch[64];
+  bool discarded = false;
+  for (;;) {
+    const ssize_t n = ::read(fd_, scratch, sizeof(scratch));
+    if (n > 0) {
+      discarded = true;
+    } else if (n == 0 || errno != EINTR) {
+      return discarded;
+    }
+  }
+}
+
+void RtuBus::process(TimePoint now, bool readable) {
+  // Nothing answers outside a reply; the next frame waits t3.5 after the noise
+  if (readable && state_ != State::RECEIVING && discard_input()) {
+    quiet_at_ = std::max(quiet_at_, std::chrono::time_point_cast<TimePoint::duration>(now + timing_.frame_gap()));
+  }
+
+  switch (state_) {
+    case State::IDLE:
+      return;
+    case State::WAITING_FOR_SILENCE:
+      if (now < quiet_at_) {
+        return;
+      }
+      // Leftovers of a failed transaction would be taken for this reply
+      if (stale_input_) {
+        discard_input();
+        stale_input_ = false;
+      }
+      state_ = State::SENDING;
+      send(now);
+      return;
+    case State::SENDING:
+      send(now);
+      return;
+    case State::RECEIVING:
+      receive(now);
+      return;
+  }
+}
+
+void RtuBus::send(TimePoint now) {
+  while (tx_sent_ < tx_length_) {
+    const ssize_t n = ::write(fd_, tx_.data() + tx_sent_, tx_length_ - tx_sent_);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (now >= reply_deadline_) {
+          finish(ETIMEDOUT, now);
+        }
+        return;
+      }
+      finish(errno, now);
+      return;
+    }
+    tx_sent_ += static_cast<std::size_t>(n);
+  }
+
+  // The driver queued the frame; the slave has it once it is on the wire
+  const TimePoint on_wire = now + timing_.character_time() * static_cast<int64_t>(tx_length_);
+  if (request_.unit_id == kBroadcastUnit) {
+    // No reply; the slaves get the response timeout to carry it out
+    quiet_at_ = std::chrono::time_point_cast<TimePoint::duration>(on_wire + timeouts_.response);
+    finish(0, now);
+    return;
+  }
+  reply_deadline_ = std::chrono::time_point_cast<TimePoint::duration>(on_wire + timeouts_.response);
+  rx_length_ = 0;
+  rx_expected_ = 2;  // unit id and function code tell the rest
+  state_ = State::RECEIVING;
+  receive(now);
+}
+
+void RtuBus::receive(TimePoint now) {
+  while (rx_length_ < rx_expected_) {
+    const ssize_t n = ::read(fd_, rx_.data() + rx_length_, rx_expected_ - rx_length_);
+    if (n > 0) {
+      rx_length_ += static_cast<std::size_t>(n);
+      reply_deadline_ = now + timeouts_.byte;
+      update_expected_length();
+      continue;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      finish(errno, now);
+      return;
+    }
+    // Nothing more for now
+    if (now >= reply_deadline_) {
+      finish(ETIMEDOUT, now);
+    }
+    return;
+  }
+
+  finish(check_reply(), now);
+}
+
+void RtuBus::update_expected_length() {
+  if (rx_length_ < 2) {
+    return;
+  }
+  if (rx_[1] & 0x80) {
+    rx_expected_ = kExceptionReplySize;
+    return;
+  }
+  switch (request_.function) {
+    case ModbusFunction::READ_COILS:
+    case ModbusFunction::READ_DISCRETE_INPUTS:
+      // Unit id, function, byte count, data, CRC
+      rx_expected_ = rx_length_ < 3 ? 3 : std::min<std::size_t>(3 + rx_[2] + kCrcSize, kMaxFrameSize);
+      break;
+    case ModbusFunction::WRITE_SINGLE_COIL:
+    case ModbusFunction::WRITE_MULTIPLE_COILS:
+      rx_expected_ = kWriteReplySize;
+      break;
+  }
+}
+
+int RtuBus::check_reply() const {
+  const uint16_t crc = static_cast<uint16_t>(rx_[rx_length_ - 2] | (rx_[rx_length_ - 1] << 8));
+  if (rtu_crc16(rx_.data(), rx_length_ - kCrcSize) != crc) {
+    return EMBBADCRC;
+  }
+  if (rx_[0] != tx_[0] || (rx_[1] & 0x7F) != tx_[1]) {
+    return EMBBADDATA;
+  }
+  if (rx_[1] & 0x80) {
+    return MODBUS_ENOBASE + rx_[2];
+  }
+
+  if (request_.function == ModbusFunction::READ_COILS || request_.function == ModbusFunction::READ_DISCRETE_INPUTS) {
+    if (rx_[2] != (request_.count + 7) / 8) {
+      return EMBBADDATA;
+    }
+    for (int bit = 0; bit < request_.count; bit++) {
+      request_.dest[bit] = (rx_[3 + bit / 8] >> (bit % 8)) & 1;
+    }
+    return 0;
+  }
+
+  // Writes are echoed: address and value or quantity
+  for (std::size_t i = 2; i < 6; i++) {
+    if (rx_[i] != tx_[i]) {
+      return EMBBADDATA;
+    }
+  }
+  return 0;
+}
+
+void RtuBus::finish(int error, TimePoint now) {
+  // Whatever was on the line, the next frame starts t3.5 after it
+  quiet_at_ = std::max(quiet_at_, std::chrono::time_point_cast<TimePoint::duration>(now + timing_.frame_gap()));
+  stale_input_ = error != 0;
+  state_ = State::IDLE;
+
+  Completion done = std::move(done_);
+  done_ = nullptr;
+  if (done) {
+    done(error);
+  }
+}
@@ -0,0 +1,159 @@
+#include "rtu/rtu_event_loop.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kMaxEvents = 16;
+
+[[noreturn]] void throw_errno(const char* what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+}  // namespace
+
+RtuEventLoop::RtuEventLoop() : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)) {
+  if (epoll_fd_ < 0) {
+    throw_errno("epoll_create1");
+  }
+}
+
+RtuEventLoop::~RtuEventLoop() {
+  for (const Entry& entry : entries_) {
+    ::close(entry.timer_fd);
+  }
+  ::close(epoll_fd_);
+}
+
+void RtuEventLoop::add(RtuBus& bus) {
+  Entry entry{&bus, bus.fd(), timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)};
+  if (entry.timer_fd < 0) {
+    throw_errno("timerfd_create");
+  }
+
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = entry.fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, entry.fd, &event) != 0) {
+    const int error = errno;
+    ::close(entry.timer_fd);
+    throw std::system_error(error, std::generic_category(), "epoll_ctl " + bus.port());
+  }
+  event.data.fd = entry.timer_fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, entry.timer_fd, &event) != 0) {
+    const int error = errno;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, entry.fd, nullptr);
+    ::close(entry.timer_fd);
+    throw std::system_error(error, std::generic_category(), "epoll_ctl timer of " + bus.port());
+  }
+
+  entries_.push_back(entry);
+  ready_.reserve(entries_.size());
+}
+
+void RtuEventLoop::remove(RtuBus& bus) {
+  auto it = std::find_if(entries_.begin(), entries_.end(), [&bus](const Entry& entry) { return entry.bus == &bus; });
+  if (it == entries_.end()) {
+    return;
+  }
+  // The bus may have closed its fd already, which drops it from the epoll set
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->fd, nullptr);
+  ::close(it->timer_fd);
+  entries_.erase(it);
+}
+
+RtuEventLoop::Entry* RtuEventLoop::find(int fd) {
+  for (Entry& entry : entries_) {
+    if (entry.fd == fd || entry.timer_fd == fd) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+void RtuEventLoop::sync(Entry& entry) {
+  const bool want_write = entry.bus->wants_write();
+  if (want_write != entry.write_armed) {
+    epoll_event event{};
+    event.events = EPOLLIN | (want_write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.fd = entry.fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, entry.fd, &event);
+    entry.write_armed = want_write;
+  }
+
+  if (!entry.bus->has_deadline()) {
+    return;  // a stale expiry costs one wakeup
+  }
+  const RtuBus::TimePoint deadline = entry.bus->deadline();
+  if (entry.timer_armed && entry.timer_at <= deadline) {
+    return;
+  }
+
+  // steady_clock is CLOCK_MONOTONIC
+  const auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch());
+  itimerspec spec{};
+  spec.it_value.tv_sec = static_cast<time_t>(since_epoch.count() / 1000000000);
+  spec.it_value.tv_nsec = static_cast<long>(since_epoch.count() % 1000000000);
+  if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+    spec.it_value.tv_nsec = 1;  // zero would disarm
+  }
+  timerfd_settime(entry.timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+  entry.timer_armed = true;
+  entry.timer_at = deadline;
+}
+
+std::size_t RtuEventLoop::run_once(std::chrono::milliseconds timeout) {
+  // Transactions submitted since the last round
+  for (Entry& entry : entries_) {
+    sync(entry);
+  }
+
+  epoll_event events[kMaxEvents];
+  const int n = epoll_wait(epoll_fd_, events, kMaxEvents, static_cast<int>(timeout.count()));
+  if (n < 0) {
+    if (errno == EINTR) {
+      return 0;
+    }
+    throw_errno("epoll_wait");
+  }
+
+  ready_.clear();
+  for (int i = 0; i < n; i++) {
+    Entry* entry = find(events[i].data.fd);
+    if (!entry) {
+      continue;
+    }
+    if (std::find(ready_.begin(), ready_.end(), entry) == ready_.end()) {
+      entry->readable = false;
+      ready_.push_back(entry);
+    }
+    if (events[i].data.fd == entry->timer_fd) {
+      uint64_t expirations;
+      if (::read(entry->timer_fd, &expirations, sizeof(expirations)) > 0) {
+        entry->timer_armed = false;
+      }
+    } else if (events[i].events & EPOLLIN) {
+      entry->readable = true;
+    }
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  for (Entry* entry : ready_) {
+    entry->bus->process(now, entry->readable);
+    sync(*entry);
+  }
+  return ready_.size();
+}
+
+void RtuEventLoop::run_until_idle(RtuBus& bus) {
+  // Every busy state has a deadline, so this ends
+  while (bus.busy()) {
+    run_once(std::chrono::milliseconds(1000));
+  }
+}
@@ -0,0 +1,84 @@
+#include "stats_service.hpp"
+
+namespace {
+
+double ratio(uint64_t success, uint64_t errors) {
+  const uint64_t total = success + errors;
+  return total > 0 ? static_cast<double>(success) / total : 1.0;
+}
+
+double rate(uint64_t delta, double seconds) {
+  return seconds > 0 ? delta / seconds : 0.0;
+}
+
+}  // namespace
+
+StatsService::StatsService(const IModbusManager& modbus, const IMqttManager& mqtt,
+                           std::chrono::seconds sample_interval)
+    : modbus_(modbus), mqtt_(mqtt), sample_interval_(sample_interval), head_(0), size_(0) {
+  // One extra slot so a full retention window always has a sample at its start
+  ring_.resize(static_cast<std::size_t>(kRetention / sample_interval_) + 1);
+}
+
+void StatsService::sample(std::chrono::steady_clock::time_point now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (size_ > 0 && now - at(0).time < sample_interval_) {
+    return;
+  }
+
+  ring_[head_] = {now, modbus_.get_stats(), mqtt_.get_stats()};
+  head_ = (head_ + 1) % ring_.size();
+  if (size_ < ring_.size()) {
+    size_++;
+  }
+}
+
+WindowStats StatsService::window(std::chrono::seconds span) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  WindowStats stats{span, std::chrono::seconds(0), 0, 0, 0, 0, 1.0, 1.0, 1.0};
+  if (size_ < 2) {
+    return stats;
+  }
+
+  const Sample& newest = at(0);
+
+  // Oldest sample still inside the window
+  std::size_t age = 1;
+  while (age + 1 < size_ && newest.time - at(age + 1).time <= span) {
+    age++;
+  }
+  const Sample& oldest = at(age);
+
+  const double seconds = std::chrono::duration<double>(newest.time - oldest.time).count();
+  stats.covered = std::chrono::duration_cast<std::chrono::seconds>(newest.time - oldest.time);
+
+  const uint64_t read_ok = newest.modbus.read_success - oldest.modbus.read_success;
+  const uint64_t read_err = newest.modbus.read_errors - oldest.modbus.read_errors;
+  const uint64_t write_ok = newest.modbus.write_success - oldest.modbus.write_success;
+  const uint64_t write_err = newest.modbus.write_errors - oldest.modbus.write_errors;
+  const uint64_t pub_ok = newest.mqtt.publish_success - oldest.mqtt.publish_success;
+  const uint64_t pub_err = newest.mqtt.publish_errors - oldest.mqtt.publish_errors;
+  const uint64_t received = newest.mqtt.messages_received - oldest.mqtt.messages_received;
+
+  stats.read_rate = rate(read_ok + read_err, seconds);
+  stats.write_rate = rate(write_ok + write_err, seconds);
+  stats.publish_rate = rate(pub_ok + pub_err, seconds);
+  stats.receive_rate = rate(received, seconds);
+
+  stats.read_success_ratio = ratio(read_ok, read_err);
+  stats.write_success_ratio = ratio(write_ok, write_err);
+  stats.publish_success_ratio = ratio(pub_ok, pub_err);
+
+  return stats;
+}
+
+std::size_t StatsService::sample_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+const StatsService::Sample& StatsService::at(std::size_t age) const {
+  return ring_[(head_ + ring_.size() - 1 - age) % ring_.size()];
+}
@@ -12,8 +12,11 @@ public:
     
     MOCK_METHOD(bool, read_discrete_inputs, (int slave_id, int start_addr, (std::array<uint8_t, 8>&) dest), (override));
 
+    MOCK_METHOD(bool, read_coils, (int slave_id, int start_addr, int count, uint8_t* dest), (override));
+
     MOCK_METHOD(bool, write_coil, (int slave_id, int address, bool state), (override));
+
+    MOCK_METHOD(bool, broadcast_coils, (int start_addr, int count, bool state), (override));
     
-    MOCK_METHOD(std::unique_ptr<ModbusManagerStats>, get_stats, (), (const, override));
-    MOCK_METHOD(void, reset_stats, (), (override));
+    MOCK_METHOD(ModbusManagerStats, get_stats, (), (const, override));
 };
@@ -15,8 +15,7 @@ public:
     
     MOCK_METHOD(void, set_message_callback, (MqttMessageCallback callback), (override));
     
-    MOCK_METHOD(std::unique_ptr<MqttManagerStats>, get_stats, (), (const, override));
-    MOCK_METHOD(void, reset_stats, (), (override));
+    MOCK_METHOD(MqttManagerStats, get_stats, (), (const, override));
     
     // Helper method to trigger message callback for testing
     void trigger_message(const std::string& topic, const std::string& payload) {
@@ -55,8 +54,7 @@ public:
         manager_.set_message_callback(callback);
     }
     
-    std::unique_ptr<MqttManagerStats> get_stats() const override { return manager_.get_stats(); }
-    void reset_stats() override { manager_.reset_stats(); }
+    MqttManagerStats get_stats() const override { return manager_.get_stats(); }
     
 private:
     MqttManager& manager_;
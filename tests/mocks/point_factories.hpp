@@ -0,0 +1,26 @@
+#pragma once
+
+#include "config.hpp"
+
+#include <string>
+
+// Points for tests and benchmarks; topics are <prefix>/<name>/state and <prefix>/<name>/set
+inline DigitalInput make_input(int slave_id, int address, const std::string& name,
+                               const std::string& prefix = "test") {
+  DigitalInput input;
+  input.slave_id = slave_id;
+  input.address = address;
+  input.name = name;
+  input.mqtt_topic = prefix + "/" + name + "/state";
+  return input;
+}
+
+inline Relay make_relay(int slave_id, int address, const std::string& name, const std::string& prefix = "test") {
+  Relay relay;
+  relay.slave_id = slave_id;
+  relay.address = address;
+  relay.name = name;
+  relay.mqtt_command_topic = prefix + "/" + name + "/set";
+  relay.mqtt_state_topic = prefix + "/" + name + "/state";
+  return relay;
+}
@@ -0,0 +1,648 @@
+#include "local_mqtt_broker.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+enum PacketType : uint8_t {
+  CONNECT = 1,
+  CONNACK = 2,
+  PUBLISH = 3,
+  PUBACK = 4,
+  PUBREC = 5,
+  PUBREL = 6,
+  PUBCOMP = 7,
+  SUBSCRIBE = 8,
+  SUBACK = 9,
+  UNSUBSCRIBE = 10,
+  UNSUBACK = 11,
+  PINGREQ = 12,
+  PINGRESP = 13,
+  DISCONNECT = 14,
+};
+
+// Reads MQTT's length-prefixed strings and big-endian words, throwing
+// std::out_of_range on truncated packets
+class Reader {
+ public:
+  Reader(const uint8_t* data, std::size_t length) : data_(data), length_(length) {}
+
+  uint8_t byte() {
+    need(1);
+    return data_[pos_++];
+  }
+
+  uint16_t word() {
+    need(2);
+    const uint16_t value = static_cast<uint16_t>((data_[pos_] << 8) | data_[pos_ + 1]);
+    pos_ += 2;
+    return value;
+  }
+
+  std::string string() {
+    const std::size_t size = word();
+    need(size);
+    std::string value(reinterpret_cast<const char*>(data_ + pos_), size);
+    pos_ += size;
+    return value;
+  }
+
+  std::string rest() {
+    std::string value(reinterpret_cast<const char*>(data_ + pos_), length_ - pos_);
+    pos_ = length_;
+    return value;
+  }
+
+  bool done() const { return pos_ >= length_; }
+
+ private:
+  const uint8_t* data_;
+  std::size_t length_;
+  std::size_t pos_ = 0;
+
+  void need(std::size_t n) const {
+    if (pos_ + n > length_) {
+      throw std::out_of_range("truncated MQTT packet");
+    }
+  }
+};
+
+std::vector<uint8_t> packet(uint8_t header, const std::vector<uint8_t>& body) {
+  std::vector<uint8_t> out = {header};
+  std::size_t length = body.size();
+  do {
+    uint8_t digit = length % 128;
+    length /= 128;
+    out.push_back(length > 0 ? (digit | 0x80) : digit);
+  } while (length > 0);
+  out.insert(out.end(), body.begin(), body.end());
+  return out;
+}
+
+void put_word(std::vector<uint8_t>& out, uint16_t value) {
+  out.push_back(static_cast<uint8_t>(value >> 8));
+  out.push_back(static_cast<uint8_t>(value & 0xFF));
+}
+
+void put_string(std::vector<uint8_t>& out, const std::string& value) {
+  put_word(out, static_cast<uint16_t>(value.size()));
+  out.insert(out.end(), value.begin(), value.end());
+}
+
+std::vector<uint8_t> ack(PacketType type, uint16_t packet_id, uint8_t flags = 0) {
+  std::vector<uint8_t> body;
+  put_word(body, packet_id);
+  return packet(static_cast<uint8_t>((type << 4) | flags), body);
+}
+
+}  // namespace
+
+struct LocalMqttBroker::Client {
+  int fd;
+  std::string client_id;
+  std::vector<uint8_t> in;
+  bool connected = false;
+  std::map<std::string, int> subscriptions;  // filter -> granted QoS
+  uint16_t next_packet_id = 1;
+
+  bool has_will = false;
+  bool clean_disconnect = false;
+  Message will;
+
+  uint16_t packet_id() {
+    const uint16_t id = next_packet_id++;
+    if (next_packet_id == 0) {
+      next_packet_id = 1;
+    }
+    return id;
+  }
+};
+
+LocalMqttBroker::LocalMqttBroker() = default;
+
+LocalMqttBroker::~LocalMqttBroker() {
+  stop();
+}
+
+void LocalMqttBroker::start(uint16_t port) {
+  if (running_) {
+    return;
+  }
+  if (port == 0) {
+    port = port_;  // restart where we were
+  }
+
+  listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  const int on = 1;
+  ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+
+  if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listen_fd_, 16) != 0 ||
+      ::pipe2(wake_pipe_, O_CLOEXEC | O_NONBLOCK) != 0) {
+    const std::string error = std::strerror(errno);
+    stop();
+    throw std::runtime_error("Cannot start MQTT broker: " + error);
+  }
+
+  socklen_t len = sizeof(addr);
+  ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+  port_ = ntohs(addr.sin_port);
+
+  running_ = true;
+  thread_ = std::thread(&LocalMqttBroker::run, this);
+}
+
+void LocalMqttBroker::stop() {
+  running_ = false;
+  wake();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& client : clients_) {
+    close_client(*client, false);
+  }
+  clients_.clear();
+  pending_.clear();
+
+  for (int* fd : {&listen_fd_, &wake_pipe_[0], &wake_pipe_[1]}) {
+    if (*fd >= 0) {
+      ::close(*fd);
+      *fd = -1;
+    }
+  }
+  changed_.notify_all();
+}
+
+void LocalMqttBroker::set_ack_delay(std::chrono::microseconds delay) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ack_delay_ = delay;
+}
+
+void LocalMqttBroker::drop_connections() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    drop_requested_ = true;
+  }
+  wake();
+}
+
+void LocalMqttBroker::publish(const std::string& topic, const std::string& payload, bool retained, int qos) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    injected_.push_back({"", topic, payload, qos, retained, std::chrono::steady_clock::now()});
+  }
+  wake();
+}
+
+void LocalMqttBroker::set_publish_callback(PublishCallback callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  publish_callback_ = std::move(callback);
+}
+
+bool LocalMqttBroker::wait_for_messages(const std::string& topic, std::size_t count,
+                                        std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return changed_.wait_for(lock, timeout, [&] {
+    auto it = topic_counts_.find(topic);
+    return it != topic_counts_.end() && it->second >= count;
+  });
+}
+
+bool LocalMqttBroker::wait_for_subscription(const std::string& filter, std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return changed_.wait_for(lock, timeout, [&] {
+    return std::any_of(clients_.begin(), clients_.end(),
+                       [&](const std::unique_ptr<Client>& c) { return c->subscriptions.count(filter) > 0; });
+  });
+}
+
+std::size_t LocalMqttBroker::message_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return messages_.size();
+}
+
+std::size_t LocalMqttBroker::message_count(const std::string& topic) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = topic_counts_.find(topic);
+  return it == topic_counts_.end() ? 0 : it->second;
+}
+
+std::vector<LocalMqttBroker::Message> LocalMqttBroker::messages() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return messages_;
+}
+
+std::string LocalMqttBroker::retained(const std::string& topic) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = retained_.find(topic);
+  return it == retained_.end() ? std::string() : it->second;
+}
+
+std::size_t LocalMqttBroker::connection_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return connection_count_;
+}
+
+std::size_t LocalMqttBroker::connected_clients() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<std::size_t>(std::count_if(clients_.begin(), clients_.end(),
+                                                 [](const std::unique_ptr<Client>& c) { return c->connected; }));
+}
+
+bool LocalMqttBroker::topic_matches(const std::string& filter, const std::string& topic) {
+  std::size_t f = 0;
+  std::size_t t = 0;
+
+  while (f < filter.size()) {
+    const std::size_t f_end = std::min(filter.find('/', f), filter.size());
+    const std::string level = filter.substr(f, f_end - f);
+
+    if (level == "#") {
+      return true;
+    }
+    if (t > topic.size()) {
+      return false;
+    }
+    const std::size_t t_end = std::min(topic.find('/', t), topic.size());
+    if (level != "+" && level != topic.substr(t, t_end - t)) {
+      return false;
+    }
+
+    f = f_end + 1;
+    t = t_end + 1;
+  }
+  return t > topic.size();
+}
+
+void LocalMqttBroker::wake() {
+  if (wake_pipe_[1] >= 0) {
+    const uint8_t byte = 0;
+    [[maybe_unused]] ssize_t n = ::write(wake_pipe_[1], &byte, 1);
+  }
+}
+
+void LocalMqttBroker::run() {
+  std::vector<pollfd> fds;
+
+  while (running_) {
+    int timeout_ms = 100;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      fds.assign({{wake_pipe_[0], POLLIN, 0}, {listen_fd_, POLLIN, 0}});
+      for (const auto& client : clients_) {
+        fds.push_back({client->fd, POLLIN, 0});
+      }
+      if (!pending_.empty()) {
+        auto next = std::min_element(pending_.begin(), pending_.end(),
+                                     [](const PendingSend& a, const PendingSend& b) { return a.due < b.due; });
+        const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+            next->due - std::chrono::steady_clock::now());
+        timeout_ms = static_cast<int>(std::max<int64_t>(0, wait.count()));
+      }
+    }
+
+    ::poll(fds.data(), fds.size(), timeout_ms);
+    if (!running_) {
+      break;
+    }
+
+    std::vector<Message> published;
+    PublishCallback callback;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      flush_pending(std::chrono::steady_clock::now());
+
+      if (fds[0].revents & POLLIN) {
+        uint8_t drain[64];
+        while (::read(wake_pipe_[0], drain, sizeof(drain)) > 0) {
+        }
+      }
+
+      for (const auto& message : injected_) {
+        if (message.retained) {
+          retained_[message.topic] = message.payload;
+        }
+        route(message);
+      }
+      injected_.clear();
+
+      if (drop_requested_) {
+        drop_requested_ = false;
+        for (auto& client : clients_) {
+          close_client(*client, true);
+        }
+      }
+
+      if (fds[1].revents & POLLIN) {
+        accept_client();
+      }
+
+      // Clients accepted above have no entry in fds yet
+      const std::size_t message_mark = messages_.size();
+      for (std::size_t i = 2; i < fds.size(); i++) {
+        if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+          continue;
+        }
+        for (auto& client : clients_) {
+          if (client->fd == fds[i].fd && !read_client(*client)) {
+            close_client(*client, !client->clean_disconnect);
+          }
+        }
+      }
+      clients_.erase(std::remove_if(clients_.begin(), clients_.end(),
+                                    [](const std::unique_ptr<Client>& c) { return c->fd < 0; }),
+                     clients_.end());
+
+      published.assign(messages_.begin() + static_cast<std::ptrdiff_t>(message_mark), messages_.end());
+      callback = publish_callback_;
+    }
+    changed_.notify_all();
+
+    if (callback) {
+      for (const auto& message : published) {
+        callback(message);
+      }
+    }
+  }
+}
+
+void LocalMqttBroker::accept_client() {
+  const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  const int on = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+  auto client = std::make_unique<Client>();
+  client->fd = fd;
+  clients_.push_back(std::move(client));
+}
+
+bool LocalMqttBroker::read_client(Client& client) {
+  uint8_t chunk[4096];
+  const ssize_t n = ::recv(client.fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+    return false;
+  }
+  if (n > 0) {
+    client.in.insert(client.in.end(), chunk, chunk + n);
+  }
+
+  // Complete packets: header byte, 1-4 byte remaining length, body
+  while (client.in.size() >= 2) {
+    std::size_t length = 0;
+    std::size_t multiplier = 1;
+    std::size_t pos = 1;
+    bool complete = false;
+    while (pos < client.in.size() && pos <= 4) {
+      length += (client.in[pos] & 0x7F) * multiplier;
+      multiplier *= 128;
+      if (!(client.in[pos++] & 0x80)) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete) {
+      return pos <= 4;  // malformed if the length never ends
+    }
+    if (client.in.size() < pos + length) {
+      break;
+    }
+
+    bool keep = false;
+    try {
+      keep = handle_packet(client, client.in[0], client.in.data() + pos, length);
+    } catch (const std::out_of_range&) {
+      keep = false;
+    }
+    if (!keep) {
+      return false;
+    }
+    client.in.erase(client.in.begin(), client.in.begin() + static_cast<std::ptrdiff_t>(pos + length));
+  }
+  return true;
+}
+
+bool LocalMqttBroker::handle_packet(Client& client, uint8_t header, const uint8_t* body, std::size_t length) {
+  Reader in(body, length);
+  const uint8_t type = header >> 4;
+
+  if (!client.connected && type != CONNECT) {
+    return false;
+  }
+
+  switch (type) {
+    case CONNECT: {
+      if (client.connected || in.string() != "MQTT" || in.byte() != 4) {
+        return false;
+      }
+      const uint8_t flags = in.byte();
+      in.word();  // keep alive, not enforced
+      client.client_id = in.string();
+      if (flags & 0x04) {
+        client.has_will = true;
+        client.will.client_id = client.client_id;
+        client.will.topic = in.string();
+        client.will.payload = in.string();
+        client.will.qos = (flags >> 3) & 0x03;
+        client.will.retained = (flags & 0x20) != 0;
+      }
+      if (flags & 0x80) {
+        in.string();  // user name
+      }
+      if (flags & 0x40) {
+        in.string();  // password
+      }
+
+      client.connected = true;
+      connection_count_++;
+      send(client.fd, packet(CONNACK << 4, {0x00, 0x00}), true);
+      return true;
+    }
+
+    case PUBLISH: {
+      Message message;
+      message.client_id = client.client_id;
+      message.qos = (header >> 1) & 0x03;
+      message.retained = (header & 0x01) != 0;
+      message.topic = in.string();
+      const uint16_t packet_id = message.qos > 0 ? in.word() : 0;
+      message.payload = in.rest();
+      message.received = std::chrono::steady_clock::now();
+
+      if (message.retained) {
+        if (message.payload.empty()) {
+          retained_.erase(message.topic);
+        } else {
+          retained_[message.topic] = message.payload;
+        }
+      }
+      messages_.push_back(message);
+      topic_counts_[message.topic]++;
+      route(message);
+
+      if (message.qos == 1) {
+        send(client.fd, ack(PUBACK, packet_id), true);
+      } else if (message.qos == 2) {
+        send(client.fd, ack(PUBREC, packet_id), true);
+      }
+      return true;
+    }
+
+    case PUBREL:
+      send(client.fd, ack(PUBCOMP, in.word()), true);
+      return true;
+
+    case PUBREC:  // our QoS 2 delivery
+      send(client.fd, ack(PUBREL, in.word(), 0x02), false);
+      return true;
+
+    case PUBACK:
+    case PUBCOMP:
+      return true;
+
+    case SUBSCRIBE: {
+      const uint16_t packet_id = in.word();
+      std::vector<uint8_t> body_out;
+      put_word(body_out, packet_id);
+      std::vector<std::string> filters;
+
+      while (!in.done()) {
+        const std::string filter = in.string();
+        const int qos = std::min<int>(in.byte() & 0x03, 2);
+        client.subscriptions[filter] = qos;
+        filters.push_back(filter);
+        body_out.push_back(static_cast<uint8_t>(qos));
+      }
+      send(client.fd, packet(static_cast<uint8_t>(SUBACK << 4), body_out), true);
+
+      // Retained messages follow the SUBACK
+      for (const auto& [topic, payload] : retained_) {
+        for (const auto& filter : filters) {
+          if (topic_matches(filter, topic)) {
+            std::vector<uint8_t> publish_body;
+            put_string(publish_body, topic);
+            publish_body.insert(publish_body.end(), payload.begin(), payload.end());
+            send(client.fd, packet(static_cast<uint8_t>((PUBLISH << 4) | 0x01), publish_body), true);
+            break;
+          }
+        }
+      }
+      return true;
+    }
+
+    case UNSUBSCRIBE: {
+      const uint16_t packet_id = in.word();
+      while (!in.done()) {
+        client.subscriptions.erase(in.string());
+      }
+      send(client.fd, ack(UNSUBACK, packet_id), true);
+      return true;
+    }
+
+    case PINGREQ:
+      send(client.fd, packet(PINGRESP << 4, {}), false);
+      return true;
+
+    case DISCONNECT:
+      client.clean_disconnect = true;
+      return false;
+
+    default:
+      return false;
+  }
+}
+
+void LocalMqttBroker::route(const Message& message) {
+  for (auto& client : clients_) {
+    if (!client->connected || client->fd < 0) {
+      continue;
+    }
+
+    int qos = -1;
+    for (const auto& [filter, granted] : client->subscriptions) {
+      if (topic_matches(filter, message.topic)) {
+        qos = std::max(qos, std::min(granted, message.qos));
+      }
+    }
+    if (qos < 0) {
+      continue;
+    }
+
+    std::vector<uint8_t> body;
+    put_string(body, message.topic);
+    if (qos > 0) {
+      put_word(body, client->packet_id());
+    }
+    body.insert(body.end(), message.payload.begin(), message.payload.end());
+    send(client->fd, packet(static_cast<uint8_t>((PUBLISH << 4) | (qos << 1)), body), false);
+  }
+}
+
+void LocalMqttBroker::close_client(Client& client, bool publish_will) {
+  if (client.fd < 0) {
+    return;
+  }
+
+  const int fd = client.fd;
+  ::close(fd);
+  client.fd = -1;
+  pending_.erase(std::remove_if(pending_.begin(), pending_.end(), [fd](const PendingSend& p) { return p.fd == fd; }),
+                 pending_.end());
+
+  if (publish_will && client.connected && client.has_will) {
+    client.will.received = std::chrono::steady_clock::now();
+    if (client.will.retained) {
+      retained_[client.will.topic] = client.will.payload;
+    }
+    route(client.will);
+  }
+  client.connected = false;
+}
+
+void LocalMqttBroker::send(int fd, std::vector<uint8_t> bytes, bool acknowledgement) {
+  if (acknowledgement && ack_delay_.count() > 0) {
+    pending_.push_back({std::chrono::steady_clock::now() + ack_delay_, fd, std::move(bytes)});
+    wake();
+    return;
+  }
+  // Keep the order of anything already delayed to this client
+  if (std::any_of(pending_.begin(), pending_.end(), [fd](const PendingSend& p) { return p.fd == fd; })) {
+    pending_.push_back({std::chrono::steady_clock::now(), fd, std::move(bytes)});
+    wake();
+    return;
+  }
+  ::send(fd, bytes.data(), bytes.size(), MSG_NOSIGNAL);
+}
+
+void LocalMqttBroker::flush_pending(std::chrono::steady_clock::time_point now) {
+  // In order per client: stop at the first entry of a client that is not due
+  std::vector<int> blocked;
+  std::vector<PendingSend> keep;
+  for (auto& p : pending_) {
+    if (p.due > now || std::find(blocked.begin(), blocked.end(), p.fd) != blocked.end()) {
+      blocked.push_back(p.fd);
+      keep.push_back(std::move(p));
+    } else {
+      ::send(p.fd, p.bytes.data(), p.bytes.size(), MSG_NOSIGNAL);
+    }
+  }
+  pending_.swap(keep);
+}
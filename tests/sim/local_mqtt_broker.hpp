@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// In-process MQTT 3.1.1 broker on 127.0.0.1 for tests and benchmarks.
+//
+// Covers what the gateway uses: CONNECT with will and credentials (any
+// are accepted), PUBLISH at QoS 0-2, retained messages, SUBSCRIBE and
+// UNSUBSCRIBE with + and # wildcards, PINGREQ and DISCONNECT. Sessions are
+// always clean and nothing is redelivered.
+//
+// Fault hooks: acknowledgements can be delayed, every connection can be
+// dropped (wills are published), and the broker can be stopped and started
+// again on the same port.
+class LocalMqttBroker {
+ public:
+  struct Message {
+    std::string client_id;  // empty for injected messages
+    std::string topic;
+    std::string payload;
+    int qos;
+    bool retained;
+    std::chrono::steady_clock::time_point received;
+  };
+
+  // Called from the broker thread for every PUBLISH a client sends
+  using PublishCallback = std::function<void(const Message& message)>;
+
+  LocalMqttBroker();
+  ~LocalMqttBroker();
+
+  LocalMqttBroker(const LocalMqttBroker&) = delete;
+  LocalMqttBroker& operator=(const LocalMqttBroker&) = delete;
+
+  // Listens on `port`, or on a free one if 0; a restarted broker keeps its
+  // port. Throws std::runtime_error.
+  void start(uint16_t port = 0);
+  // Closes every connection without publishing wills, like a broker crash
+  void stop();
+
+  uint16_t port() const { return port_; }
+  std::string address() const { return "tcp://127.0.0.1:" + std::to_string(port_); }
+
+  // Delay before CONNACK, PUBACK, PUBREC, PUBCOMP, SUBACK and UNSUBACK
+  void set_ack_delay(std::chrono::microseconds delay);
+
+  // Closes all client connections as if the network failed
+  void drop_connections();
+
+  // Delivers a message to subscribers as if another client published it
+  void publish(const std::string& topic, const std::string& payload, bool retained = false, int qos = 0);
+
+  void set_publish_callback(PublishCallback callback);
+
+  // Waits until `count` messages have been published on `topic` in total
+  bool wait_for_messages(const std::string& topic, std::size_t count, std::chrono::milliseconds timeout);
+  bool wait_for_subscription(const std::string& filter, std::chrono::milliseconds timeout);
+
+  std::size_t message_count() const;
+  std::size_t message_count(const std::string& topic) const;
+  std::vector<Message> messages() const;
+  // Latest retained payload of a topic, empty if none
+  std::string retained(const std::string& topic) const;
+  std::size_t connection_count() const;  // accepted CONNECTs since construction
+  std::size_t connected_clients() const;
+
+  static bool topic_matches(const std::string& filter, const std::string& topic);
+
+ private:
+  struct Client;
+  struct PendingSend {
+    std::chrono::steady_clock::time_point due;
+    int fd;
+    std::vector<uint8_t> bytes;
+  };
+
+  uint16_t port_ = 0;
+  int listen_fd_ = -1;
+  int wake_pipe_[2] = {-1, -1};
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::vector<std::unique_ptr<Client>> clients_;
+  std::map<std::string, std::string> retained_;
+  std::vector<Message> messages_;
+  std::map<std::string, std::size_t> topic_counts_;
+  std::vector<Message> injected_;
+  std::vector<PendingSend> pending_;
+  PublishCallback publish_callback_;
+  std::chrono::microseconds ack_delay_{0};
+  bool drop_requested_ = false;
+  std::size_t connection_count_ = 0;
+
+  void run();
+  void wake();
+  void accept_client();
+  bool read_client(Client& client);  // false when the connection is to be closed
+  bool handle_packet(Client& client, uint8_t header, const uint8_t* body, std::size_t length);
+  void route(const Message& message);
+  void close_client(Client& client, bool publish_will);
+  void send(int fd, std::vector<uint8_t> bytes, bool acknowledgement);
+  void flush_pending(std::chrono::steady_clock::time_point now);
+};
@@ -0,0 +1,407 @@
+#include "virtual_slave_farm.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kBitsPerChar = 10;  // 8N1
+constexpr int kMaxReadBits = 2000;
+constexpr int kMaxWriteCoils = 1968;
+
+constexpr uint8_t kIllegalFunction = 0x01;
+constexpr uint8_t kIllegalDataAddress = 0x02;
+constexpr uint8_t kIllegalDataValue = 0x03;
+
+uint16_t crc16(const uint8_t* data, std::size_t length) {
+  uint16_t crc = 0xFFFF;
+  for (std::size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) ? static_cast<uint16_t>((crc >> 1) ^ 0xA001) : static_cast<uint16_t>(crc >> 1);
+    }
+  }
+  return crc;
+}
+
+uint16_t word_at(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+std::vector<uint8_t> exception_reply(const uint8_t* frame, uint8_t code) {
+  return {frame[0], static_cast<uint8_t>(frame[1] | 0x80), code};
+}
+
+}  // namespace
+
+VirtualSlaveFarm::VirtualSlaveFarm(int baudrate, uint32_t seed) : baudrate_(baudrate), rng_(seed) {}
+
+VirtualSlaveFarm::~VirtualSlaveFarm() {
+  stop();
+}
+
+void VirtualSlaveFarm::add_slave(const VirtualSlaveConfig& config) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Slave slave;
+  slave.config = config;
+  slave.inputs.assign(static_cast<std::size_t>(std::max(config.inputs, 0)), 0);
+  slave.coils.assign(static_cast<std::size_t>(std::max(config.coils, 0)), 0);
+  slaves_[config.slave_id] = std::move(slave);
+}
+
+void VirtualSlaveFarm::start() {
+  if (running_) {
+    return;
+  }
+
+  master_fd_ = ::posix_openpt(O_RDWR | O_NOCTTY);
+  if (master_fd_ < 0 || ::grantpt(master_fd_) != 0 || ::unlockpt(master_fd_) != 0) {
+    const std::string error = std::strerror(errno);
+    stop();
+    throw std::runtime_error("Cannot create pty: " + error);
+  }
+
+  char name[128];
+  if (::ptsname_r(master_fd_, name, sizeof(name)) != 0) {
+    stop();
+    throw std::runtime_error("Cannot name pty");
+  }
+  port_ = name;
+
+  slave_fd_ = ::open(port_.c_str(), O_RDWR | O_NOCTTY);
+  if (slave_fd_ < 0) {
+    const std::string error = std::strerror(errno);
+    stop();
+    throw std::runtime_error("Cannot open " + port_ + ": " + error);
+  }
+
+  // No echo or line editing until the client sets up the port itself
+  struct termios tio;
+  ::tcgetattr(slave_fd_, &tio);
+  ::cfmakeraw(&tio);
+  ::tcsetattr(slave_fd_, TCSANOW, &tio);
+
+  ::fcntl(master_fd_, F_SETFL, ::fcntl(master_fd_, F_GETFL) | O_NONBLOCK);
+
+  running_ = true;
+  thread_ = std::thread(&VirtualSlaveFarm::run, this);
+}
+
+void VirtualSlaveFarm::stop() {
+  running_ = false;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  if (slave_fd_ >= 0) {
+    ::close(slave_fd_);
+    slave_fd_ = -1;
+  }
+  if (master_fd_ >= 0) {
+    ::close(master_fd_);
+    master_fd_ = -1;
+  }
+}
+
+void VirtualSlaveFarm::set_input(int slave_id, int address, bool state) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  slaves_.at(slave_id).inputs.at(static_cast<std::size_t>(address)) = state ? 1 : 0;
+}
+
+bool VirtualSlaveFarm::input(int slave_id, int address) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return slaves_.at(slave_id).inputs.at(static_cast<std::size_t>(address)) != 0;
+}
+
+bool VirtualSlaveFarm::coil(int slave_id, int address) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return slaves_.at(slave_id).coils.at(static_cast<std::size_t>(address)) != 0;
+}
+
+void VirtualSlaveFarm::schedule_input(int slave_id, int address, bool state, std::chrono::microseconds delay) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  scheduled_.push_back({std::chrono::steady_clock::now() + delay, slave_id, address, state});
+}
+
+void VirtualSlaveFarm::set_coil_callback(CoilCallback callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  coil_callback_ = std::move(callback);
+}
+
+void VirtualSlaveFarm::set_faults(int slave_id, double crc_error_rate, double timeout_rate) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& config = slaves_.at(slave_id).config;
+  config.crc_error_rate = crc_error_rate;
+  config.timeout_rate = timeout_rate;
+}
+
+VirtualSlaveFarm::Stats VirtualSlaveFarm::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+std::chrono::microseconds VirtualSlaveFarm::wire_time(std::size_t bytes) const {
+  return std::chrono::microseconds(static_cast<int64_t>(bytes) * kBitsPerChar * 1000000 / baudrate_);
+}
+
+void VirtualSlaveFarm::run() {
+  // A frame ends after 3.5 characters of silence; the pty itself delivers
+  // a request in one piece, so this only clears out garbage
+  const auto silence = std::max<int64_t>(2, (wire_time(4).count() + 999) / 1000);
+
+  std::vector<uint8_t> buffer;
+  uint8_t chunk[512];
+
+  while (running_) {
+    pollfd pfd = {master_fd_, POLLIN, 0};
+    const int rc = ::poll(&pfd, 1, static_cast<int>(silence));
+
+    apply_scheduled();
+
+    if (rc <= 0) {
+      if (!buffer.empty()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bad_requests++;
+        buffer.clear();
+      }
+      continue;
+    }
+
+    const ssize_t n = ::read(master_fd_, chunk, sizeof(chunk));
+    if (n <= 0) {
+      continue;
+    }
+    buffer.insert(buffer.end(), chunk, chunk + n);
+
+    while (!buffer.empty()) {
+      const int length = frame_length(buffer);
+      if (length == 0) {
+        break;
+      }
+      if (length < 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bad_requests++;
+        buffer.clear();
+        break;
+      }
+      handle_frame(buffer.data(), static_cast<std::size_t>(length));
+      buffer.erase(buffer.begin(), buffer.begin() + length);
+    }
+  }
+}
+
+void VirtualSlaveFarm::apply_scheduled() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (scheduled_.empty()) {
+    return;
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  auto due = std::stable_partition(scheduled_.begin(), scheduled_.end(),
+                                   [now](const ScheduledInput& s) { return s.at > now; });
+  for (auto it = due; it != scheduled_.end(); ++it) {
+    auto slave = slaves_.find(it->slave_id);
+    if (slave != slaves_.end() && it->address >= 0 &&
+        static_cast<std::size_t>(it->address) < slave->second.inputs.size()) {
+      slave->second.inputs[static_cast<std::size_t>(it->address)] = it->state ? 1 : 0;
+    }
+  }
+  scheduled_.erase(due, scheduled_.end());
+}
+
+int VirtualSlaveFarm::frame_length(const std::vector<uint8_t>& buffer) const {
+  if (buffer.size() < 2) {
+    return 0;
+  }
+
+  switch (buffer[1]) {
+    case 0x01:
+    case 0x02:
+    case 0x03:
+    case 0x04:
+    case 0x05:
+    case 0x06:
+      return buffer.size() >= 8 ? 8 : 0;
+    case 0x0F:
+    case 0x10: {
+      if (buffer.size() < 7) {
+        return 0;
+      }
+      const int length = 9 + buffer[6];
+      return static_cast<int>(buffer.size()) >= length ? length : 0;
+    }
+    default:
+      return -1;
+  }
+}
+
+void VirtualSlaveFarm::handle_frame(const uint8_t* frame, std::size_t length) {
+  const uint16_t crc = static_cast<uint16_t>(frame[length - 2] | (frame[length - 1] << 8));
+
+  std::vector<CoilChange> changed;  // reported after the lock is released
+  std::vector<uint8_t> reply;
+  std::chrono::microseconds delay{0};
+  bool corrupt = false;
+  const int unit = frame[0];
+  CoilCallback callback;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (crc16(frame, length - 2) != crc) {
+      stats_.bad_requests++;
+      return;
+    }
+    stats_.requests++;
+    callback = coil_callback_;
+
+    if (unit == 0) {
+      // Broadcast: only writes make sense, nobody answers
+      stats_.broadcasts++;
+      if (frame[1] == 0x05 || frame[1] == 0x0F) {
+        for (auto& entry : slaves_) {
+          execute(entry.second, frame, changed);
+        }
+      }
+    } else {
+      auto it = slaves_.find(unit);
+      if (it == slaves_.end()) {
+        stats_.unknown_slave++;
+        return;
+      }
+      Slave& slave = it->second;
+
+      std::uniform_real_distribution<double> chance(0.0, 1.0);
+      if (chance(rng_) < slave.config.timeout_rate) {
+        stats_.timeouts++;
+        return;
+      }
+
+      reply = execute(slave, frame, changed);
+      corrupt = chance(rng_) < slave.config.crc_error_rate;
+      if (corrupt) {
+        stats_.crc_errors++;
+      }
+      if (reply[1] & 0x80) {
+        stats_.exceptions++;
+      }
+      stats_.replies++;
+      delay = wire_time(length) + slave.config.latency + wire_time(reply.size() + 2);
+    }
+  }
+
+  if (callback) {
+    for (const auto& change : changed) {
+      callback(change.slave_id, change.address, change.state);
+    }
+  }
+
+  if (!reply.empty()) {
+    send(std::move(reply), delay, corrupt);
+  }
+}
+
+std::vector<uint8_t> VirtualSlaveFarm::execute(Slave& slave, const uint8_t* frame, std::vector<CoilChange>& changed) {
+  const uint8_t function = frame[1];
+  const auto& supported = slave.config.function_codes;
+  if (std::find(supported.begin(), supported.end(), function) == supported.end()) {
+    return exception_reply(frame, kIllegalFunction);
+  }
+
+  const int address = word_at(frame + 2);
+
+  switch (function) {
+    case 0x01:
+    case 0x02: {
+      const auto& table = (function == 0x01) ? slave.coils : slave.inputs;
+      const int count = word_at(frame + 4);
+      if (count < 1 || count > kMaxReadBits) {
+        return exception_reply(frame, kIllegalDataValue);
+      }
+      if (static_cast<std::size_t>(address + count) > table.size()) {
+        return exception_reply(frame, kIllegalDataAddress);
+      }
+
+      std::vector<uint8_t> reply = {frame[0], function, static_cast<uint8_t>((count + 7) / 8)};
+      reply.resize(3 + reply[2], 0);
+      for (int i = 0; i < count; i++) {
+        if (table[static_cast<std::size_t>(address + i)]) {
+          reply[3 + i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+        }
+      }
+      return reply;
+    }
+
+    case 0x05: {
+      const uint16_t value = word_at(frame + 4);
+      if (value != 0xFF00 && value != 0x0000) {
+        return exception_reply(frame, kIllegalDataValue);
+      }
+      if (static_cast<std::size_t>(address) >= slave.coils.size()) {
+        return exception_reply(frame, kIllegalDataAddress);
+      }
+      const uint8_t state = value ? 1 : 0;
+      write_coils(slave, address, 1, &state, changed);
+      return std::vector<uint8_t>(frame, frame + 6);
+    }
+
+    case 0x0F: {
+      const int count = word_at(frame + 4);
+      if (count < 1 || count > kMaxWriteCoils || frame[6] != (count + 7) / 8) {
+        return exception_reply(frame, kIllegalDataValue);
+      }
+      if (static_cast<std::size_t>(address + count) > slave.coils.size()) {
+        return exception_reply(frame, kIllegalDataAddress);
+      }
+      std::vector<uint8_t> states(static_cast<std::size_t>(count));
+      for (int i = 0; i < count; i++) {
+        states[static_cast<std::size_t>(i)] = (frame[7 + i / 8] >> (i % 8)) & 1;
+      }
+      write_coils(slave, address, count, states.data(), changed);
+      return std::vector<uint8_t>(frame, frame + 6);
+    }
+
+    default:
+      return exception_reply(frame, kIllegalFunction);
+  }
+}
+
+void VirtualSlaveFarm::write_coils(Slave& slave, int address, int count, const uint8_t* values,
+                                   std::vector<CoilChange>& changed) {
+  for (int i = 0; i < count; i++) {
+    uint8_t& coil = slave.coils[static_cast<std::size_t>(address + i)];
+    if (coil != values[i]) {
+      coil = values[i];
+      changed.push_back({slave.config.slave_id, address + i, coil != 0});
+    }
+  }
+}
+
+void VirtualSlaveFarm::send(std::vector<uint8_t> reply, std::chrono::microseconds delay, bool corrupt) {
+  const uint16_t crc = crc16(reply.data(), reply.size());
+  reply.push_back(static_cast<uint8_t>(crc & 0xFF));
+  reply.push_back(static_cast<uint8_t>(crc >> 8));
+  if (corrupt) {
+    reply.back() ^= 0xFF;
+  }
+
+  // The bus is busy for the whole transaction
+  std::this_thread::sleep_for(delay);
+
+  std::size_t written = 0;
+  while (written < reply.size()) {
+    const ssize_t n = ::write(master_fd_, reply.data() + written, reply.size() - written);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    written += static_cast<std::size_t>(n);
+  }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Behaviour of one simulated RTU slave
+struct VirtualSlaveConfig {
+  int slave_id = 1;
+  int inputs = 8;
+  int coils = 8;
+  std::vector<int> function_codes = {0x01, 0x02, 0x05, 0x0F};  // others get ILLEGAL FUNCTION
+  std::chrono::microseconds latency{0};                       // processing time before each reply
+  double crc_error_rate = 0.0;                                // fraction of replies sent with a bad CRC
+  double timeout_rate = 0.0;                                  // fraction of requests left unanswered
+};
+
+// A Modbus RTU bus on a pseudo terminal with simulated slaves on the far
+// side. Point ModbusManager at port() like at a USB adapter.
+//
+// Replies are held back for the time the request and the reply would take
+// on the wire at the configured baud rate (8N1, 10 bits per character)
+// plus the slave's latency, so transaction times match a real bus. Frames
+// are parsed here rather than with libmodbus' server API, which answers a
+// single unit id per context and cannot corrupt or withhold replies.
+//
+// Requests to unit id 0 are broadcasts: writes are applied to every slave
+// and never answered.
+class VirtualSlaveFarm {
+ public:
+  struct Stats {
+    uint64_t requests = 0;       // frames with a valid CRC
+    uint64_t replies = 0;        // including exceptions and corrupted ones
+    uint64_t exceptions = 0;
+    uint64_t crc_errors = 0;     // replies corrupted on purpose
+    uint64_t timeouts = 0;       // requests left unanswered on purpose
+    uint64_t bad_requests = 0;   // CRC mismatch or garbage on the line
+    uint64_t unknown_slave = 0;  // addressed to a unit id nobody has
+    uint64_t broadcasts = 0;
+  };
+
+  // Called from the farm thread after a coil changed
+  using CoilCallback = std::function<void(int slave_id, int address, bool state)>;
+
+  explicit VirtualSlaveFarm(int baudrate = 19200, uint32_t seed = 1);
+  ~VirtualSlaveFarm();
+
+  VirtualSlaveFarm(const VirtualSlaveFarm&) = delete;
+  VirtualSlaveFarm& operator=(const VirtualSlaveFarm&) = delete;
+
+  void add_slave(const VirtualSlaveConfig& config);
+
+  // Opens the pty and starts answering. Throws std::runtime_error.
+  void start();
+  void stop();
+
+  // Device path of the bus, valid after start()
+  const std::string& port() const { return port_; }
+  int baudrate() const { return baudrate_; }
+
+  void set_input(int slave_id, int address, bool state);
+  bool input(int slave_id, int address) const;
+  bool coil(int slave_id, int address) const;
+
+  // Flips an input `delay` from now, from the farm thread
+  void schedule_input(int slave_id, int address, bool state, std::chrono::microseconds delay);
+
+  void set_coil_callback(CoilCallback callback);
+
+  // Changes the fault rates of a running slave
+  void set_faults(int slave_id, double crc_error_rate, double timeout_rate);
+
+  Stats stats() const;
+
+  // Time `bytes` characters take on the wire at the farm's baud rate
+  std::chrono::microseconds wire_time(std::size_t bytes) const;
+
+ private:
+  struct Slave {
+    VirtualSlaveConfig config;
+    std::vector<uint8_t> inputs;
+    std::vector<uint8_t> coils;
+  };
+
+  struct CoilChange {
+    int slave_id;
+    int address;
+    bool state;
+  };
+
+  struct ScheduledInput {
+    std::chrono::steady_clock::time_point at;
+    int slave_id;
+    int address;
+    bool state;
+  };
+
+  int baudrate_;
+  std::string port_;
+  int master_fd_ = -1;
+  int slave_fd_ = -1;  // held open so the master never sees a hangup between clients
+
+  mutable std::mutex mutex_;
+  std::map<int, Slave> slaves_;
+  std::vector<ScheduledInput> scheduled_;
+  CoilCallback coil_callback_;
+  Stats stats_;
+  std::mt19937 rng_;
+
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+
+  void run();
+  void apply_scheduled();
+  // Length of the request at the start of `buffer`; 0 if incomplete, -1 if unparseable
+  int frame_length(const std::vector<uint8_t>& buffer) const;
+  void handle_frame(const uint8_t* frame, std::size_t length);
+  std::vector<uint8_t> execute(Slave& slave, const uint8_t* frame, std::vector<CoilChange>& changed);
+  void write_coils(Slave& slave, int address, int count, const uint8_t* values, std::vector<CoilChange>& changed);
+  void send(std::vector<uint8_t> reply, std::chrono::microseconds delay, bool corrupt);
+};
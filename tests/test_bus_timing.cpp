@@ -0,0 +1,114 @@
+#include "bus_timing.hpp"
+#include "point_table.hpp"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+ModbusConfig line(int baudrate, char parity = 'N') {
+  ModbusConfig config;
+  config.baudrate = baudrate;
+  config.parity = parity;
+  config.data_bits = 8;
+  config.stop_bits = 1;
+  config.response_timeout_ms = 0;
+  config.byte_timeout_ms = 0;
+  return config;
+}
+
+double ms(std::chrono::nanoseconds d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+}  // namespace
+
+TEST(BusTimingTest, CharacterTimeFollowsFraming) {
+  EXPECT_EQ(BusTiming(line(9600)).bits_per_character(), 10);
+  EXPECT_EQ(BusTiming(line(9600, 'E')).bits_per_character(), 11);
+  EXPECT_NEAR(ms(BusTiming(line(9600)).character_time()), 1.0417, 0.001);
+}
+
+TEST(BusTimingTest, FrameGapIsFixedAbove19200) {
+  EXPECT_NEAR(ms(BusTiming(line(9600)).frame_gap()), 3.646, 0.001);
+  EXPECT_EQ(BusTiming(line(115200)).frame_gap(), std::chrono::microseconds(1750));
+}
+
+TEST(BusTimingTest, ReadRoundTripAt9600) {
+  const BusTiming timing(line(9600), std::chrono::microseconds(0));
+
+  // FC02 for 8 inputs: 8 byte request, 6 byte reply, a gap after each
+  EXPECT_EQ(BusTiming::read_bits_response_size(8), 6u);
+  EXPECT_EQ(BusTiming::read_bits_response_size(9), 7u);
+  EXPECT_NEAR(ms(timing.read_time(8)), 14 * 1.0417 + 2 * 3.646, 0.01);
+
+  EXPECT_GT(timing.write_time(ModbusFunction::WRITE_MULTIPLE_COILS),
+            timing.write_time(ModbusFunction::WRITE_SINGLE_COIL));
+}
+
+TEST(BusTimingTest, CycleFollowsReadPlan) {
+  std::vector<DigitalInput> inputs;
+  for (int address = 0; address < 16; address++) {
+    inputs.push_back({1, address, "a" + std::to_string(address), "a/" + std::to_string(address)});
+    inputs.push_back({2, address, "b" + std::to_string(address), "b/" + std::to_string(address)});
+  }
+  std::vector<Relay> relays = {{1, 0, "relay", "relay/set", "relay/state"}};
+
+  // Slave 2 reads all 16 inputs at once
+  nlohmann::json config = {{"slaves", {{{"slave_id", "2"}, {"profile", "di16"}}}}};
+  std::vector<ConfigDiagnostic> diagnostics;
+  DeviceCatalog catalog;
+  catalog.load(config, diagnostics);
+  const PointTable points = compile_points(inputs, relays, diagnostics, {}, catalog);
+  ASSERT_TRUE(diagnostics.empty());
+
+  PollingConfig polling;
+  polling.poll_interval_ms = 100;
+  polling.max_commands_per_cycle = 4;
+
+  const BusTiming timing(line(9600));
+  const CycleBudget budget = plan_cycle(points, polling, timing);
+  EXPECT_EQ(budget.read_requests, 3u);
+  EXPECT_EQ(budget.poll_time, 2 * timing.read_time(8) + timing.read_time(16));
+  EXPECT_EQ(budget.command_time, 4 * timing.write_time(ModbusFunction::WRITE_SINGLE_COIL));
+  EXPECT_TRUE(budget.feasible());
+  EXPECT_NEAR(budget.utilization(), ms(budget.poll_time) / 100.0, 1e-9);
+
+  polling.poll_interval_ms = 50;
+  EXPECT_FALSE(plan_cycle(points, polling, timing).feasible());
+}
+
+TEST(BusTimingTest, DerivesTimeoutsFromBaudRate) {
+  using std::chrono::microseconds;
+
+  // 9600 8N1: response the 10 byte FC15 request and its gap, one character
+  // and the slave allowance; twice t3.5 is below the 20 ms byte floor
+  ModbusConfig config = line(9600);
+  RtuTimeouts timeouts = rtu_timeouts(config);
+  EXPECT_EQ(timeouts.byte, microseconds(20000));
+  EXPECT_NEAR(ms(timeouts.response), 11 * 1.0417 + 3.646 + 50, 0.01);
+  EXPECT_EQ(timeouts.read_retry_delay, timeouts.byte);
+  EXPECT_EQ(rtu_timeouts(line(115200)).byte, microseconds(20000));
+
+  // The largest broadcast (1968 coils) fills an RTU frame
+  EXPECT_EQ(BusTiming::write_coils_request_size(1),
+            BusTiming::write_coil_request_size(ModbusFunction::WRITE_MULTIPLE_COILS));
+  EXPECT_EQ(BusTiming::write_coils_request_size(1968), 255u);
+
+  // Slow lines: byte timeout twice t3.5
+  EXPECT_NEAR(ms(rtu_timeouts(line(1200)).byte), 58.333, 0.01);
+
+  // Per-bus overrides
+  config.byte_timeout_ms = 30;
+  timeouts = rtu_timeouts(config);
+  EXPECT_EQ(timeouts.byte, microseconds(30000));
+  EXPECT_EQ(timeouts.write_retry_delay, microseconds(30000));
+  EXPECT_LT(timeouts.response, microseconds(100000));
+
+  config.timing = "fixed";
+  config.response_timeout_ms = 300;
+  config.byte_timeout_ms = 100;
+  timeouts = rtu_timeouts(config);
+  EXPECT_EQ(timeouts.response, microseconds(300000));
+  EXPECT_EQ(timeouts.byte, microseconds(100000));
+  EXPECT_EQ(timeouts.write_retry_delay, microseconds(50000));
+}
@@ -0,0 +1,73 @@
+#include "clock.hpp"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+TEST(VirtualClockTest, OnlyMovesWhenAdvanced) {
+  VirtualClock clock;
+  const auto start = clock.now();
+
+  clock.advance(std::chrono::hours(1));
+  EXPECT_EQ(clock.now() - start, std::chrono::hours(1));
+  EXPECT_GT(start, Clock::time_point{} + std::chrono::hours(1));  // "never" stays long ago
+}
+
+TEST(VirtualClockTest, AutoAdvanceSleepsInstantly) {
+  VirtualClock clock;
+  clock.set_auto_advance(true);
+  const auto start = clock.now();
+
+  const auto real_start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 3600; i++) {
+    clock.sleep_for(std::chrono::seconds(1));
+  }
+  EXPECT_EQ(clock.now() - start, std::chrono::hours(1));
+  EXPECT_LT(std::chrono::steady_clock::now() - real_start, std::chrono::seconds(1));
+}
+
+TEST(VirtualClockTest, AdvanceWakesSleeper) {
+  VirtualClock clock;
+  const auto start = clock.now();
+
+  std::thread sleeper([&clock] { clock.sleep_for(std::chrono::seconds(10)); });
+  while (clock.sleepers() == 0) {
+    std::this_thread::yield();
+  }
+
+  clock.advance(std::chrono::seconds(5));
+  EXPECT_EQ(clock.sleepers(), 1u);
+  clock.advance(std::chrono::seconds(5));
+  sleeper.join();
+  EXPECT_EQ(clock.now() - start, std::chrono::seconds(10));
+}
+
+TEST(VirtualClockTest, AdvanceToNextInterleavesSleepers) {
+  VirtualClock clock;
+  const auto start = clock.now();
+  std::vector<int> wakeups;  // seconds since start, in wake order
+  std::mutex mutex;
+
+  auto loop = [&](std::chrono::seconds period, int count) {
+    for (int i = 0; i < count; i++) {
+      clock.sleep_for(period);
+      std::lock_guard<std::mutex> lock(mutex);
+      wakeups.push_back(static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(clock.now() - start).count()));
+    }
+  };
+  std::thread fast(loop, std::chrono::seconds(2), 5);
+  std::thread slow(loop, std::chrono::seconds(5), 2);
+
+  // 2, 4, 5, 6, 8 and 10 s, where both wake
+  for (int step = 0; step < 6; step++) {
+    ASSERT_TRUE(clock.advance_to_next(2));
+  }
+  fast.join();
+  slow.join();
+
+  EXPECT_EQ(clock.now() - start, std::chrono::seconds(10));
+  EXPECT_EQ(wakeups.size(), 7u);
+  EXPECT_TRUE(std::is_sorted(wakeups.begin(), wakeups.end()));
+}
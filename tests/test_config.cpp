@@ -1,5 +1,6 @@
 #include "config.hpp"
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
@@ -137,12 +138,24 @@ TEST_F(ConfigTest, DefaultValues) {
   EXPECT_EQ(config.modbus().port, "/dev/ttyUSB0");
   EXPECT_EQ(config.modbus().baudrate, 9600);
   EXPECT_EQ(config.modbus().parity, 'N');
+  EXPECT_EQ(config.modbus().timing, "auto");
+  EXPECT_EQ(config.modbus().response_timeout_ms, 0);  // derived from the baud rate
+  EXPECT_EQ(config.modbus().byte_timeout_ms, 0);
 
   EXPECT_EQ(config.mqtt().broker_address, "tcp://localhost:1883");
   EXPECT_EQ(config.mqtt().client_id, "modbus_poller");
 
   EXPECT_EQ(config.polling().poll_interval_ms, 400);
   EXPECT_EQ(config.polling().refresh_interval_sec, 10);
+
+  EXPECT_FALSE(config.metrics().enabled);
+  EXPECT_EQ(config.metrics().bind_address, "127.0.0.1");
+  EXPECT_EQ(config.metrics().port, 9105);
+
+  EXPECT_TRUE(config.logging().async);
+  EXPECT_EQ(config.logging().overflow_policy, "drop");
+  EXPECT_EQ(config.logging().level, "info");
+  EXPECT_EQ(config.logging().control_topic, "modbus/poller/log");
 }
 
 TEST_F(ConfigTest, SaveConfig) {
@@ -194,3 +207,212 @@ TEST_F(ConfigTest, AutoGenerateMqttTopics) {
   EXPECT_EQ(config.relays()[0].mqtt_command_topic, "modbus/relay/light1/set");
   EXPECT_EQ(config.relays()[0].mqtt_state_topic, "modbus/relay/light1/state");
 }
+
+TEST_F(ConfigTest, DiffDetectsChangedSections) {
+  create_valid_config();
+  Config before(test_config_file_);
+
+  nlohmann::json j = before.to_json();
+  j["modbus"]["response_timeout_ms"] = 500;
+  j["relays"][0]["mqtt_command_topic"] = "test/lamp/set";
+  j["digital_inputs"].push_back({{"slave_id", 2}, {"address", 0}, {"name", "input2"}});
+  std::ofstream(test_config_file_) << j.dump();
+  Config after(test_config_file_);
+
+  ConfigDiff diff = diff_config(before, after);
+  EXPECT_TRUE(diff.modbus);
+  EXPECT_FALSE(diff.mqtt);
+  EXPECT_FALSE(diff.polling);
+  EXPECT_EQ(diff.inputs_added, 1);
+  EXPECT_EQ(diff.inputs_removed, 0);
+  EXPECT_EQ(diff.relays_changed, 1);
+  EXPECT_TRUE(diff.points_changed());
+}
+
+TEST_F(ConfigTest, DiffOfIdenticalConfigIsEmpty) {
+  create_valid_config();
+  Config a(test_config_file_);
+  Config b(test_config_file_);
+
+  EXPECT_TRUE(diff_config(a, b).empty());
+}
+
+TEST_F(ConfigTest, RejectsInvalidPointsWithPaths) {
+  std::ofstream file(test_config_file_);
+  file << R"({
+        "modbus": {"parity": "X"},
+        "mqtt": {},
+        "polling": {},
+        "digital_inputs": [
+            {"slave_id": 1, "address": 0, "name": "in"}
+        ],
+        "relays": [
+            {"slave_id": 1, "address": 0, "name": "light"},
+            {"slave_id": 1, "address": 1, "name": "light"}
+        ]
+    })";
+  file.close();
+
+  try {
+    Config config(test_config_file_);
+    FAIL() << "expected ConfigError";
+  } catch (const ConfigError& e) {
+    std::vector<std::string> paths;
+    for (const auto& diagnostic : e.diagnostics()) {
+      paths.push_back(diagnostic.path);
+    }
+    EXPECT_NE(std::find(paths.begin(), paths.end(), "/modbus/parity"), paths.end());
+    EXPECT_NE(std::find(paths.begin(), paths.end(), "/relays/1/name"), paths.end());
+    EXPECT_NE(std::string(e.what()).find("/relays/1/name"), std::string::npos);
+  }
+}
+
+TEST_F(ConfigTest, ReportsMissingPointFields) {
+  std::ofstream file(test_config_file_);
+  file << R"({
+        "modbus": {},
+        "mqtt": {},
+        "polling": {},
+        "digital_inputs": [
+            {"slave_id": 1, "address": 0, "name": "ok"},
+            {"slave_id": 1, "name": "no_address"}
+        ],
+        "relays": []
+    })";
+  file.close();
+
+  try {
+    Config config(test_config_file_);
+    FAIL() << "expected ConfigError";
+  } catch (const ConfigError& e) {
+    ASSERT_EQ(e.diagnostics().size(), 1u);
+    EXPECT_EQ(e.diagnostics()[0].path, "/digital_inputs/1");
+  }
+}
+
+TEST_F(ConfigTest, ExpandsRangesAtLoad) {
+  std::ofstream file(test_config_file_);
+  file << R"({
+        "modbus": {},
+        "mqtt": {},
+        "polling": {},
+        "digital_inputs": [
+            {"slave_id": "48-51", "address": "0-7", "name": "button_{slave}_{address}"}
+        ],
+        "relays": [
+            {"slave_id": 32, "address": "0-31", "name": "relay_{address}"}
+        ]
+    })";
+  file.close();
+
+  Config config(test_config_file_);
+  EXPECT_EQ(config.inputs().size(), 32u);
+  EXPECT_EQ(config.relays().size(), 32u);
+  EXPECT_EQ(config.relays()[31].name, "relay_31");
+}
+
+TEST_F(ConfigTest, AssignsDeviceProfilesFromModules) {
+  std::ofstream file(test_config_file_);
+  file << R"({
+        "modbus": {},
+        "mqtt": {},
+        "polling": {},
+        "templates": {
+            "buttons": {"profile": "di8", "digital_inputs": [{"address": "0-7", "name": "{module}_{address}"}]}
+        },
+        "modules": [{"template": "buttons", "slave_id": "48-49", "name": "b{slave}"}],
+        "relays": [{"slave_id": 48, "address": 0, "name": "wrong"}]
+    })";
+  file.close();
+
+  try {
+    Config config(test_config_file_);
+    FAIL() << "expected ConfigError";
+  } catch (const ConfigError& e) {
+    ASSERT_EQ(e.diagnostics().size(), 1u);
+    EXPECT_EQ(e.diagnostics()[0].path, "/relays/0/slave_id");
+  }
+}
+
+TEST_F(ConfigTest, WarnsWhenPollPlanExceedsInterval) {
+  // 32 slaves, one FC02 read each at ~23 ms: about 750 ms per cycle at 9600 baud
+  std::ofstream file(test_config_file_);
+  file << R"({
+        "modbus": {"baudrate": 9600},
+        "mqtt": {},
+        "polling": {"poll_interval_ms": 100},
+        "digital_inputs": [
+            {"slave_id": "1-32", "address": "0-7", "name": "button_{slave}_{address}"}
+        ],
+        "relays": []
+    })";
+  file.close();
+
+  Config config(test_config_file_);
+  ASSERT_EQ(config.diagnostics().size(), 1u);
+  EXPECT_EQ(config.diagnostics()[0].path, "/polling/poll_interval_ms");
+  EXPECT_NE(config.diagnostics()[0].message.find("32 requests"), std::string::npos);
+}
+
+TEST_F(ConfigTest, FixedTimingKeepsLegacyTimeouts) {
+  auto write = [this](const std::string& modbus) {
+    std::ofstream file(test_config_file_);
+    file << R"({"modbus": )" << modbus << R"(, "mqtt": {}, "polling": {}, "digital_inputs": [], "relays": []})";
+  };
+
+  write(R"({"timing": "fixed"})");
+  Config config(test_config_file_);
+  EXPECT_EQ(config.modbus().response_timeout_ms, 300);
+  EXPECT_EQ(config.modbus().byte_timeout_ms, 100);
+
+  write(R"({"timing": "fixed", "byte_timeout_ms": 0})");
+  EXPECT_THROW({ Config fixed(test_config_file_); }, ConfigError);
+  write(R"({"timing": "manual"})");
+  EXPECT_THROW({ Config unknown(test_config_file_); }, ConfigError);
+  write(R"({"byte_timeout_ms": -1})");
+  EXPECT_THROW({ Config negative(test_config_file_); }, ConfigError);
+}
+
+TEST_F(ConfigTest, LoadsBroadcastGroups) {
+  std::ofstream file(test_config_file_);
+  file << R"({
+        "modbus": {},
+        "mqtt": {},
+        "polling": {},
+        "digital_inputs": [],
+        "relays": [{"slave_id": "1-4", "address": "0-3", "name": "light_{slave}_{address}"}],
+        "broadcast_groups": [{"name": "all_lights", "address": 0, "count": 4, "verify": false}]
+    })";
+  file.close();
+
+  Config config(test_config_file_);
+  ASSERT_EQ(config.broadcast_groups().size(), 1u);
+  EXPECT_EQ(config.broadcast_groups()[0].mqtt_command_topic, "modbus/group/all_lights/set");
+  EXPECT_FALSE(config.broadcast_groups()[0].verify);
+  EXPECT_EQ(config.to_json()["broadcast_groups"][0]["count"], 4);
+}
+
+TEST_F(ConfigTest, RejectsUnusableLoggingLimits) {
+  std::ofstream file(test_config_file_);
+  file << R"({
+        "modbus": {},
+        "mqtt": {},
+        "polling": {},
+        "logging": {"queue_size": -1, "file": {"max_size_mb": 0, "max_files": -2}},
+        "digital_inputs": [],
+        "relays": []
+    })";
+  file.close();
+
+  try {
+    Config config(test_config_file_);
+    FAIL() << "expected ConfigError";
+  } catch (const ConfigError& e) {
+    std::vector<std::string> paths;
+    for (const auto& d : e.diagnostics()) {
+      paths.push_back(d.path);
+    }
+    EXPECT_EQ(paths, (std::vector<std::string>{"/logging/queue_size", "/logging/file/max_size_mb",
+                                               "/logging/file/max_files"}));
+  }
+}
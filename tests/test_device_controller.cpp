@@ -1,9 +1,14 @@
 #include "device_controller.hpp"
 #include "modbus_manager_mock.hpp"
 #include "mqtt_manager_mock.hpp"
+#include "point_factories.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <csignal>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <thread>
 
 using ::testing::_;
 using ::testing::DoAll;
@@ -193,3 +198,282 @@ TEST_F(DeviceControllerTest, PayloadParsing) {
 
   controller.process_relay_commands();
 }
+
+TEST_F(DeviceControllerTest, ReloadSwapsCommandRoutes) {
+  DeviceController controller(inputs_, relays_, polling_config_, *mock_modbus_, *mock_mqtt_);
+
+  std::vector<Relay> relays = relays_;
+  relays[0].name = "lamp";
+  relays[0].mqtt_command_topic = "test/lamp/set";
+  relays[0].mqtt_state_topic = "test/lamp/state";
+  controller.reload(std::make_shared<const PointTable>(compile_points(inputs_, relays)), polling_config_);
+
+  auto topics = controller.command_topics();
+  EXPECT_NE(std::find(topics.begin(), topics.end(), "test/lamp/set"), topics.end());
+  EXPECT_EQ(std::find(topics.begin(), topics.end(), "test/relay1/set"), topics.end());
+
+  // Old route is gone, the new one reaches the same coil
+  controller.handle_mqtt_command("test/relay1/set", "ON");
+  controller.handle_mqtt_command("test/lamp/set", "ON");
+
+  EXPECT_CALL(*mock_modbus_, write_coil(1, 0, true)).Times(1).WillOnce(Return(true));
+  EXPECT_CALL(*mock_mqtt_, publish("test/lamp/state", "ON", true)).Times(1).WillOnce(Return(true));
+  controller.process_relay_commands();
+}
+
+TEST_F(DeviceControllerTest, ReloadKeepsStateOfUnchangedSlave) {
+  std::array<uint8_t, 8> input_states = {1, 0, 0, 0, 0, 0, 0, 0};
+  EXPECT_CALL(*mock_modbus_, read_discrete_inputs(1, 0, _))
+      .WillRepeatedly([input_states](int, int, std::array<uint8_t, 8>& dest) {
+        dest = input_states;
+        return true;
+      });
+  EXPECT_CALL(*mock_mqtt_, publish("test/input1/state", "ON", true)).Times(1).WillOnce(Return(true));
+
+  DeviceController controller(inputs_, relays_, polling_config_, *mock_modbus_, *mock_mqtt_);
+  controller.poll_inputs();
+
+  // Only the relay changed; the inputs are not republished
+  std::vector<Relay> relays = relays_;
+  relays[0].mqtt_state_topic = "test/relay1/status";
+  controller.reload(std::make_shared<const PointTable>(compile_points(inputs_, relays)), polling_config_);
+  controller.poll_inputs();
+}
+
+TEST_F(DeviceControllerTest, ReloadRepublishesChangedSlave) {
+  std::array<uint8_t, 8> input_states = {1, 0, 1, 0, 0, 0, 0, 0};
+  EXPECT_CALL(*mock_modbus_, read_discrete_inputs(1, 0, _))
+      .WillRepeatedly([input_states](int, int, std::array<uint8_t, 8>& dest) {
+        dest = input_states;
+        return true;
+      });
+  EXPECT_CALL(*mock_mqtt_, publish("test/input1/state", "ON", true)).Times(2).WillRepeatedly(Return(true));
+  // Full state after the layout change, including the unchanged OFF input
+  EXPECT_CALL(*mock_mqtt_, publish("test/input2/state", "OFF", true)).Times(1).WillOnce(Return(true));
+  EXPECT_CALL(*mock_mqtt_, publish("test/input3/state", "ON", true)).Times(1).WillOnce(Return(true));
+
+  DeviceController controller(inputs_, relays_, polling_config_, *mock_modbus_, *mock_mqtt_);
+  controller.poll_inputs();
+
+  std::vector<DigitalInput> inputs = inputs_;
+  DigitalInput input3;
+  input3.slave_id = 1;
+  input3.address = 2;
+  input3.name = "input3";
+  input3.mqtt_topic = "test/input3/state";
+  inputs.push_back(input3);
+  controller.reload(std::make_shared<const PointTable>(compile_points(inputs, relays_)), polling_config_);
+  controller.poll_inputs();
+}
+
+TEST_F(DeviceControllerTest, SynchronizePublishesFullState) {
+  std::array<uint8_t, 8> input_states = {0, 1, 0, 0, 0, 0, 0, 0};
+  EXPECT_CALL(*mock_modbus_, read_discrete_inputs(1, 0, _))
+      .WillRepeatedly([input_states](int, int, std::array<uint8_t, 8>& dest) {
+        dest = input_states;
+        return true;
+      });
+  EXPECT_CALL(*mock_modbus_, read_coils(1, 0, 1, _)).WillOnce([](int, int, int, uint8_t* dest) {
+    dest[0] = 1;
+    return true;
+  });
+
+  // Unchanged OFF inputs and the relay are published too, each once
+  EXPECT_CALL(*mock_mqtt_, publish("test/input1/state", "OFF", true)).WillOnce(Return(true));
+  EXPECT_CALL(*mock_mqtt_, publish("test/input2/state", "ON", true)).WillOnce(Return(true));
+  EXPECT_CALL(*mock_mqtt_, publish("test/relay1/state", "ON", true)).WillOnce(Return(true));
+
+  DeviceController controller(inputs_, relays_, polling_config_, *mock_modbus_, *mock_mqtt_);
+  EXPECT_TRUE(controller.synchronize(std::chrono::steady_clock::now()));
+
+  // Nothing changed since the sync
+  controller.poll_inputs();
+}
+
+TEST_F(DeviceControllerTest, SynchronizeSkipsBroadcastRelays) {
+  EXPECT_CALL(*mock_modbus_, read_discrete_inputs(1, 0, _)).WillOnce([](int, int, std::array<uint8_t, 8>& dest) {
+    dest.fill(0);
+    return true;
+  });
+  EXPECT_CALL(*mock_modbus_, read_coils(1, 0, 1, _)).WillOnce(Return(true));
+  EXPECT_CALL(*mock_modbus_, read_coils(0, _, _, _)).Times(0);
+  EXPECT_CALL(*mock_mqtt_, publish(_, _, true)).WillRepeatedly(Return(true));
+
+  // Write-only: its state stays unknown without making the sync incomplete
+  std::vector<Relay> relays = relays_;
+  relays.push_back(relays_[0]);
+  relays.back().slave_id = 0;
+  relays.back().name = "all_off";
+  relays.back().mqtt_command_topic = "test/all_off/set";
+  relays.back().mqtt_state_topic = "test/all_off/state";
+
+  DeviceController controller(inputs_, relays, polling_config_, *mock_modbus_, *mock_mqtt_);
+  EXPECT_TRUE(controller.synchronize(std::chrono::steady_clock::now()));
+}
+
+TEST_F(DeviceControllerTest, SynchronizeFailureRefreshesOnFirstPoll) {
+  std::array<uint8_t, 8> input_states = {0, 0, 0, 0, 0, 0, 0, 0};
+  EXPECT_CALL(*mock_modbus_, read_discrete_inputs(1, 0, _))
+      .WillOnce(Return(false))
+      .WillOnce([input_states](int, int, std::array<uint8_t, 8>& dest) {
+        dest = input_states;
+        return true;
+      });
+  EXPECT_CALL(*mock_modbus_, read_coils(_, _, _, _)).WillOnce(Return(false));
+
+  EXPECT_CALL(*mock_mqtt_, publish("test/input1/state", "OFF", true)).WillOnce(Return(true));
+  EXPECT_CALL(*mock_mqtt_, publish("test/input2/state", "OFF", true)).WillOnce(Return(true));
+
+  DeviceController controller(inputs_, relays_, polling_config_, *mock_modbus_, *mock_mqtt_);
+  EXPECT_FALSE(controller.synchronize(std::chrono::steady_clock::now()));
+  controller.poll_inputs();
+}
+
+TEST_F(DeviceControllerTest, PeriodicRefreshOverAnHourOfVirtualTime) {
+  VirtualClock clock;
+  EXPECT_CALL(*mock_modbus_, read_discrete_inputs(1, 0, _)).WillRepeatedly([](int, int, std::array<uint8_t, 8>& dest) {
+    dest.fill(0);
+    return true;
+  });
+
+  // Inputs never change: only the 5 s refresh publishes them
+  EXPECT_CALL(*mock_mqtt_, publish("test/input1/state", "OFF", true)).Times(720).WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock_mqtt_, publish("test/input2/state", "OFF", true)).Times(720).WillRepeatedly(Return(true));
+
+  DeviceController controller(inputs_, relays_, polling_config_, *mock_modbus_, *mock_mqtt_, clock);
+  for (int cycle = 0; cycle < 7200; cycle++) {
+    clock.advance(std::chrono::milliseconds(500));
+    controller.poll_inputs();
+  }
+}
+
+TEST_F(DeviceControllerTest, StatisticsPublishedEveryMinute) {
+  VirtualClock clock;
+  EXPECT_CALL(*mock_modbus_, get_stats()).WillRepeatedly(Return(ModbusManagerStats()));
+  EXPECT_CALL(*mock_mqtt_, get_stats()).WillRepeatedly(Return(MqttManagerStats()));
+  EXPECT_CALL(*mock_mqtt_, publish(_, _, _)).WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock_mqtt_, publish("modbus/poller/stats/rates", _, false)).Times(3).WillRepeatedly(Return(true));
+
+  DeviceController controller(inputs_, relays_, polling_config_, *mock_modbus_, *mock_mqtt_, clock);
+  for (int second = 0; second < 200; second++) {
+    clock.advance(std::chrono::seconds(1));
+    controller.print_statistics();
+  }
+}
+
+namespace {
+
+std::atomic<int> g_sigterm_count{0};
+
+void count_sigterm(int) {
+  g_sigterm_count++;
+}
+
+}  // namespace
+
+TEST_F(DeviceControllerTest, WatchdogAlarmsInVirtualTime) {
+  VirtualClock clock;
+  std::atomic<bool> running{true};
+  std::atomic<bool> force_exit{false};
+  auto previous_handler = std::signal(SIGTERM, count_sigterm);
+  g_sigterm_count = 0;
+
+  DeviceController controller(inputs_, relays_, polling_config_, *mock_modbus_, *mock_mqtt_, clock);
+  controller.start_watchdog(running, force_exit);
+
+  // A live loop keeps it quiet; the watchdog is back asleep after each check
+  for (int check = 0; check < 10; check++) {
+    ASSERT_TRUE(clock.advance_to_next(1));
+    controller.update_watchdog();
+  }
+  const auto stalled = clock.now();
+
+  // Checks every 5 s, alarms once more than 10 s passed since the last cycle
+  ASSERT_TRUE(clock.advance_to_next(1));
+  ASSERT_TRUE(clock.advance_to_next(1));
+  EXPECT_FALSE(force_exit);
+  ASSERT_TRUE(clock.advance_to_next(1));
+  controller.stop_watchdog();
+
+  EXPECT_TRUE(force_exit);
+  EXPECT_EQ(g_sigterm_count, 1);
+  EXPECT_EQ(clock.now() - stalled, std::chrono::seconds(15));
+  std::signal(SIGTERM, previous_handler);
+}
+
+TEST_F(DeviceControllerTest, WatchdogStopsWithoutTimeMoving) {
+  VirtualClock clock;
+  std::atomic<bool> running{true};
+  std::atomic<bool> force_exit{false};
+
+  {
+    DeviceController controller(inputs_, relays_, polling_config_, *mock_modbus_, *mock_mqtt_, clock);
+    controller.start_watchdog(running, force_exit);
+    while (clock.sleepers() == 0) {
+      std::this_thread::yield();
+    }
+  }  // joins the sleeping watchdog
+
+  EXPECT_EQ(clock.sleepers(), 0u);
+  EXPECT_FALSE(force_exit);
+}
+
+TEST_F(DeviceControllerTest, BroadcastGroupVerifiesAndCorrects) {
+  std::vector<Relay> relays = relays_;
+  for (int address : {0, 1, 5}) {
+    relays.push_back(make_relay(2, address, "relay2_" + std::to_string(address)));
+  }
+  BroadcastGroup all_off{"all", 0, 2, "home/leaving", true};
+
+  std::vector<ConfigDiagnostic> diagnostics;
+  auto points = std::make_shared<const PointTable>(
+      compile_points(inputs_, relays, diagnostics, {}, DeviceCatalog(), {all_off}));
+  ASSERT_TRUE(diagnostics.empty());
+  DeviceController controller(points, polling_config_, *mock_modbus_, *mock_mqtt_);
+
+  auto topics = controller.command_topics();
+  EXPECT_NE(std::find(topics.begin(), topics.end(), "home/leaving"), topics.end());
+
+  // One frame for both slaves, one read-back each; relay2_1 missed it
+  const uint8_t slave1[] = {0};
+  const uint8_t slave2[] = {0, 1};
+  EXPECT_CALL(*mock_modbus_, broadcast_coils(0, 2, false)).WillOnce(Return(true));
+  EXPECT_CALL(*mock_modbus_, read_coils(1, 0, 1, _))
+      .WillOnce(DoAll(SetArrayArgument<3>(slave1, slave1 + 1), Return(true)));
+  EXPECT_CALL(*mock_modbus_, read_coils(2, 0, 2, _))
+      .WillOnce(DoAll(SetArrayArgument<3>(slave2, slave2 + 2), Return(true)));
+  EXPECT_CALL(*mock_modbus_, write_coil(2, 1, false)).WillOnce(Return(true));
+  EXPECT_CALL(*mock_modbus_, write_coil(1, 0, _)).Times(0);
+  EXPECT_CALL(*mock_mqtt_, publish("test/relay1/state", "OFF", true)).WillOnce(Return(true));
+  EXPECT_CALL(*mock_mqtt_, publish("test/relay2_0/state", "OFF", true)).WillOnce(Return(true));
+  EXPECT_CALL(*mock_mqtt_, publish("test/relay2_1/state", "OFF", true)).WillOnce(Return(true));
+
+  controller.handle_mqtt_command("home/leaving", "OFF");
+  controller.process_relay_commands();
+}
+
+TEST_F(DeviceControllerTest, BroadcastGroupLeavesUnverifiableRelaysUnpublished) {
+  std::vector<Relay> relays = relays_;
+  relays.push_back(relays_[0]);
+  relays.back().slave_id = 2;
+  relays.back().name = "write_only";
+  relays.back().mqtt_command_topic = "test/write_only/set";
+  relays.back().mqtt_state_topic = "test/write_only/state";
+
+  std::vector<ConfigDiagnostic> diagnostics;
+  PointTable table =
+      compile_points(inputs_, relays, diagnostics, {}, DeviceCatalog(), {{"all", 0, 1, "home/all", true}});
+  table.profiles[2].function_codes = {0x05, 0x0F};  // cannot read coils back
+  DeviceController controller(std::make_shared<const PointTable>(std::move(table)), polling_config_, *mock_modbus_,
+                              *mock_mqtt_);
+
+  const uint8_t on[] = {1};
+  EXPECT_CALL(*mock_modbus_, broadcast_coils(0, 1, true)).WillOnce(Return(true));
+  EXPECT_CALL(*mock_modbus_, read_coils(1, 0, 1, _)).WillOnce(DoAll(SetArrayArgument<3>(on, on + 1), Return(true)));
+  EXPECT_CALL(*mock_modbus_, read_coils(2, _, _, _)).Times(0);
+  EXPECT_CALL(*mock_mqtt_, publish("test/relay1/state", "ON", true)).WillOnce(Return(true));
+  EXPECT_CALL(*mock_mqtt_, publish("test/write_only/state", _, _)).Times(0);
+
+  controller.handle_mqtt_command("home/all", "ON");
+  controller.process_relay_commands();
+}
@@ -0,0 +1,146 @@
+#include "device_controller.hpp"
+#include "device_profile.hpp"
+#include "modbus_manager_mock.hpp"
+#include "mqtt_manager_mock.hpp"
+#include "point_factories.hpp"
+#include "point_table.hpp"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using ::testing::_;
+using ::testing::Return;
+
+// Sees the frames the planner asks for instead of the 8-bit default
+class FramedModbusManager : public MockModbusManager {
+ public:
+  MOCK_METHOD(bool, read_input_bits, (int slave_id, int start_addr, int count, uint8_t* dest), (override));
+};
+
+class DeviceProfileTest : public ::testing::Test {
+ protected:
+  DeviceCatalog load_catalog(const std::string& text) {
+    DeviceCatalog catalog;
+    catalog.load(nlohmann::json::parse(text), diagnostics_);
+    return catalog;
+  }
+
+  std::vector<ConfigDiagnostic> diagnostics_;
+};
+
+TEST_F(DeviceProfileTest, PicksFunctionCodes) {
+  DeviceProfile profile;
+  ModbusFunction function;
+
+  profile.function_codes = {0x01, 0x0F};
+  ASSERT_TRUE(profile.read_function(function));
+  EXPECT_EQ(function, ModbusFunction::READ_COILS);
+  ASSERT_TRUE(profile.write_function(function));
+  EXPECT_EQ(function, ModbusFunction::WRITE_MULTIPLE_COILS);
+
+  profile.function_codes = {0x02};
+  EXPECT_FALSE(profile.write_function(function));
+}
+
+TEST_F(DeviceProfileTest, LoadsProfilesAndAssignments) {
+  auto catalog = load_catalog(R"({
+      "device_profiles": {"wide": {"inputs": 64, "max_read_bits": 64, "inter_frame_delay_ms": 5}},
+      "slaves": [{"slave_id": "10-11", "profile": "wide"}, {"slave_id": 12, "profile": "di8"}]
+  })");
+
+  EXPECT_TRUE(diagnostics_.empty());
+  EXPECT_EQ(catalog.profile_for(11).name, "wide");
+  EXPECT_EQ(catalog.profile_for(11).inter_frame_delay_ms, 5);
+  EXPECT_EQ(catalog.profile_for(12).inputs, 8);
+  EXPECT_EQ(catalog.profile_for(13).name, DeviceCatalog::kGenericProfile);
+}
+
+TEST_F(DeviceProfileTest, ReportsBadProfilesAndConflicts) {
+  load_catalog(R"({
+      "device_profiles": {"broken": {"max_read_bits": 4000}},
+      "slaves": [
+          {"slave_id": 5, "profile": "di8"},
+          {"slave_id": "4-5", "profile": "do8"},
+          {"slave_id": 6, "profile": "nope"}
+      ]
+  })");
+
+  ASSERT_EQ(diagnostics_.size(), 3u);
+  EXPECT_EQ(diagnostics_[0].path, "/device_profiles/broken/max_read_bits");
+  EXPECT_EQ(diagnostics_[1].path, "/slaves/1/profile");
+  EXPECT_EQ(diagnostics_[2].path, "/slaves/2/profile");
+}
+
+TEST_F(DeviceProfileTest, ChecksPointsAgainstProfile) {
+  auto catalog = load_catalog(R"({"slaves": [{"slave_id": 1, "profile": "di8"}, {"slave_id": 2, "profile": "do8"}]})");
+
+  compile_points({make_input(1, 8, "in_1_8"), make_input(2, 0, "in_2_0")},
+                 {make_relay(1, 0, "out_1_0"), make_relay(2, 9, "out_2_9")}, diagnostics_, {}, catalog);
+
+  auto has_error = [this](const std::string& path) {
+    return std::any_of(diagnostics_.begin(), diagnostics_.end(), [&](const ConfigDiagnostic& d) {
+      return d.severity == ConfigDiagnostic::Severity::ERROR && d.path == path;
+    });
+  };
+  EXPECT_TRUE(has_error("/digital_inputs/0/address"));  // di8 has inputs 0-7
+  EXPECT_TRUE(has_error("/digital_inputs/1/slave_id"));  // do8 has no inputs
+  EXPECT_TRUE(has_error("/relays/0/slave_id"));          // di8 has no coils
+  EXPECT_TRUE(has_error("/relays/1/address"));
+}
+
+TEST_F(DeviceProfileTest, ReadsWholeModuleInOneRequest) {
+  auto catalog = load_catalog(R"({"slaves": [{"slave_id": 3, "profile": "di16"}]})");
+  auto points = std::make_shared<const PointTable>(
+      compile_points({make_input(3, 0, "in_3_0"), make_input(3, 15, "in_3_15")}, {}, diagnostics_, {}, catalog));
+  ASSERT_TRUE(diagnostics_.empty());
+  EXPECT_EQ(points->slaves[0].bit_count, 16u);
+
+  FramedModbusManager modbus;
+  MockMqttManager mqtt;
+  PollingConfig polling{100, 5, 10, 10};
+
+  EXPECT_CALL(modbus, read_input_bits(3, 0, 16, _)).WillOnce([](int, int, int count, uint8_t* dest) {
+    std::fill(dest, dest + count, 0);
+    dest[15] = 1;
+    return true;
+  });
+  EXPECT_CALL(mqtt, publish("test/in_3_15/state", "ON", true)).WillOnce(Return(true));
+
+  DeviceController controller(points, polling, modbus, mqtt);
+  controller.poll_inputs();
+}
+
+TEST_F(DeviceProfileTest, ReloadRepublishesWhenModuleShrinks) {
+  const std::vector<DigitalInput> inputs = {make_input(3, 0, "in_3_0"), make_input(3, 11, "in_3_11")};
+  auto compile = [&](const std::string& profile) {
+    auto catalog = load_catalog(R"({"device_profiles": {"m": )" + profile +
+                                R"(}, "slaves": [{"slave_id": 3, "profile": "m"}]})");
+    return std::make_shared<const PointTable>(compile_points(inputs, {}, diagnostics_, {}, catalog));
+  };
+  auto points = compile(R"({"max_read_bits": 16})");
+  // Same inputs and topics; only the module's input count changes
+  auto shrunk = compile(R"({"inputs": 12, "max_read_bits": 16})");
+  ASSERT_TRUE(diagnostics_.empty());
+  ASSERT_EQ(points->slaves[0].bit_count, 16u);
+  ASSERT_EQ(shrunk->slaves[0].bit_count, 12u);
+
+  FramedModbusManager modbus;
+  MockMqttManager mqtt;
+  PollingConfig polling{100, 5, 10, 10};
+
+  auto all_on = [](int, int, int count, uint8_t* dest) {
+    std::fill(dest, dest + count, 1);
+    return true;
+  };
+  EXPECT_CALL(modbus, read_input_bits(3, 0, 16, _)).WillOnce(all_on);
+  EXPECT_CALL(modbus, read_input_bits(3, 0, 12, _)).Times(2).WillRepeatedly(all_on);
+  // Full state after the reload, then nothing while the inputs hold
+  EXPECT_CALL(mqtt, publish("test/in_3_0/state", "ON", true)).Times(2).WillRepeatedly(Return(true));
+  EXPECT_CALL(mqtt, publish("test/in_3_11/state", "ON", true)).Times(2).WillRepeatedly(Return(true));
+
+  DeviceController controller(points, polling, modbus, mqtt);
+  controller.poll_inputs();
+  controller.reload(shrunk, polling);
+  controller.poll_inputs();
+  controller.poll_inputs();
+}
@@ -322,4 +322,38 @@ TEST_F(EdgeCaseTest, CommandQueueOverflow) {
   EXPECT_CALL(*mock_mqtt_, publish("test/relay/state", "ON", true)).Times(1).WillRepeatedly(Return(true));
 
   controller.process_relay_commands();
-}
\ No newline at end of file
+}
+
+TEST_F(EdgeCaseTest, InputsBeyondFirstReadBlock) {
+  std::vector<DigitalInput> inputs;
+  DigitalInput input;
+  input.slave_id = 1;
+  input.address = 9;
+  input.name = "second_block_input";
+  input.mqtt_topic = "test/input";
+  inputs.push_back(input);
+
+  std::vector<Relay> relays;
+  std::array<uint8_t, 8> first_block = {0, 0, 0, 0, 0, 0, 0, 0};
+  std::array<uint8_t, 8> second_block = {0, 1, 0, 0, 0, 0, 0, 0};
+
+  EXPECT_CALL(*mock_modbus_, read_discrete_inputs(1, 0, _))
+      .Times(2)
+      .WillRepeatedly([first_block](int /*slave_id*/, int /*start_addr*/, std::array<uint8_t, 8>& dest) {
+        dest = first_block;
+        return true;
+      });
+  EXPECT_CALL(*mock_modbus_, read_discrete_inputs(1, 8, _))
+      .Times(2)
+      .WillRepeatedly([second_block](int /*slave_id*/, int /*start_addr*/, std::array<uint8_t, 8>& dest) {
+        dest = second_block;
+        return true;
+      });
+
+  // Published once on the change, not again while idle
+  EXPECT_CALL(*mock_mqtt_, publish("test/input", "ON", true)).WillOnce(Return(true));
+
+  DeviceController controller(inputs, relays, polling_config_, *mock_modbus_, *mock_mqtt_);
+  controller.poll_inputs();
+  controller.poll_inputs();
+}
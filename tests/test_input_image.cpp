@@ -0,0 +1,92 @@
+#include "input_image.hpp"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(InputImageTest, LoadBitsPacksIntoWords) {
+  InputImage image(8);
+  const uint8_t bits[8] = {1, 0, 1, 0, 0, 0, 0, 1};
+
+  image.load_bits(0, bits, 8);
+
+  EXPECT_TRUE(image.test(0));
+  EXPECT_FALSE(image.test(1));
+  EXPECT_TRUE(image.test(2));
+  EXPECT_TRUE(image.test(7));
+  EXPECT_EQ(image.count(), 3u);
+  EXPECT_EQ(image.words()[0], 0x85u);
+}
+
+TEST(InputImageTest, LoadBitsAcrossWordBoundary) {
+  InputImage image(128);
+  std::vector<uint8_t> bits(8, 1);
+
+  image.load_bits(60, bits.data(), bits.size());
+
+  EXPECT_EQ(image.count(), 8u);
+  EXPECT_FALSE(image.test(59));
+  EXPECT_TRUE(image.test(60));
+  EXPECT_TRUE(image.test(63));
+  EXPECT_TRUE(image.test(64));
+  EXPECT_TRUE(image.test(67));
+  EXPECT_FALSE(image.test(68));
+
+  // Reloading clears bits that went low
+  std::vector<uint8_t> zeros(8, 0);
+  image.load_bits(60, zeros.data(), zeros.size());
+  EXPECT_EQ(image.count(), 0u);
+}
+
+TEST(InputImageTest, LoadBitsClampedToImageSize) {
+  InputImage image(4);
+  const uint8_t bits[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+
+  image.load_bits(0, bits, 8);
+
+  EXPECT_EQ(image.count(), 4u);
+}
+
+TEST(InputImageTest, EqualsSmallAndLargeImages) {
+  for (std::size_t size : {8u, 64u, 1000u, 4096u}) {
+    InputImage a(size);
+    InputImage b(size);
+    EXPECT_TRUE(a.equals(b)) << size;
+
+    b.set(size - 1, true);
+    EXPECT_FALSE(a.equals(b)) << size;
+
+    a.set(size - 1, true);
+    EXPECT_TRUE(a.equals(b)) << size;
+  }
+
+  EXPECT_FALSE(InputImage(8).equals(InputImage(16)));
+}
+
+TEST(InputImageTest, ForEachChangeVisitsOnlyChangedBits) {
+  InputImage previous(200);
+  InputImage current(200);
+  previous.set(3, true);
+  previous.set(130, true);
+  current.set(3, true);
+  current.set(64, true);
+  current.set(199, true);
+
+  std::vector<std::pair<std::size_t, bool>> changes;
+  current.for_each_change(previous, [&](std::size_t bit, bool value) { changes.emplace_back(bit, value); });
+
+  ASSERT_EQ(changes.size(), 3u);
+  EXPECT_EQ(changes[0], std::make_pair(std::size_t{64}, true));
+  EXPECT_EQ(changes[1], std::make_pair(std::size_t{130}, false));
+  EXPECT_EQ(changes[2], std::make_pair(std::size_t{199}, true));
+}
+
+TEST(InputImageTest, SwapExchangesContents) {
+  InputImage a(16);
+  InputImage b(16);
+  a.set(5, true);
+
+  a.swap(b);
+
+  EXPECT_FALSE(a.test(5));
+  EXPECT_TRUE(b.test(5));
+}
@@ -0,0 +1,76 @@
+#include "metrics/latency_histogram.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(LatencyHistogramTest, EmptyHistogram) {
+  LatencyHistogram histogram;
+  auto snap = histogram.snapshot();
+
+  EXPECT_EQ(snap.count, 0u);
+  EXPECT_EQ(snap.percentile(50.0), 0u);
+  EXPECT_EQ(snap.percentile(99.0), 0u);
+  EXPECT_EQ(snap.max_us, 0u);
+}
+
+TEST(LatencyHistogramTest, BucketBoundsCoverValues) {
+  for (uint64_t value : {0ull, 1ull, 15ull, 16ull, 17ull, 100ull, 1023ull, 1024ull, 123456ull, 98765432ull}) {
+    const std::size_t index = LatencyHistogram::bucket_index(value);
+    EXPECT_LE(LatencyHistogram::bucket_lower_bound(index), value) << value;
+    EXPECT_GE(LatencyHistogram::bucket_upper_bound(index), value) << value;
+  }
+}
+
+TEST(LatencyHistogramTest, RelativeErrorBounded) {
+  for (uint64_t value = 16; value < (uint64_t{1} << 30); value = value * 3 + 7) {
+    const std::size_t index = LatencyHistogram::bucket_index(value);
+    const double width =
+        LatencyHistogram::bucket_upper_bound(index) - LatencyHistogram::bucket_lower_bound(index) + 1.0;
+    EXPECT_LE(width / value, 1.0 / 16.0 + 1e-9) << value;
+  }
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+  LatencyHistogram histogram;
+  for (uint64_t us = 1; us <= 1000; us++) {
+    histogram.record_us(us);
+  }
+
+  auto snap = histogram.snapshot();
+  EXPECT_EQ(snap.count, 1000u);
+  EXPECT_EQ(snap.max_us, 1000u);
+  EXPECT_NEAR(static_cast<double>(snap.percentile(50.0)), 500.0, 500.0 / 16);
+  EXPECT_NEAR(static_cast<double>(snap.percentile(99.0)), 990.0, 990.0 / 16);
+  EXPECT_EQ(snap.percentile(100.0), 1000u);
+  EXPECT_DOUBLE_EQ(snap.mean_us(), 500.5);
+}
+
+TEST(LatencyHistogramTest, RecordDuration) {
+  LatencyHistogram histogram;
+  histogram.record(std::chrono::milliseconds(3));
+
+  EXPECT_EQ(histogram.snapshot().max_us, 3000u);
+}
+
+TEST(LatencyHistogramTest, IntervalSince) {
+  LatencyHistogram histogram;
+  histogram.record_us(5000);
+  auto first = histogram.snapshot();
+
+  histogram.record_us(10);
+  histogram.record_us(20);
+  auto interval = histogram.snapshot().since(first);
+
+  EXPECT_EQ(interval.count, 2u);
+  EXPECT_EQ(interval.sum_us, 30u);
+  EXPECT_EQ(interval.max_us, 20u);
+  EXPECT_EQ(interval.percentile(50.0), 10u);
+}
+
+TEST(LatencyHistogramTest, HugeValuesClampToLastBucket) {
+  LatencyHistogram histogram;
+  histogram.record_us(~uint64_t{0});
+
+  auto snap = histogram.snapshot();
+  EXPECT_EQ(snap.count, 1u);
+  EXPECT_EQ(snap.counts[LatencyHistogram::kBucketCount - 1], 1u);
+}
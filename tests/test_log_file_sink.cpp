@@ -0,0 +1,209 @@
+#include "logger/file_sink.hpp"
+#include "logger/logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+class LogFileSinkTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = std::filesystem::temp_directory_path() /
+           ("log_sink_test_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) + "_" +
+            ::testing::UnitTest::GetInstance()->current_test_info()->name());
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_);
+    path_ = (dir_ / "gateway.log").string();
+  }
+
+  void TearDown() override { std::filesystem::remove_all(dir_); }
+
+  static std::string read_file(const std::string& path) {
+    std::ifstream file(path);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+
+  std::filesystem::path dir_;
+  std::string path_;
+};
+
+TEST_F(LogFileSinkTest, AppendsLines) {
+  FileSinkOptions options;
+  options.path = path_;
+
+  FileLogSink sink(options);
+  sink.write("first\n");
+  sink.write("second\n");
+  sink.close();
+
+  // Preallocated space is released on close
+  EXPECT_EQ(std::filesystem::file_size(path_), 13u);
+  EXPECT_EQ(read_file(path_), "first\nsecond\n");
+}
+
+TEST_F(LogFileSinkTest, RotatesBySizeAndKeepsHistory) {
+  FileSinkOptions options;
+  options.path = path_;
+  options.max_size_bytes = 64;
+  options.max_files = 2;
+  options.compress = false;
+
+  FileLogSink sink(options);
+  const std::string line(40, 'x');
+  for (int i = 0; i < 4; i++) {
+    sink.write(line + std::to_string(i) + "\n");
+  }
+  sink.wait_idle();
+
+  EXPECT_EQ(sink.rotations(), 3u);
+  EXPECT_EQ(read_file(path_), line + "3\n");
+  EXPECT_EQ(read_file(path_ + ".1"), line + "2\n");
+  EXPECT_EQ(read_file(path_ + ".2"), line + "1\n");
+  EXPECT_FALSE(std::filesystem::exists(path_ + ".3"));
+}
+
+TEST_F(LogFileSinkTest, CompressesRotatedFiles) {
+  FileSinkOptions options;
+  options.path = path_;
+  options.max_size_bytes = 32;
+  options.max_files = 3;
+
+  FileLogSink sink(options);
+  sink.write(std::string(30, 'a') + "\n");
+  sink.write(std::string(30, 'b') + "\n");
+  sink.wait_idle();
+
+  ASSERT_TRUE(std::filesystem::exists(path_ + ".1.gz"));
+  const std::string gz = read_file(path_ + ".1.gz");
+  ASSERT_GE(gz.size(), 2u);
+  EXPECT_EQ(static_cast<unsigned char>(gz[0]), 0x1f);
+  EXPECT_EQ(static_cast<unsigned char>(gz[1]), 0x8b);
+}
+
+TEST_F(LogFileSinkTest, FallsBackToStderrAndReopens) {
+  FileSinkOptions options;
+  options.path = path_;
+  options.max_size_bytes = 16;
+  options.max_files = 0;
+  options.reopen_delay_ms = 100;
+
+  FileLogSink sink(options);
+  sink.write("first line\n");
+
+  // The rotation cannot recreate the file, so the line goes to stderr
+  std::filesystem::remove_all(dir_);
+  ::testing::internal::CaptureStderr();
+  sink.write("while missing\n");
+  sink.write("still missing\n");
+  const std::string err = ::testing::internal::GetCapturedStderr();
+  EXPECT_NE(err.find("while missing\n"), std::string::npos);
+  EXPECT_NE(err.find("still missing\n"), std::string::npos);
+  EXPECT_EQ(sink.open_failures(), 1u);
+
+  std::filesystem::create_directories(dir_);
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  sink.write("back\n");
+  sink.close();
+
+  EXPECT_EQ(read_file(path_), "back\n");
+}
+
+TEST_F(LogFileSinkTest, JsonLinesThroughLogger) {
+  FileSinkOptions options;
+  options.path = path_;
+
+  Logger::enable_file_output(options);
+  Logger::set_format(LogFormat::JSON);
+
+  Logger logger("Sink\"Test");
+  logger.info() << "relay on" << log_field("slave", 3) << log_field("name", "pump\n1");
+
+  Logger::set_format(LogFormat::TEXT);
+  Logger::disable_file_output();
+
+  const std::string content = read_file(path_);
+  EXPECT_EQ(content.rfind("{\"ts\":\"", 0), 0u);
+  EXPECT_NE(content.find("\"mono_us\":"), std::string::npos);
+  EXPECT_NE(content.find("\"level\":\"INFO\",\"context\":\"Sink\\\"Test\",\"msg\":\"relay on\""), std::string::npos);
+  EXPECT_NE(content.find("\"fields\":{\"slave\":\"3\",\"name\":\"pump\\n1\"}}\n"), std::string::npos);
+}
+
+TEST_F(LogFileSinkTest, ReplacingSinkWhileAsyncWriterRuns) {
+  Logger::enable_async(64, LogOverflowPolicy::BLOCK);
+  Logger logger("SinkSwap");
+
+  std::atomic<bool> done{false};
+  std::thread producer([&] {
+    for (int i = 0; i < 5000; i++) {
+      logger.info() << "line " << i;
+    }
+    done = true;
+  });
+
+  // The writer may still hold the sink being replaced
+  for (int i = 0; !done; i++) {
+    FileSinkOptions options;
+    options.path = path_ + std::to_string(i % 4);
+    Logger::enable_file_output(options);
+  }
+  producer.join();
+
+  Logger::disable_async();
+  Logger::disable_file_output();
+}
+
+TEST_F(LogFileSinkTest, KeepsRecordsLoggedWhileAsyncStops) {
+  FileSinkOptions options;
+  options.path = path_;
+  Logger::enable_file_output(options);
+  Logger::enable_async(1024, LogOverflowPolicy::BLOCK);
+  Logger logger("AsyncStop");
+
+  constexpr int kThreads = 4;
+  constexpr int kLines = 2000;
+  std::atomic<int> started{0};
+  std::vector<std::thread> producers;
+  for (int t = 0; t < kThreads; t++) {
+    producers.emplace_back([&] {
+      started++;
+      for (int i = 0; i < kLines; i++) {
+        logger.info() << "line " << i;
+      }
+    });
+  }
+
+  // Stop the writer while every producer is mid-stream
+  while (started < kThreads) {
+    std::this_thread::yield();
+  }
+  Logger::disable_async();
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  Logger::disable_file_output();
+
+  const std::string content = read_file(path_);
+  EXPECT_EQ(std::count(content.begin(), content.end(), '\n'), kThreads * kLines);
+}
+
+TEST(LoggerFieldTest, TextFormatAppendsKeyValues) {
+  Logger::enable_colors(false);
+  Logger::enable_timestamps(false);
+
+  LogRecord record{LogLevel::LEVEL_WARNING, std::chrono::system_clock::now(), "Ctx", "retrying",
+                   {log_field("slave", 12), log_field("attempt", 2)}};
+  std::string line;
+  Logger::format_record(record, line);
+
+  EXPECT_EQ(line, "[WARNING ] [Ctx] retrying slave=12 attempt=2");
+
+  Logger::enable_colors(true);
+  Logger::enable_timestamps(true);
+}
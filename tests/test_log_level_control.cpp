@@ -0,0 +1,80 @@
+#include "log_level_control.hpp"
+#include "mqtt_manager_mock.hpp"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using ::testing::HasSubstr;
+
+class LogLevelControlTest : public ::testing::Test {
+ protected:
+  void SetUp() override { Logger::set_global_level(LogLevel::LEVEL_WARNING); }
+
+  void TearDown() override {
+    Logger::clear_component_level("LevelTarget");
+    Logger::set_global_level(LogLevel::LEVEL_INFO);
+  }
+
+  std::chrono::steady_clock::time_point at(int seconds) { return start_ + std::chrono::seconds(seconds); }
+
+  ::testing::NiceMock<MockMqttManager> mqtt_;
+  Logger target_{"LevelTarget"};
+  std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+};
+
+TEST_F(LogLevelControlTest, OverrideRaisesSingleComponent) {
+  LogLevelControl control("modbus/poller/log", 0, mqtt_);
+  Logger other("LevelOther");
+
+  EXPECT_FALSE(target_.is_enabled(LogLevel::LEVEL_DEBUG));
+
+  EXPECT_TRUE(control.handle_command("modbus/poller/log/LevelTarget/set", "debug", at(0)));
+  EXPECT_TRUE(target_.is_enabled(LogLevel::LEVEL_DEBUG));
+  EXPECT_FALSE(other.is_enabled(LogLevel::LEVEL_INFO));
+
+  EXPECT_TRUE(control.handle_command("modbus/poller/log/LevelTarget/set", "default", at(1)));
+  EXPECT_FALSE(target_.is_enabled(LogLevel::LEVEL_DEBUG));
+}
+
+TEST_F(LogLevelControlTest, OverrideRevertsAfterTimeout) {
+  LogLevelControl control("modbus/poller/log", 0, mqtt_);
+
+  control.handle_command("modbus/poller/log/LevelTarget/set", R"({"level": "DEBUG", "revert_after_sec": 30})", at(0));
+  control.tick(at(10));
+  EXPECT_TRUE(target_.is_enabled(LogLevel::LEVEL_DEBUG));
+
+  control.tick(at(31));
+  EXPECT_FALSE(target_.is_enabled(LogLevel::LEVEL_DEBUG));
+}
+
+TEST_F(LogLevelControlTest, GlobalLevelRevertsToConfigured) {
+  LogLevelControl control("modbus/poller/log", 60, mqtt_);
+
+  control.handle_command("modbus/poller/log/global/set", "error", at(0));
+  EXPECT_EQ(Logger::get_global_level(), LogLevel::LEVEL_ERROR);
+
+  control.tick(at(61));
+  EXPECT_EQ(Logger::get_global_level(), LogLevel::LEVEL_WARNING);
+}
+
+TEST_F(LogLevelControlTest, IgnoresOtherTopicsAndBadCommands) {
+  LogLevelControl control("modbus/poller/log", 0, mqtt_);
+
+  EXPECT_FALSE(control.handle_command("modbus/relay/pump/set", "ON", at(0)));
+  EXPECT_TRUE(control.handle_command("modbus/poller/log/NoSuchComponent/set", "debug", at(0)));
+  EXPECT_TRUE(control.handle_command("modbus/poller/log/LevelTarget/set", "loud", at(0)));
+  EXPECT_FALSE(target_.is_enabled(LogLevel::LEVEL_INFO));
+}
+
+TEST_F(LogLevelControlTest, PublishesLevelsOnChange) {
+  LogLevelControl control("modbus/poller/log", 0, mqtt_);
+
+  ::testing::InSequence sequence;
+  EXPECT_CALL(mqtt_, publish("modbus/poller/log/levels", HasSubstr("\"global\":\"WARNING\""), true));
+  EXPECT_CALL(mqtt_, publish("modbus/poller/log/levels", HasSubstr("\"LevelTarget\":\"DEBUG\""), true));
+
+  control.tick(at(0));
+  control.handle_command("modbus/poller/log/LevelTarget/set", "debug", at(1));
+  control.tick(at(2));
+  control.tick(at(3));  // nothing changed, nothing published
+}
@@ -0,0 +1,224 @@
+#include "logger/async_log_writer.hpp"
+#include "logger/log_rate_limiter.hpp"
+#include "logger/log_ring.hpp"
+#include "logger/logger.hpp"
+
+#include <ctime>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+TEST(LogRingTest, CapacityRoundedToPowerOfTwo) {
+  BoundedMpscQueue<int> queue(100);
+  EXPECT_EQ(queue.capacity(), 128u);
+}
+
+TEST(LogRingTest, PushPopInOrderAndFull) {
+  BoundedMpscQueue<int> queue(4);
+
+  for (int i = 0; i < 4; i++) {
+    int value = i;
+    EXPECT_TRUE(queue.try_push(value));
+  }
+
+  int overflow = 99;
+  EXPECT_FALSE(queue.try_push(overflow));
+  EXPECT_EQ(overflow, 99);
+
+  int out = -1;
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(queue.try_pop(out));
+    EXPECT_EQ(out, i);
+  }
+  EXPECT_FALSE(queue.try_pop(out));
+}
+
+TEST(LogRingTest, MultipleProducersSingleConsumer) {
+  constexpr int kProducers = 4;
+  constexpr int kPerProducer = 20000;
+  BoundedMpscQueue<std::pair<int, int>> queue(256);
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&queue, p]() {
+      for (int i = 0; i < kPerProducer; i++) {
+        std::pair<int, int> item(p, i);
+        while (!queue.try_push(item)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Every item arrives exactly once and in order per producer
+  std::vector<int> next(kProducers, 0);
+  int received = 0;
+  std::pair<int, int> item;
+  while (received < kProducers * kPerProducer) {
+    if (queue.try_pop(item)) {
+      ASSERT_EQ(item.second, next[item.first]);
+      next[item.first]++;
+      received++;
+    }
+  }
+
+  for (auto& t : producers) {
+    t.join();
+  }
+}
+
+TEST(LoggerFormatTest, FormatRecord) {
+  Logger::enable_colors(false);
+  Logger::enable_timestamps(false);
+
+  LogRecord record{LogLevel::LEVEL_INFO, std::chrono::system_clock::now(), "Context", "hello"};
+  std::string line;
+  Logger::format_record(record, line);
+
+  EXPECT_EQ(line, "[INFO    ] [Context] hello");
+
+  Logger::enable_colors(true);
+}
+
+TEST(AsyncLoggerTest, BlockPolicyNeverDrops) {
+  AsyncLogWriter writer(8, LogOverflowPolicy::BLOCK);
+
+  for (int i = 0; i < 2000; i++) {
+    writer.push(LogRecord{LogLevel::LEVEL_DEBUG, std::chrono::system_clock::now(), "AsyncTest",
+                          "block " + std::to_string(i)});
+  }
+  writer.stop();
+
+  EXPECT_EQ(writer.dropped(), 0u);
+}
+
+TEST(AsyncLoggerTest, EnableAndDisable) {
+  Logger logger("AsyncTest");
+
+  Logger::enable_async(64, LogOverflowPolicy::DROP);
+  EXPECT_TRUE(Logger::is_async());
+
+  for (int i = 0; i < 10; i++) {
+    logger.info() << "async line " << i;
+  }
+
+  Logger::disable_async();
+  EXPECT_FALSE(Logger::is_async());
+
+  // Synchronous logging keeps working afterwards
+  EXPECT_NO_THROW(logger.info() << "sync line");
+}
+
+TEST(LoggerMacroTest, DisabledLevelSkipsArguments) {
+  Logger logger("MacroTest");
+  int evaluations = 0;
+  auto expensive = [&evaluations]() {
+    evaluations++;
+    return std::string("payload");
+  };
+
+  Logger::set_global_level(LogLevel::LEVEL_WARNING);
+  LOG_DEBUG(logger) << "skipped " << expensive();
+  LOG_INFO(logger) << "skipped " << expensive();
+  EXPECT_EQ(evaluations, 0);
+
+  EXPECT_FALSE(logger.is_enabled(LogLevel::LEVEL_INFO));
+  EXPECT_TRUE(logger.is_enabled(LogLevel::LEVEL_ERROR));
+
+  Logger::set_global_level(LogLevel::LEVEL_DEBUG);
+  LOG_DEBUG(logger) << "evaluated " << expensive();
+  EXPECT_EQ(evaluations, 1);
+
+  Logger::set_global_level(LogLevel::LEVEL_INFO);
+}
+
+TEST(LoggerMacroTest, SafeInUnbracedIfElse) {
+  Logger logger("MacroTest");
+  bool else_taken = false;
+
+  if (false)
+    LOG_INFO(logger) << "never";
+  else
+    else_taken = true;
+
+  EXPECT_TRUE(else_taken);
+}
+
+TEST(LoggerTimestampTest, MatchesLocalTimeFormat) {
+  const auto time = std::chrono::system_clock::from_time_t(1700000000) + std::chrono::milliseconds(7);
+
+  std::string stamp;
+  Logger::append_timestamp(time, stamp);
+
+  const std::time_t seconds = 1700000000;
+  std::tm local{};
+  localtime_r(&seconds, &local);
+  char expected[32];
+  std::strftime(expected, sizeof(expected), "%Y-%m-%d %H:%M:%S", &local);
+
+  EXPECT_EQ(stamp, std::string(expected) + ".007");
+}
+
+TEST(LoggerTimestampTest, CacheUpdatesMillisecondsAndSeconds) {
+  const auto base = std::chrono::system_clock::from_time_t(1700000000);
+
+  std::string first;
+  std::string second;
+  std::string next;
+  Logger::append_timestamp(base + std::chrono::milliseconds(123), first);
+  Logger::append_timestamp(base + std::chrono::milliseconds(999), second);
+  Logger::append_timestamp(base + std::chrono::milliseconds(1000), next);
+
+  ASSERT_EQ(first.size(), Logger::kTimestampLength);
+  EXPECT_EQ(first.substr(0, 19), second.substr(0, 19));
+  EXPECT_EQ(first.substr(20), "123");
+  EXPECT_EQ(second.substr(20), "999");
+  EXPECT_NE(next.substr(0, 19), second.substr(0, 19));
+  EXPECT_EQ(next.substr(20), "000");
+}
+
+TEST(LogRateLimiterTest, BurstThenRefill) {
+  LogRateLimiter limiter(1.0, 2);
+  const auto start = LogRateLimiter::Clock::now();
+  static const char site = 0;
+  uint64_t suppressed = 0;
+
+  EXPECT_TRUE(limiter.allow(&site, 1, suppressed, start));
+  EXPECT_TRUE(limiter.allow(&site, 1, suppressed, start));
+  EXPECT_FALSE(limiter.allow(&site, 1, suppressed, start));
+  EXPECT_FALSE(limiter.allow(&site, 1, suppressed, start + std::chrono::milliseconds(500)));
+
+  // One token back after a second; the two dropped lines are reported once
+  EXPECT_TRUE(limiter.allow(&site, 1, suppressed, start + std::chrono::seconds(1)));
+  EXPECT_EQ(suppressed, 2u);
+  EXPECT_EQ(limiter.suppressed_total(), 2u);
+}
+
+TEST(LogRateLimiterTest, KeysAndSitesAreIndependent) {
+  LogRateLimiter limiter(0.1, 1);
+  const auto now = LogRateLimiter::Clock::now();
+  static const char site_a = 0;
+  static const char site_b = 0;
+  uint64_t suppressed = 0;
+
+  EXPECT_TRUE(limiter.allow(&site_a, 1, suppressed, now));
+  EXPECT_FALSE(limiter.allow(&site_a, 1, suppressed, now));
+
+  // A noisy slave does not hide errors from another slave or call site
+  EXPECT_TRUE(limiter.allow(&site_a, 2, suppressed, now));
+  EXPECT_TRUE(limiter.allow(&site_b, 1, suppressed, now));
+}
+
+TEST(LogRateLimiterTest, MacroSkipsSuppressedLines) {
+  Logger logger("LimiterTest");
+  LogRateLimiter limiter(0.001, 1);
+  int evaluations = 0;
+  auto count = [&evaluations]() { return ++evaluations; };
+
+  for (int i = 0; i < 5; i++) {
+    LOG_LIMITED(logger, LogLevel::LEVEL_WARNING, limiter, 7) << "storm " << count();
+  }
+
+  EXPECT_EQ(evaluations, 1);
+  EXPECT_EQ(limiter.suppressed_total(), 4u);
+}
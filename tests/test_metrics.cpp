@@ -0,0 +1,136 @@
+#include "metrics/metrics.hpp"
+#include "metrics/metrics_server.hpp"
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+std::string http_get(int port, const std::string& path) {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+  std::string response;
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+    std::string request = "GET " + path + " HTTP/1.0\r\n\r\n";
+    ::send(fd, request.data(), request.size(), 0);
+
+    char buffer[4096];
+    ssize_t n;
+    while ((n = ::recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+      response.append(buffer, static_cast<std::size_t>(n));
+    }
+  }
+
+  ::close(fd);
+  return response;
+}
+
+}  // namespace
+
+TEST(MetricsTest, CountersAndGaugesArePadded) {
+  EXPECT_EQ(alignof(Counter), kCacheLineSize);
+  EXPECT_EQ(sizeof(Counter), kCacheLineSize);
+  EXPECT_EQ(alignof(Gauge), kCacheLineSize);
+}
+
+TEST(MetricsTest, RenderCountersAndGauges) {
+  MetricsRegistry registry;
+  Counter reads;
+  Counter errors;
+  Gauge connected;
+
+  reads.inc(5);
+  errors.inc();
+  connected.set(1);
+
+  auto r1 = registry.add_counter("modbus_reads", "Reads", {{"slave", "1"}, {"result", "success"}}, reads);
+  auto r2 = registry.add_gauge("modbus_connected", "Connected", {{"bus", "/dev/ttyUSB0"}}, connected);
+  auto r3 = registry.add_counter("modbus_reads", "Reads", {{"slave", "1"}, {"result", "error"}}, errors);
+
+  const std::string text = registry.render();
+
+  EXPECT_NE(text.find("# TYPE modbus_reads counter\n"), std::string::npos);
+  EXPECT_NE(text.find("modbus_reads_total{slave=\"1\",result=\"success\"} 5\n"), std::string::npos);
+  EXPECT_NE(text.find("modbus_reads_total{slave=\"1\",result=\"error\"} 1\n"), std::string::npos);
+  EXPECT_NE(text.find("# TYPE modbus_connected gauge\n"), std::string::npos);
+  EXPECT_NE(text.find("modbus_connected{bus=\"/dev/ttyUSB0\"} 1\n"), std::string::npos);
+
+  // One TYPE line per family and the terminating EOF marker
+  EXPECT_EQ(text.find("# TYPE modbus_reads"), text.rfind("# TYPE modbus_reads"));
+  EXPECT_EQ(text.substr(text.size() - 6), "# EOF\n");
+}
+
+TEST(MetricsTest, RenderHistogram) {
+  MetricsRegistry registry;
+  LatencyHistogram histogram;
+  histogram.record_us(300);
+  histogram.record_us(3000);
+  histogram.record_us(30000000);
+
+  auto reg = registry.add_histogram("gateway_cycle_seconds", "Cycle", {}, histogram);
+  const std::string text = registry.render();
+
+  EXPECT_NE(text.find("# TYPE gateway_cycle_seconds histogram\n"), std::string::npos);
+  EXPECT_NE(text.find("gateway_cycle_seconds_bucket{le=\"0.0005\"} 1\n"), std::string::npos);
+  EXPECT_NE(text.find("gateway_cycle_seconds_bucket{le=\"0.005\"} 2\n"), std::string::npos);
+  EXPECT_NE(text.find("gateway_cycle_seconds_bucket{le=\"10\"} 2\n"), std::string::npos);
+  EXPECT_NE(text.find("gateway_cycle_seconds_bucket{le=\"+Inf\"} 3\n"), std::string::npos);
+  EXPECT_NE(text.find("gateway_cycle_seconds_count 3\n"), std::string::npos);
+}
+
+TEST(MetricsTest, LabelValuesAreEscaped) {
+  MetricsRegistry registry;
+  Counter counter;
+
+  auto reg = registry.add_counter("mqtt_publishes", "Publishes", {{"topic", "a\"b\\c"}}, counter);
+
+  EXPECT_NE(registry.render().find("mqtt_publishes_total{topic=\"a\\\"b\\\\c\"} 0\n"), std::string::npos);
+}
+
+TEST(MetricsTest, RegistrationRemovesMetricOnDestruction) {
+  MetricsRegistry registry;
+  Counter counter;
+
+  {
+    auto reg = registry.add_counter("temporary", "Temporary", {}, counter);
+    EXPECT_EQ(registry.size(), 1u);
+
+    auto moved = std::move(reg);
+    EXPECT_EQ(registry.size(), 1u);
+  }
+
+  EXPECT_EQ(registry.size(), 0u);
+}
+
+TEST(MetricsTest, ServerServesOpenMetrics) {
+  MetricsRegistry registry;
+  Counter counter;
+  counter.inc(7);
+  auto reg = registry.add_counter("test_events", "Events", {}, counter);
+
+  MetricsConfig config;
+  config.enabled = true;
+  config.bind_address = "127.0.0.1";
+  config.port = 0;
+
+  MetricsServer server(config, registry);
+  ASSERT_TRUE(server.start());
+  ASSERT_GT(server.port(), 0);
+
+  const std::string response = http_get(server.port(), "/metrics");
+  EXPECT_EQ(response.rfind("HTTP/1.0 200 OK", 0), 0u);
+  EXPECT_NE(response.find("application/openmetrics-text"), std::string::npos);
+  EXPECT_NE(response.find("test_events_total 7\n"), std::string::npos);
+
+  EXPECT_EQ(http_get(server.port(), "/other").rfind("HTTP/1.0 404", 0), 0u);
+
+  server.stop();
+  EXPECT_FALSE(server.is_running());
+}
@@ -33,18 +33,9 @@ TEST_F(ModbusManagerTest, Statistics) {
     ModbusManager manager(config_);
     
     auto stats = manager.get_stats();
-    EXPECT_EQ(stats->read_success, 0);
-    EXPECT_EQ(stats->read_errors, 0);
-    EXPECT_EQ(stats->write_success, 0);
-    EXPECT_EQ(stats->write_errors, 0);
+    EXPECT_EQ(stats.read_success, 0);
+    EXPECT_EQ(stats.read_errors, 0);
+    EXPECT_EQ(stats.write_success, 0);
+    EXPECT_EQ(stats.write_errors, 0);
 }
 
-TEST_F(ModbusManagerTest, ResetStatistics) {
-    ModbusManager manager(config_);
-    
-    manager.reset_stats();
-    
-    auto stats = manager.get_stats();
-    EXPECT_EQ(stats->read_success, 0);
-    EXPECT_EQ(stats->read_errors, 0);
-}
@@ -1,6 +1,12 @@
+#include "local_mqtt_broker.hpp"
 #include "mqtt_manager.hpp"
+
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <functional>
+#include <thread>
+
 class MqttManagerTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -33,20 +39,9 @@ TEST_F(MqttManagerTest, Statistics) {
     MqttManager manager(config_);
     
     auto stats = manager.get_stats();
-    EXPECT_EQ(stats->publish_success, 0);
-    EXPECT_EQ(stats->publish_errors, 0);
-    EXPECT_EQ(stats->messages_received, 0);
-}
-
-TEST_F(MqttManagerTest, ResetStatistics) {
-    MqttManager manager(config_);
-    
-    manager.reset_stats();
-    
-    auto stats = manager.get_stats();
-    EXPECT_EQ(stats->publish_success, 0);
-    EXPECT_EQ(stats->publish_errors, 0);
-    EXPECT_EQ(stats->messages_received, 0);
+    EXPECT_EQ(stats.publish_success, 0);
+    EXPECT_EQ(stats.publish_errors, 0);
+    EXPECT_EQ(stats.messages_received, 0);
 }
 
 TEST_F(MqttManagerTest, MessageCallback) {
@@ -62,3 +57,132 @@ TEST_F(MqttManagerTest, MessageCallback) {
         received_payload = payload;
     });
 }
+
+TEST_F(MqttManagerTest, OfflinePublishGoesToOutbox) {
+    MqttManager manager(config_);
+
+    // Retained state waits for the broker, everything else is dropped
+    EXPECT_TRUE(manager.publish("test/state", "ON", true));
+    EXPECT_TRUE(manager.publish("test/state", "OFF", true));
+    EXPECT_FALSE(manager.publish("test/stats", "{}", false));
+    EXPECT_EQ(manager.publish_batch({{"test/a", "ON"}, {"test/b", "OFF"}}), 2u);
+    EXPECT_TRUE(manager.subscribe("test/+/set"));
+
+    auto stats = manager.get_stats();
+    EXPECT_EQ(stats.publish_success, 0);
+    EXPECT_EQ(stats.publish_errors, 1);
+}
+
+// Against the in-process broker on a free loopback port
+class MqttBrokerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        broker_.start();
+
+        config_.broker_address = broker_.address();
+        config_.client_id = "gateway_test";
+        config_.qos = 1;
+        config_.retained = true;
+        config_.keep_alive_sec = 60;
+        config_.operation_timeout_ms = 500;
+    }
+
+    static bool wait_until(const std::function<bool()>& condition) {
+        const auto deadline = std::chrono::steady_clock::now() + kTimeout;
+        while (!condition()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return true;
+    }
+
+    static constexpr std::chrono::milliseconds kTimeout{3000};
+
+    LocalMqttBroker broker_;
+    MqttConfig config_;
+};
+
+TEST_F(MqttBrokerTest, PublishesRetainedState) {
+    MqttManager manager(config_);
+    ASSERT_TRUE(manager.connect());
+    EXPECT_EQ(broker_.retained("modbus/poller/status"), "online");
+
+    EXPECT_TRUE(manager.publish("test/state", "ON"));
+    EXPECT_EQ(manager.publish_batch({{"test/a", "ON"}, {"test/b", "OFF"}}), 2u);
+
+    ASSERT_TRUE(broker_.wait_for_messages("test/b", 1, kTimeout));
+    EXPECT_EQ(broker_.retained("test/state"), "ON");
+    EXPECT_EQ(broker_.retained("test/a"), "ON");
+    EXPECT_EQ(broker_.retained("test/b"), "OFF");
+}
+
+TEST_F(MqttBrokerTest, DeliversCommands) {
+    MqttManager manager(config_);
+    std::atomic<int> received{0};
+    std::string payload;
+    manager.set_message_callback([&](const std::string& topic, const std::string& value) {
+        EXPECT_EQ(topic, "relay/kitchen/set");
+        payload = value;
+        received++;
+    });
+
+    ASSERT_TRUE(manager.connect());
+    ASSERT_TRUE(manager.subscribe("relay/+/set"));
+    ASSERT_TRUE(broker_.wait_for_subscription("relay/+/set", kTimeout));
+
+    broker_.publish("relay/kitchen/set", "ON");
+    ASSERT_TRUE(wait_until([&] { return received == 1; }));
+    EXPECT_EQ(payload, "ON");
+}
+
+TEST_F(MqttBrokerTest, FlushesOutboxWhenBrokerComesUp) {
+    const uint16_t port = broker_.port();
+    broker_.stop();
+
+    MqttManager manager(config_);
+    manager.connect_in_background();
+    EXPECT_TRUE(manager.publish("test/state", "ON"));
+    EXPECT_TRUE(manager.publish("test/state", "OFF"));  // replaces the queued value
+    EXPECT_TRUE(manager.subscribe("test/+/set"));
+
+    broker_.start(port);
+    ASSERT_TRUE(broker_.wait_for_messages("test/state", 1, kTimeout));
+    EXPECT_TRUE(broker_.wait_for_subscription("test/+/set", kTimeout));
+    EXPECT_EQ(broker_.message_count("test/state"), 1u);
+    EXPECT_EQ(broker_.retained("test/state"), "OFF");
+}
+
+TEST_F(MqttBrokerTest, SubscribesOnceOnFirstConnect) {
+    // Every SUBSCRIBE delivers the retained message again
+    broker_.publish("test/cmd", "ON", true);
+
+    MqttManager manager(config_);
+    std::atomic<int> received{0};
+    manager.set_message_callback([&](const std::string&, const std::string&) { received++; });
+    ASSERT_TRUE(manager.subscribe("test/cmd"));
+
+    manager.connect_in_background();
+    ASSERT_TRUE(wait_until([&] { return received == 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(received, 1);
+}
+
+TEST_F(MqttBrokerTest, ResubscribesAfterConnectionLoss) {
+    MqttManager manager(config_);
+    std::atomic<int> received{0};
+    manager.set_message_callback([&](const std::string&, const std::string&) { received++; });
+
+    manager.connect_in_background();
+    ASSERT_TRUE(wait_until([&] { return manager.is_connected(); }));
+    ASSERT_TRUE(manager.subscribe("test/cmd"));
+    ASSERT_TRUE(broker_.wait_for_subscription("test/cmd", kTimeout));
+
+    broker_.drop_connections();
+    ASSERT_TRUE(wait_until([&] { return broker_.connection_count() == 2 && manager.is_connected(); }));
+    ASSERT_TRUE(broker_.wait_for_subscription("test/cmd", kTimeout));
+
+    broker_.publish("test/cmd", "ON");
+    EXPECT_TRUE(wait_until([&] { return received == 1; }));
+}
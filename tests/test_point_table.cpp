@@ -0,0 +1,113 @@
+#include "point_table.hpp"
+#include "point_factories.hpp"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+
+class PointTableTest : public ::testing::Test {
+ protected:
+  bool has(ConfigDiagnostic::Severity severity, const std::string& path) const {
+    return std::any_of(diagnostics_.begin(), diagnostics_.end(), [&](const ConfigDiagnostic& d) {
+      return d.severity == severity && d.path == path;
+    });
+  }
+
+  bool has_error(const std::string& path) const { return has(ConfigDiagnostic::Severity::ERROR, path); }
+
+  bool has_warning(const std::string& path) const { return has(ConfigDiagnostic::Severity::WARNING, path); }
+
+  std::vector<ConfigDiagnostic> diagnostics_;
+};
+
+TEST_F(PointTableTest, BuildsIndexTables) {
+  std::vector<DigitalInput> inputs = {make_input(2, 9, "b"), make_input(1, 0, "a"), make_input(2, 1, "c")};
+  std::vector<Relay> relays = {make_relay(1, 0, "r0"), make_relay(1, 1, "r1")};
+
+  PointTable table = compile_points(inputs, relays, diagnostics_);
+  EXPECT_TRUE(diagnostics_.empty());
+
+  ASSERT_EQ(table.slaves.size(), 2u);
+  EXPECT_EQ(table.slaves[0].slave_id, 1);
+  EXPECT_EQ(table.slaves[0].bit_count, 8u);
+  EXPECT_EQ(table.slaves[1].slave_id, 2);
+  EXPECT_EQ(table.slaves[1].bit_count, 16u);
+  EXPECT_EQ(table.slaves[1].bit_inputs[9], std::vector<std::size_t>{0});
+  EXPECT_EQ(table.slaves[1].bit_inputs[1], std::vector<std::size_t>{2});
+
+  EXPECT_EQ(table.command_routes.at("test/r1/set"), 1u);
+  EXPECT_EQ(table.command_routes.at("modbus/relay/r0/set"), 0u);
+}
+
+TEST_F(PointTableTest, RejectsDuplicateRelayNames) {
+  std::vector<Relay> relays = {make_relay(1, 0, "pump"), make_relay(1, 1, "pump")};
+  relays[1].mqtt_command_topic = "test/pump2/set";
+  relays[1].mqtt_state_topic = "test/pump2/state";
+
+  compile_points({}, relays, diagnostics_);
+  EXPECT_TRUE(has_error("/relays/1/name"));
+  EXPECT_FALSE(has_error("/relays/0/name"));
+}
+
+TEST_F(PointTableTest, RejectsSlaveIdsOutOfRange) {
+  std::vector<DigitalInput> inputs = {make_input(0, 0, "a"), make_input(248, 0, "b")};
+  std::vector<Relay> relays = {make_relay(0, 0, "broadcast"), make_relay(300, 0, "far")};
+
+  compile_points(inputs, relays, diagnostics_);
+  EXPECT_TRUE(has_error("/digital_inputs/0/slave_id"));
+  EXPECT_TRUE(has_error("/digital_inputs/1/slave_id"));
+  EXPECT_TRUE(has_warning("/relays/0/slave_id"));
+  EXPECT_TRUE(has_error("/relays/1/slave_id"));
+}
+
+TEST_F(PointTableTest, RejectsOverlappingTopics) {
+  std::vector<DigitalInput> inputs = {make_input(1, 0, "a"), make_input(1, 1, "b")};
+  inputs[1].mqtt_topic = inputs[0].mqtt_topic;
+  std::vector<Relay> relays = {make_relay(1, 0, "r0"), make_relay(1, 1, "r1"), make_relay(1, 2, "r2")};
+  relays[1].mqtt_command_topic = relays[0].mqtt_command_topic;
+  relays[2].mqtt_command_topic = "test/a/state";
+
+  compile_points(inputs, relays, diagnostics_);
+  EXPECT_TRUE(has_error("/digital_inputs/1/mqtt_topic"));
+  EXPECT_TRUE(has_error("/relays/1/mqtt_command_topic"));
+  EXPECT_TRUE(has_error("/relays/2/mqtt_command_topic"));
+}
+
+TEST_F(PointTableTest, WarnsAboutExpensiveAddresses) {
+  std::vector<DigitalInput> inputs = {make_input(1, 0, "a"), make_input(1, 1000, "far")};
+
+  PointTable table = compile_points(inputs, {}, diagnostics_);
+  EXPECT_TRUE(has_warning("/digital_inputs/1/address"));
+  EXPECT_EQ(table.slaves[0].bit_count, 1008u);
+}
+
+TEST_F(PointTableTest, LeavesNegativeAddressesUnpolled) {
+  std::vector<DigitalInput> inputs = {make_input(1, -1, "a")};
+
+  PointTable table = compile_points(inputs, {}, diagnostics_);
+  EXPECT_TRUE(has_error("/digital_inputs/0/address"));
+  EXPECT_TRUE(table.slaves.empty());
+  EXPECT_EQ(table.inputs.size(), 1u);
+}
+
+TEST_F(PointTableTest, CollectsBroadcastGroupMembers) {
+  std::vector<Relay> relays = {make_relay(2, 1, "b1"), make_relay(1, 4, "a4"), make_relay(1, 0, "a0"),
+                               make_relay(1, 8, "outside")};
+  std::vector<BroadcastGroup> groups = {{"lights", 0, 8, "home/lights/set", true},
+                                        {"empty", 100, 2, "home/empty/set", true},
+                                        {"clash", 0, 1, "test/a0/set", true},
+                                        {"lights2", 0, 1, "home/lights/set", true}};
+
+  PointTable table = compile_points({}, relays, diagnostics_, {}, DeviceCatalog(), groups);
+  ASSERT_EQ(table.groups.size(), 4u);
+  const PointTable::Group& lights = table.groups[0];
+  ASSERT_EQ(lights.members.size(), 2u);
+  EXPECT_EQ(lights.members[0].slave_id, 1);
+  EXPECT_EQ(lights.members[0].relays, (std::vector<std::size_t>{2, 1}));  // by address
+  EXPECT_EQ(lights.members[1].slave_id, 2);
+  EXPECT_EQ(table.group_routes.at("home/lights/set"), 0u);
+
+  EXPECT_TRUE(has_warning("/broadcast_groups/1"));
+  EXPECT_TRUE(has_error("/broadcast_groups/2/mqtt_command_topic"));  // a relay's topic
+  EXPECT_TRUE(has_error("/broadcast_groups/3/mqtt_command_topic"));  // another group's
+  EXPECT_FALSE(has_error("/broadcast_groups/0/mqtt_command_topic"));
+}
@@ -0,0 +1,84 @@
+#include "point_templates.hpp"
+
+#include <gtest/gtest.h>
+
+class PointTemplatesTest : public ::testing::Test {
+ protected:
+  ExpandedPoints expand(const std::string& text) { return expand_points(nlohmann::json::parse(text), diagnostics_); }
+
+  std::vector<ConfigDiagnostic> diagnostics_;
+};
+
+TEST_F(PointTemplatesTest, SinglePointsPassThrough) {
+  auto points = expand(R"({"digital_inputs": [{"slave_id": 1, "address": 3, "name": "door"}]})");
+
+  EXPECT_TRUE(diagnostics_.empty());
+  ASSERT_EQ(points.inputs.size(), 1u);
+  EXPECT_EQ(points.inputs[0].mqtt_topic, "modbus/input/door/state");
+  EXPECT_EQ(points.sources.inputs[0], "/digital_inputs/0");
+}
+
+TEST_F(PointTemplatesTest, ExpandsSlaveAndAddressRanges) {
+  auto points = expand(R"({"digital_inputs": [
+      {"slave_id": "48-51", "address": "0-7", "name": "button_{slave}_{address}",
+       "mqtt_topic": "home/buttons/{slave}/{index}"}
+  ]})");
+
+  EXPECT_TRUE(diagnostics_.empty());
+  ASSERT_EQ(points.inputs.size(), 32u);
+  EXPECT_EQ(points.inputs[9].slave_id, 49);
+  EXPECT_EQ(points.inputs[9].address, 1);
+  EXPECT_EQ(points.inputs[9].name, "button_49_1");
+  EXPECT_EQ(points.inputs[9].mqtt_topic, "home/buttons/49/9");
+  EXPECT_EQ(points.sources.inputs[9], "/digital_inputs/0[slave=49,address=1]");
+}
+
+TEST_F(PointTemplatesTest, NamesFromList) {
+  auto points = expand(R"({"relays": [
+      {"slave_id": 32, "address": [0, "2-3"], "name": ["stairs", "kitchen", "garage"]}
+  ]})");
+
+  EXPECT_TRUE(diagnostics_.empty());
+  ASSERT_EQ(points.relays.size(), 3u);
+  EXPECT_EQ(points.relays[1].name, "kitchen");
+  EXPECT_EQ(points.relays[1].address, 2);
+  EXPECT_EQ(points.relays[1].mqtt_command_topic, "modbus/relay/kitchen/set");
+  EXPECT_EQ(points.relays[2].mqtt_state_topic, "modbus/relay/garage/state");
+}
+
+TEST_F(PointTemplatesTest, InstantiatesModules) {
+  auto points = expand(R"({
+      "templates": {
+          "io8": {
+              "digital_inputs": [{"address": "0-7", "name": "{module}_in{address}"}],
+              "relays": [{"address": "0-1", "name": "{module}_out{address}"}]
+          }
+      },
+      "modules": [{"template": "io8", "slave_id": "10-11", "name": "panel{slave}"}]
+  })");
+
+  EXPECT_TRUE(diagnostics_.empty());
+  ASSERT_EQ(points.inputs.size(), 16u);
+  ASSERT_EQ(points.relays.size(), 4u);
+  EXPECT_EQ(points.inputs[8].name, "panel11_in0");
+  EXPECT_EQ(points.inputs[8].slave_id, 11);
+  EXPECT_EQ(points.relays[3].name, "panel11_out1");
+  EXPECT_EQ(points.sources.relays[3], "/modules/0[slave=11,address=1]");
+}
+
+TEST_F(PointTemplatesTest, ReportsBadDeclarations) {
+  expand(R"({
+      "digital_inputs": [
+          {"slave_id": "7-3", "address": 0, "name": "x"},
+          {"slave_id": 1, "address": "0-1", "name": ["only_one"]},
+          {"slave_id": 1, "address": "0-1", "name": "in_{bogus}"}
+      ],
+      "modules": [{"template": "missing", "slave_id": 1}]
+  })");
+
+  ASSERT_EQ(diagnostics_.size(), 4u);
+  EXPECT_EQ(diagnostics_[0].path, "/digital_inputs/0");
+  EXPECT_EQ(diagnostics_[1].path, "/digital_inputs/1");
+  EXPECT_EQ(diagnostics_[2].path, "/digital_inputs/2");
+  EXPECT_EQ(diagnostics_[3].path, "/modules/0/template");
+}
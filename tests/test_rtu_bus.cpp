@@ -0,0 +1,325 @@
+#include "clock.hpp"
+#include "modbus_manager.hpp"
+#include "rtu/crc16.hpp"
+#include "rtu/rtu_bus.hpp"
+#include "rtu/rtu_event_loop.hpp"
+#include "virtual_slave_farm.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <modbus/modbus.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <random>
+#include <thread>
+
+namespace {
+
+ModbusConfig line(const std::string& port, int baudrate) {
+  ModbusConfig config;
+  config.port = port;
+  config.baudrate = baudrate;
+  config.parity = 'N';
+  config.data_bits = 8;
+  config.stop_bits = 1;
+  config.transport = "native";
+  config.timing = "auto";
+  config.response_timeout_ms = 100;
+  config.byte_timeout_ms = 50;
+  config.max_retries = 2;
+  return config;
+}
+
+VirtualSlaveConfig slave(int id) {
+  VirtualSlaveConfig config;
+  config.slave_id = id;
+  config.inputs = 16;
+  config.coils = 16;
+  return config;
+}
+
+uint16_t bitwise_crc16(const uint8_t* data, std::size_t length) {
+  uint16_t crc = 0xFFFF;
+  for (std::size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) ? static_cast<uint16_t>((crc >> 1) ^ 0xA001) : static_cast<uint16_t>(crc >> 1);
+    }
+  }
+  return crc;
+}
+
+}  // namespace
+
+TEST(RtuCrcTest, MatchesBitwiseReference) {
+  // FC02 request for 8 inputs of slave 1: CRC 79 CC on the wire
+  const uint8_t request[] = {0x01, 0x02, 0x00, 0x00, 0x00, 0x08};
+  EXPECT_EQ(rtu_crc16(request, sizeof(request)), 0xCC79);
+
+  std::mt19937 rng(7);
+  std::vector<uint8_t> data(256);
+  for (auto& byte : data) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  // Every tail length around the 8 byte slices
+  for (std::size_t length = 0; length <= data.size(); length++) {
+    ASSERT_EQ(rtu_crc16(data.data(), length), bitwise_crc16(data.data(), length)) << length << " bytes";
+  }
+}
+
+class RtuBusTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    farm_.add_slave(slave(1));
+    farm_.add_slave(slave(2));
+    farm_.start();
+
+    const ModbusConfig config = line(farm_.port(), farm_.baudrate());
+    bus_ = std::make_unique<RtuBus>(config, rtu_timeouts(config));
+    bus_->open();
+    loop_.add(*bus_);
+  }
+
+  void TearDown() override {
+    loop_.remove(*bus_);
+  }
+
+  int run(const RtuRequest& request) {
+    int error = -1;
+    EXPECT_TRUE(bus_->submit(request, [&error](int result) { error = result; }));
+    loop_.run_until_idle(*bus_);
+    return error;
+  }
+
+  VirtualSlaveFarm farm_{115200};
+  RtuEventLoop loop_;
+  std::unique_ptr<RtuBus> bus_;
+};
+
+TEST_F(RtuBusTest, ReadsAndWrites) {
+  farm_.set_input(2, 9, true);
+
+  uint8_t bits[16] = {};
+  RtuRequest read;
+  read.unit_id = 2;
+  read.count = 16;
+  read.dest = bits;
+  ASSERT_EQ(run(read), 0);
+  for (int i = 0; i < 16; i++) {
+    EXPECT_EQ(bits[i], i == 9 ? 1 : 0) << "input " << i;
+  }
+
+  const uint8_t values[10] = {1, 0, 1, 0, 0, 0, 0, 0, 0, 1};
+  RtuRequest write;
+  write.unit_id = 1;
+  write.function = ModbusFunction::WRITE_MULTIPLE_COILS;
+  write.address = 2;
+  write.count = 10;
+  write.values = values;
+  ASSERT_EQ(run(write), 0);
+  EXPECT_TRUE(farm_.coil(1, 2));
+  EXPECT_TRUE(farm_.coil(1, 4));
+  EXPECT_TRUE(farm_.coil(1, 11));
+  EXPECT_FALSE(farm_.coil(1, 3));
+
+  write.function = ModbusFunction::WRITE_SINGLE_COIL;
+  write.count = 1;
+  write.values = &values[1];
+  ASSERT_EQ(run(write), 0);
+  EXPECT_FALSE(farm_.coil(1, 2));
+}
+
+TEST_F(RtuBusTest, ReportsProtocolErrors) {
+  uint8_t bits[8];
+  RtuRequest request;
+  request.count = 8;
+  request.dest = bits;
+
+  request.address = 100;  // beyond the 16 inputs
+  EXPECT_EQ(run(request), MODBUS_ENOBASE + 2);
+
+  farm_.set_faults(1, 1.0, 0.0);
+  request.address = 0;
+  EXPECT_EQ(run(request), EMBBADCRC);
+
+  farm_.set_faults(1, 0.0, 1.0);
+  const auto begin = std::chrono::steady_clock::now();
+  EXPECT_EQ(run(request), ETIMEDOUT);
+  EXPECT_GE(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(100));
+
+  // The bus recovers with the next request
+  farm_.set_faults(1, 0.0, 0.0);
+  EXPECT_EQ(run(request), 0);
+  ASSERT_TRUE(bus_->submit(request, nullptr));
+  EXPECT_FALSE(bus_->submit(request, nullptr));  // one transaction at a time
+  loop_.run_until_idle(*bus_);
+}
+
+TEST(RtuEventLoopTest, OneThreadDrivesTwoBuses) {
+  VirtualSlaveFarm fast(115200);
+  VirtualSlaveFarm slow(9600);
+  fast.add_slave(slave(1));
+  slow.add_slave(slave(1));
+  fast.start();
+  slow.start();
+  fast.set_input(1, 0, true);
+  slow.set_input(1, 1, true);
+
+  const ModbusConfig fast_config = line(fast.port(), 115200);
+  const ModbusConfig slow_config = line(slow.port(), 9600);
+  RtuBus fast_bus(fast_config, rtu_timeouts(fast_config));
+  RtuBus slow_bus(slow_config, rtu_timeouts(slow_config));
+  fast_bus.open();
+  slow_bus.open();
+
+  RtuEventLoop loop;
+  loop.add(fast_bus);
+  loop.add(slow_bus);
+
+  // Both transactions are on the wire at once
+  uint8_t fast_bits[8] = {};
+  uint8_t slow_bits[8] = {};
+  int fast_error = -1;
+  int slow_error = -1;
+  std::chrono::steady_clock::time_point fast_done;
+  const auto begin = std::chrono::steady_clock::now();
+
+  RtuRequest request;
+  request.count = 8;
+  request.dest = slow_bits;
+  ASSERT_TRUE(slow_bus.submit(request, [&slow_error](int error) { slow_error = error; }));
+  request.dest = fast_bits;
+  ASSERT_TRUE(fast_bus.submit(request, [&](int error) {
+    fast_error = error;
+    fast_done = std::chrono::steady_clock::now();
+  }));
+
+  while (slow_bus.busy() || fast_bus.busy()) {
+    loop.run_once(std::chrono::milliseconds(100));
+  }
+  EXPECT_EQ(fast_error, 0);
+  EXPECT_EQ(slow_error, 0);
+  EXPECT_EQ(fast_bits[0], 1);
+  EXPECT_EQ(slow_bits[1], 1);
+  // The fast bus did not wait for the slow one
+  EXPECT_LT(fast_done - begin, slow.wire_time(14));
+
+  loop.remove(fast_bus);
+  loop.remove(slow_bus);
+}
+
+TEST(RtuEventLoopTest, NoiseRestartsTheSilence) {
+  // A bare pseudo terminal: whatever is written to the master is noise on the line
+  const int master = ::posix_openpt(O_RDWR | O_NOCTTY);
+  ASSERT_GE(master, 0);
+  ASSERT_EQ(::grantpt(master), 0);
+  ASSERT_EQ(::unlockpt(master), 0);
+
+  const ModbusConfig config = line(::ptsname(master), 1200);
+  RtuBus bus(config, rtu_timeouts(config));
+  bus.open();
+  RtuEventLoop loop;
+  loop.add(bus);
+
+  const uint8_t noise[] = {0x55, 0xAA, 0x00};
+  ASSERT_EQ(::write(master, noise, sizeof(noise)), static_cast<ssize_t>(sizeof(noise)));
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  const auto arrived = std::chrono::steady_clock::now();
+
+  // Drained on the first wakeup instead of waking the loop over and over
+  EXPECT_EQ(loop.run_once(std::chrono::milliseconds(100)), 1u);
+  EXPECT_EQ(loop.run_once(std::chrono::milliseconds(0)), 0u);
+
+  // The next frame waits t3.5 after the noise
+  const uint8_t on = 1;
+  RtuRequest request;
+  request.unit_id = RtuBus::kBroadcastUnit;
+  request.function = ModbusFunction::WRITE_SINGLE_COIL;
+  request.values = &on;
+  ASSERT_TRUE(bus.submit(request, nullptr));
+  EXPECT_FALSE(bus.wants_write());
+  EXPECT_GE(bus.deadline(), arrived + BusTiming(config).frame_gap());
+  loop.run_until_idle(bus);
+
+  loop.remove(bus);
+  bus.close();
+  ::close(master);
+}
+
+TEST(RtuTransportTest, ModbusManagerRunsOnNativeBus) {
+  VirtualSlaveFarm farm(115200);
+  VirtualSlaveConfig noisy = slave(3);
+  noisy.crc_error_rate = 1.0;
+  farm.add_slave(noisy);
+  farm.start();
+
+  ModbusManager modbus(line(farm.port(), 115200));
+  ASSERT_TRUE(modbus.connect());
+
+  uint8_t bits[8];
+  EXPECT_FALSE(modbus.read_input_bits(3, 0, 8, bits));
+  EXPECT_EQ(farm.stats().crc_errors, 2u);  // retried once
+
+  farm.set_faults(3, 0.0, 0.0);
+  farm.set_input(3, 5, true);
+  ASSERT_TRUE(modbus.read_input_bits(3, 0, 8, bits));
+  EXPECT_EQ(bits[5], 1);
+  ASSERT_TRUE(modbus.write_coil(3, 7, true));
+  EXPECT_TRUE(farm.coil(3, 7));
+  EXPECT_EQ(modbus.get_stats().read_errors, 1u);
+}
+
+TEST(RtuTransportTest, RetryBackoffRunsInVirtualTime) {
+  VirtualSlaveFarm farm(115200);
+  VirtualSlaveConfig noisy = slave(4);
+  noisy.crc_error_rate = 1.0;
+  farm.add_slave(noisy);
+  farm.start();
+
+  ModbusConfig config = line(farm.port(), 115200);
+  config.max_retries = 4;
+  const RtuTimeouts timeouts = rtu_timeouts(config);
+
+  VirtualClock clock;
+  clock.set_auto_advance(true);
+  ModbusManager modbus(config, clock);
+  ASSERT_TRUE(modbus.connect());
+
+  // Three waits between four attempts, none of them in real time
+  auto start = clock.now();
+  uint8_t bits[8];
+  EXPECT_FALSE(modbus.read_input_bits(4, 0, 8, bits));
+  EXPECT_EQ(clock.now() - start, 3 * timeouts.read_retry_delay);
+
+  start = clock.now();
+  EXPECT_FALSE(modbus.write_coil(4, 0, true));
+  EXPECT_EQ(clock.now() - start, 3 * timeouts.write_retry_delay);
+  EXPECT_EQ(farm.stats().crc_errors, 8u);
+}
+
+TEST(RtuTransportTest, BroadcastReachesEverySlave) {
+  VirtualSlaveFarm farm(115200);
+  farm.add_slave(slave(1));
+  farm.add_slave(slave(2));
+  farm.start();
+
+  ModbusManager modbus(line(farm.port(), 115200));
+  ASSERT_TRUE(modbus.connect());
+
+  ASSERT_TRUE(modbus.broadcast_coils(2, 3, true));
+  ASSERT_TRUE(modbus.broadcast_coils(3, 1, false));
+
+  // Nothing acknowledges a broadcast; the next request waits out the turnaround
+  uint8_t bits[8];
+  ASSERT_TRUE(modbus.read_coils(1, 0, 8, bits));
+  EXPECT_EQ(bits[2], 1);
+  EXPECT_EQ(bits[3], 0);
+  for (int id : {1, 2}) {
+    EXPECT_TRUE(farm.coil(id, 2));
+    EXPECT_FALSE(farm.coil(id, 3));
+    EXPECT_TRUE(farm.coil(id, 4));
+  }
+  EXPECT_EQ(farm.stats().broadcasts, 2u);
+}
@@ -0,0 +1,102 @@
+#include "modbus_manager_mock.hpp"
+#include "mqtt_manager_mock.hpp"
+#include "stats_service.hpp"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using ::testing::Invoke;
+
+class StatsServiceTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ON_CALL(modbus_, get_stats()).WillByDefault(Invoke([this]() { return modbus_stats_; }));
+    ON_CALL(mqtt_, get_stats()).WillByDefault(Invoke([this]() { return mqtt_stats_; }));
+  }
+
+  std::chrono::steady_clock::time_point at(int seconds) { return start_ + std::chrono::seconds(seconds); }
+
+  ::testing::NiceMock<MockModbusManager> modbus_;
+  ::testing::NiceMock<MockMqttManager> mqtt_;
+  ModbusManagerStats modbus_stats_;
+  MqttManagerStats mqtt_stats_;
+  std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+};
+
+TEST_F(StatsServiceTest, NoHistoryGivesNeutralStats) {
+  StatsService service(modbus_, mqtt_);
+  service.sample(at(0));
+
+  auto w = service.window(std::chrono::minutes(1));
+  EXPECT_EQ(w.covered.count(), 0);
+  EXPECT_DOUBLE_EQ(w.read_rate, 0.0);
+  EXPECT_DOUBLE_EQ(w.read_success_ratio, 1.0);
+}
+
+TEST_F(StatsServiceTest, SamplesRespectInterval) {
+  StatsService service(modbus_, mqtt_, std::chrono::seconds(5));
+
+  service.sample(at(0));
+  service.sample(at(2));
+  service.sample(at(5));
+
+  EXPECT_EQ(service.sample_count(), 2u);
+}
+
+TEST_F(StatsServiceTest, RatesAndRatiosOverWindow) {
+  StatsService service(modbus_, mqtt_, std::chrono::seconds(5));
+
+  // 10 reads/s with 1 error/s, 2 publishes/s
+  for (int t = 0; t <= 600; t += 5) {
+    modbus_stats_ = ModbusManagerStats(45 * t / 5, 5 * t / 5, 0, 0);
+    mqtt_stats_ = MqttManagerStats(10 * t / 5, 0, t / 5);
+    service.sample(at(t));
+  }
+
+  auto w = service.window(std::chrono::minutes(1));
+  EXPECT_EQ(w.covered.count(), 60);
+  EXPECT_DOUBLE_EQ(w.read_rate, 10.0);
+  EXPECT_DOUBLE_EQ(w.read_success_ratio, 0.9);
+  EXPECT_DOUBLE_EQ(w.publish_rate, 2.0);
+  EXPECT_DOUBLE_EQ(w.publish_success_ratio, 1.0);
+  EXPECT_DOUBLE_EQ(w.receive_rate, 0.2);
+  EXPECT_DOUBLE_EQ(w.write_success_ratio, 1.0);
+
+  // Ten minutes of history cannot cover fifteen
+  auto w15 = service.window(std::chrono::minutes(15));
+  EXPECT_EQ(w15.covered.count(), 600);
+  EXPECT_DOUBLE_EQ(w15.read_rate, 10.0);
+}
+
+TEST_F(StatsServiceTest, WindowsSeeOnlyRecentErrors) {
+  StatsService service(modbus_, mqtt_, std::chrono::seconds(5));
+
+  // Errors only during the first four minutes
+  uint64_t ok = 0;
+  uint64_t errors = 0;
+  for (int t = 0; t <= 900; t += 5) {
+    if (t > 0) {
+      ok += 5;
+      errors += (t <= 240) ? 5 : 0;
+    }
+    modbus_stats_ = ModbusManagerStats(ok, errors, 0, 0);
+    service.sample(at(t));
+  }
+
+  EXPECT_DOUBLE_EQ(service.window(std::chrono::minutes(1)).read_success_ratio, 1.0);
+  EXPECT_DOUBLE_EQ(service.window(std::chrono::minutes(5)).read_success_ratio, 1.0);
+  EXPECT_LT(service.window(std::chrono::minutes(15)).read_success_ratio, 1.0);
+}
+
+TEST_F(StatsServiceTest, RingKeepsFifteenMinutes) {
+  StatsService service(modbus_, mqtt_, std::chrono::seconds(5));
+
+  for (int t = 0; t <= 3600; t += 5) {
+    modbus_stats_ = ModbusManagerStats(t, 0, 0, 0);
+    service.sample(at(t));
+  }
+
+  auto w = service.window(std::chrono::minutes(15));
+  EXPECT_EQ(w.covered.count(), 900);
+  EXPECT_DOUBLE_EQ(w.read_rate, 1.0);
+}
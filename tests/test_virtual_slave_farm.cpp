@@ -0,0 +1,138 @@
+#include "modbus_manager.hpp"
+#include "virtual_slave_farm.hpp"
+
+#include <gtest/gtest.h>
+
+// The real ModbusManager against simulated slaves on a pty
+class VirtualSlaveFarmTest : public ::testing::Test {
+ protected:
+  void start(int baudrate, std::vector<VirtualSlaveConfig> slaves) {
+    farm_ = std::make_unique<VirtualSlaveFarm>(baudrate);
+    for (const auto& slave : slaves) {
+      farm_->add_slave(slave);
+    }
+    farm_->start();
+
+    ModbusConfig config;
+    config.port = farm_->port();
+    config.baudrate = baudrate;
+    config.parity = 'N';
+    config.data_bits = 8;
+    config.stop_bits = 1;
+    config.response_timeout_ms = 100;
+    config.byte_timeout_ms = 50;
+    config.max_retries = 2;
+
+    modbus_ = std::make_unique<ModbusManager>(config);
+    ASSERT_TRUE(modbus_->connect());
+  }
+
+  static VirtualSlaveConfig slave(int id) {
+    VirtualSlaveConfig config;
+    config.slave_id = id;
+    config.inputs = 16;
+    config.coils = 8;
+    return config;
+  }
+
+  void TearDown() override {
+    modbus_.reset();
+    farm_.reset();
+  }
+
+  std::unique_ptr<VirtualSlaveFarm> farm_;
+  std::unique_ptr<ModbusManager> modbus_;
+};
+
+TEST_F(VirtualSlaveFarmTest, ReadsInputs) {
+  start(115200, {slave(1), slave(2)});
+  farm_->set_input(2, 3, true);
+  farm_->set_input(2, 12, true);
+
+  uint8_t bits[16] = {};
+  ASSERT_TRUE(modbus_->read_input_bits(2, 0, 16, bits));
+  for (int i = 0; i < 16; i++) {
+    EXPECT_EQ(bits[i], (i == 3 || i == 12) ? 1 : 0) << "input " << i;
+  }
+  EXPECT_EQ(farm_->stats().replies, 1u);
+}
+
+TEST_F(VirtualSlaveFarmTest, WritesCoils) {
+  start(115200, {slave(5)});
+
+  std::vector<int> clicked;
+  farm_->set_coil_callback([&clicked](int slave_id, int address, bool state) {
+    EXPECT_EQ(slave_id, 5);
+    EXPECT_TRUE(state);
+    clicked.push_back(address);
+  });
+
+  ASSERT_TRUE(modbus_->write_coil(5, 6, true));
+  EXPECT_TRUE(farm_->coil(5, 6));
+  EXPECT_EQ(clicked, std::vector<int>{6});
+
+  uint8_t coils[8] = {};
+  ASSERT_TRUE(modbus_->read_coils(5, 0, 8, coils));
+  EXPECT_EQ(coils[6], 1);
+}
+
+TEST_F(VirtualSlaveFarmTest, RetriesCorruptedReplies) {
+  VirtualSlaveConfig noisy = slave(1);
+  noisy.crc_error_rate = 1.0;
+  start(115200, {noisy});
+
+  uint8_t bits[8];
+  EXPECT_FALSE(modbus_->read_input_bits(1, 0, 8, bits));
+  EXPECT_EQ(farm_->stats().crc_errors, 2u);  // every attempt
+  EXPECT_EQ(modbus_->get_stats().read_errors, 1u);
+
+  farm_->set_faults(1, 0.0, 0.0);
+  EXPECT_TRUE(modbus_->read_input_bits(1, 0, 8, bits));
+}
+
+TEST_F(VirtualSlaveFarmTest, SilentSlaveTimesOut) {
+  VirtualSlaveConfig silent = slave(1);
+  silent.timeout_rate = 1.0;
+  start(115200, {silent});
+
+  uint8_t bits[8];
+  EXPECT_FALSE(modbus_->read_input_bits(1, 0, 8, bits));
+  EXPECT_FALSE(modbus_->read_input_bits(9, 0, 8, bits));  // nobody there
+  EXPECT_EQ(farm_->stats().timeouts, 2u);
+  EXPECT_EQ(farm_->stats().unknown_slave, 2u);
+}
+
+TEST_F(VirtualSlaveFarmTest, RejectsUnsupportedFunction) {
+  VirtualSlaveConfig inputs_only = slave(1);
+  inputs_only.function_codes = {0x02};
+  start(115200, {inputs_only});
+
+  EXPECT_FALSE(modbus_->write_coil(1, 0, true));
+  EXPECT_FALSE(farm_->coil(1, 0));
+  EXPECT_EQ(farm_->stats().exceptions, 2u);
+}
+
+TEST_F(VirtualSlaveFarmTest, TransactionTakesWireTime) {
+  start(9600, {slave(1)});
+
+  // FC02 for 8 inputs: 8 byte request, 6 byte reply
+  uint8_t bits[8];
+  const auto begin = std::chrono::steady_clock::now();
+  ASSERT_TRUE(modbus_->read_input_bits(1, 0, 8, bits));
+  const auto elapsed = std::chrono::steady_clock::now() - begin;
+
+  EXPECT_GE(elapsed, farm_->wire_time(14));
+}
+
+TEST_F(VirtualSlaveFarmTest, ScheduledInputChange) {
+  start(115200, {slave(1)});
+  farm_->schedule_input(1, 0, true, std::chrono::milliseconds(20));
+
+  uint8_t bits[8];
+  ASSERT_TRUE(modbus_->read_input_bits(1, 0, 8, bits));
+  EXPECT_EQ(bits[0], 0);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  ASSERT_TRUE(modbus_->read_input_bits(1, 0, 8, bits));
+  EXPECT_EQ(bits[0], 1);
+}